@@ -446,6 +446,23 @@ typedef struct {
 #define UNSET_NO_SPECIAL_SYMBOLS(b) ((b)->sxpinfo.gp &= (~SPECIAL_SYMBOL_MASK))
 #define NO_SPECIAL_SYMBOLS(b) ((b)->sxpinfo.gp & SPECIAL_SYMBOL_MASK)
 
+/* Symbols that have been looked up as S3 methods. Changing a binding
+   of one of these invalidates the S3 dispatch cache (objects.c). */
+#define S3_METHOD_SYMBOL_MASK (1<<11)
+#define SET_S3_METHOD_SYMBOL(b) ((b)->sxpinfo.gp |= S3_METHOD_SYMBOL_MASK)
+#define IS_S3_METHOD_SYMBOL(b) ((b)->sxpinfo.gp & S3_METHOD_SYMBOL_MASK)
+
+/* Symbols that have had an active binding in some environment; method
+   and function lookups through these are not cached. */
+#define HAD_ACTIVE_BINDING_MASK (1<<10)
+#define SET_HAD_ACTIVE_BINDING(b) ((b)->sxpinfo.gp |= HAD_ACTIVE_BINDING_MASK)
+#define HAD_ACTIVE_BINDING(b) ((b)->sxpinfo.gp & HAD_ACTIVE_BINDING_MASK)
+
+/* Symbols whose function lookups are cached by GETFUN (eval.c) */
+#define FUN_CACHED_SYMBOL_MASK (1<<9)
+#define SET_FUN_CACHED_SYMBOL(b) ((b)->sxpinfo.gp |= FUN_CACHED_SYMBOL_MASK)
+#define IS_FUN_CACHED_SYMBOL(b) ((b)->sxpinfo.gp & FUN_CACHED_SYMBOL_MASK)
+
 #else /* USE_RINTERNALS */
 
 typedef struct VECREC *VECP;
@@ -478,6 +495,13 @@ void (SET_NO_SPECIAL_SYMBOLS)(SEXP b);
 void (UNSET_NO_SPECIAL_SYMBOLS)(SEXP b);
 Rboolean (NO_SPECIAL_SYMBOLS)(SEXP b);
 
+void (SET_S3_METHOD_SYMBOL)(SEXP b);
+Rboolean (IS_S3_METHOD_SYMBOL)(SEXP b);
+void (SET_HAD_ACTIVE_BINDING)(SEXP b);
+Rboolean (HAD_ACTIVE_BINDING)(SEXP b);
+void (SET_FUN_CACHED_SYMBOL)(SEXP b);
+Rboolean (IS_FUN_CACHED_SYMBOL)(SEXP b);
+
 #endif /* USE_RINTERNALS */
 
 #define TYPED_STACK
@@ -541,6 +565,7 @@ typedef struct RCNTXT {
     int bcintactive;            /* R_BCIntActive value */
     SEXP bcbody;                /* R_BCbody value */
     void* bcpc;                 /* R_BCpc value */
+    void* bccountframe;         /* R_BCCountFrame value */
     SEXP handlerstack;          /* condition handler stack */
     SEXP restartstack;          /* stack of available restarts */
     struct RPRSTACK *prstack;   /* stack of pending promises */
@@ -674,6 +699,8 @@ extern0 int	R_BCIntActive INI_as(0); /* bcEval called more recently than
                                             eval */
 extern0 void*	R_BCpc INI_as(NULL);/* current byte code instruction */
 extern0 SEXP	R_BCbody INI_as(NULL); /* current byte code object */
+extern0 void*	R_BCCountFrame INI_as(NULL); /* innermost byte code counting
+						frame */
 extern0 SEXP	R_NHeap;	    /* Start of the cons cell heap */
 extern0 SEXP	R_FreeSEXP;	    /* Cons cell free list */
 extern0 R_size_t R_Collected;	    /* Number of free cons cells (after gc) */
@@ -806,6 +833,16 @@ extern0 int R_jit_enabled INI_as(0); /* has to be 0 during R startup */
 extern0 int R_compile_pkgs INI_as(0);
 extern0 int R_check_constants INI_as(0);
 extern0 int R_disable_bytecode INI_as(0);
+extern0 unsigned int R_S3DispatchEpoch INI_as(0); /* see objects.c */
+extern0 unsigned int R_FunCacheEpoch INI_as(0);   /* see eval.c */
+#define R_BINDING_CHANGED(sym) do {				\
+	if (IS_S3_METHOD_SYMBOL(sym)) R_S3DispatchEpoch++;	\
+	if (IS_FUN_CACHED_SYMBOL(sym)) R_FunCacheEpoch++;	\
+    } while (0)
+#define R_LOOKUP_CHANGED() do {			\
+	R_S3DispatchEpoch++;			\
+	R_FunCacheEpoch++;			\
+    } while (0)
 extern SEXP R_cmpfun(SEXP);
 extern SEXP R_cmpfun1(SEXP); /* unconditional fresh compilation */
 extern void R_init_jit_enabled(void);
@@ -1202,9 +1239,11 @@ SEXP R_data_class2(SEXP);
 char *R_LibraryFileName(const char *, char *, size_t);
 SEXP R_LoadFromFile(FILE*, int);
 SEXP R_NewHashedEnv(SEXP, SEXP);
+SEXP R_HashTableForSave(SEXP);
 extern int R_Newhashpjw(const char *);
 FILE* R_OpenLibraryFile(const char *);
 SEXP R_Primitive(const char *);
+SEXP R_applyBuiltin(SEXP, SEXP, SEXP, SEXP);
 void R_RestoreGlobalEnv(void);
 void R_RestoreGlobalEnvFromFile(const char *, Rboolean);
 void R_SaveGlobalEnv(void);
@@ -1250,6 +1289,7 @@ SEXP R_sysfunction(int,RCNTXT*);
 
 void R_run_onexits(RCNTXT *);
 void NORET R_jumpctxt(RCNTXT *, int, SEXP);
+void R_BCCountUnwind(void *);
 #endif
 
 /* ../main/bind.c */
@@ -1286,6 +1326,53 @@ const char *EncodeReal2(double, int, int, int);
 const char *EncodeChar(SEXP);
 
 
+/* main/altrep.c */
+/* Method table of an ALTREP class.  Methods that are NULL get default
+   implementations in terms of the others: all classes must provide
+   Length and either Dataptr or the Elt method for their type.
+   Dataptr is told whether the caller may write through the pointer,
+   as with DATAPTR(), or only reads, as with DATAPTR_RO(). */
+typedef struct {
+    const char *name;
+    SEXPTYPE type;
+    R_xlen_t (*Length)(SEXP);
+    SEXP (*Duplicate)(SEXP, Rboolean);
+    Rboolean (*Inspect)(SEXP);
+    void *(*Dataptr)(SEXP, Rboolean);
+    const void *(*Dataptr_or_null)(SEXP);
+    int (*Integer_Elt)(SEXP, R_xlen_t);
+    double (*Real_Elt)(SEXP, R_xlen_t);
+    SEXP (*String_Elt)(SEXP, R_xlen_t);
+    void (*Set_String_Elt)(SEXP, R_xlen_t, SEXP);
+    R_xlen_t (*Get_region)(SEXP, R_xlen_t, R_xlen_t, void *);
+    int (*Is_sorted)(SEXP);
+    int (*No_NA)(SEXP);
+} R_altrep_methods_t;
+
+/* An ALTREP object is a node with its data in CAR and CDR and its
+   class, an external pointer to the method table, in TAG. */
+#define ALTREP_CLASS(x) TAG(x)
+#define R_altrep_data1(x) CAR(x)
+#define R_altrep_data2(x) CDR(x)
+#define R_set_altrep_data1(x, v) SETCAR(x, v)
+#define R_set_altrep_data2(x, v) SETCDR(x, v)
+
+SEXP R_make_altrep_class(R_altrep_methods_t *);
+SEXP R_new_altrep(SEXP, SEXP, SEXP);
+const char *R_altrep_class_name(SEXP);
+SEXP ALTREP_DUPLICATE(SEXP, Rboolean);
+Rboolean ALTREP_INSPECT(SEXP);
+void ALTSTRING_SET_ELT(SEXP, R_xlen_t, SEXP);
+void InitAltrep(void);
+
+/* main/altclasses.c */
+SEXP R_compact_intrange(R_xlen_t, R_xlen_t);
+SEXP R_compact_realseq(R_xlen_t, double, double);
+SEXP R_compact_seq_tail(SEXP, R_xlen_t);
+SEXP R_deferred_coerceToString(SEXP);
+SEXP R_wrap_meta(SEXP, int, int);
+void R_init_altclasses(void);
+
 /* main/sort.c */
 void orderVector1(int *indx, int n, SEXP key, Rboolean nalast,
 		  Rboolean decreasing, SEXP rho);
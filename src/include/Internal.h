@@ -76,6 +76,9 @@ SEXP do_basename(SEXP, SEXP, SEXP, SEXP);
 SEXP do_bcprofcounts(SEXP, SEXP, SEXP, SEXP);
 SEXP do_bcprofstart(SEXP, SEXP, SEXP, SEXP);
 SEXP do_bcprofstop(SEXP, SEXP, SEXP, SEXP);
+SEXP do_bccountstart(SEXP, SEXP, SEXP, SEXP);
+SEXP do_bccountstop(SEXP, SEXP, SEXP, SEXP);
+SEXP do_bccounts(SEXP, SEXP, SEXP, SEXP);
 SEXP do_begin(SEXP, SEXP, SEXP, SEXP);
 SEXP do_bincode(SEXP, SEXP, SEXP, SEXP);
 SEXP do_bind(SEXP, SEXP, SEXP, SEXP);
@@ -179,6 +182,8 @@ SEXP do_function(SEXP, SEXP, SEXP, SEXP);
 SEXP do_gc(SEXP, SEXP, SEXP, SEXP);
 SEXP do_gcinfo(SEXP, SEXP, SEXP, SEXP);
 SEXP do_gctime(SEXP, SEXP, SEXP, SEXP);
+SEXP do_gctrace(SEXP, SEXP, SEXP, SEXP);
+SEXP do_gcevents(SEXP, SEXP, SEXP, SEXP);
 SEXP do_gctorture(SEXP, SEXP, SEXP, SEXP);
 SEXP do_gctorture2(SEXP, SEXP, SEXP, SEXP);
 SEXP do_get(SEXP, SEXP, SEXP, SEXP);
@@ -224,6 +229,7 @@ SEXP do_isloaded(SEXP, SEXP, SEXP, SEXP);
 SEXP do_isna(SEXP, SEXP, SEXP, SEXP);
 SEXP do_isnan(SEXP, SEXP, SEXP, SEXP);
 SEXP do_isunsorted(SEXP, SEXP, SEXP, SEXP);
+SEXP do_wrap_meta(SEXP, SEXP, SEXP, SEXP);
 SEXP do_isvector(SEXP, SEXP, SEXP, SEXP);
 SEXP do_lapack(SEXP, SEXP, SEXP, SEXP);
 SEXP do_lapply(SEXP, SEXP, SEXP, SEXP);
@@ -462,6 +468,7 @@ SEXP do_stdout(SEXP, SEXP, SEXP, SEXP);
 SEXP do_stderr(SEXP, SEXP, SEXP, SEXP);
 SEXP do_writelines(SEXP, SEXP, SEXP, SEXP);
 SEXP do_readbin(SEXP, SEXP, SEXP, SEXP);
+SEXP do_mmapbin(SEXP, SEXP, SEXP, SEXP);
 SEXP do_writebin(SEXP, SEXP, SEXP, SEXP);
 SEXP do_readchar(SEXP, SEXP, SEXP, SEXP);
 SEXP do_writechar(SEXP, SEXP, SEXP, SEXP);
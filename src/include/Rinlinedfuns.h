@@ -74,6 +74,51 @@
 
 /* define inline-able functions */
 
+/* Vector accessors used by the macros in Rinternals.h; standard vectors
+   have their data after the header, ALTREP objects dispatch to their
+   class (altrep.c), and are taken to be the exception. */
+#ifdef __GNUC__
+# define STDVEC_EXPECTED(x) __builtin_expect(! ALTREP(x), 1)
+#else
+# define STDVEC_EXPECTED(x) (! ALTREP(x))
+#endif
+
+INLINE_FUN void *R_altrep_or_std_dataptr(SEXP x)
+{
+    return STDVEC_EXPECTED(x) ?
+	STDVEC_DATAPTR(x) : ALTVEC_DATAPTR(x);
+}
+
+INLINE_FUN const void *R_altrep_or_std_dataptr_ro(SEXP x)
+{
+    return STDVEC_EXPECTED(x) ?
+	STDVEC_DATAPTR(x) : ALTVEC_DATAPTR_RO(x);
+}
+
+INLINE_FUN const void *R_altrep_or_std_dataptr_or_null(SEXP x)
+{
+    return STDVEC_EXPECTED(x) ?
+	STDVEC_DATAPTR(x) : ALTVEC_DATAPTR_OR_NULL(x);
+}
+
+INLINE_FUN int R_altrep_or_std_integer_elt(SEXP x, R_xlen_t i)
+{
+    return STDVEC_EXPECTED(x) ?
+	((int *) STDVEC_DATAPTR(x))[i] : ALTINTEGER_ELT(x, i);
+}
+
+INLINE_FUN double R_altrep_or_std_real_elt(SEXP x, R_xlen_t i)
+{
+    return STDVEC_EXPECTED(x) ?
+	((double *) STDVEC_DATAPTR(x))[i] : ALTREAL_ELT(x, i);
+}
+
+INLINE_FUN SEXP R_altrep_or_std_string_elt(SEXP x, R_xlen_t i)
+{
+    return STDVEC_EXPECTED(x) ?
+	((SEXP *) STDVEC_DATAPTR(x))[i] : ALTSTRING_ELT(x, i);
+}
+
 #ifdef INLINE_PROTECT
 extern int R_PPStackSize;
 extern int R_PPStackTop;
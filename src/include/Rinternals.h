@@ -255,8 +255,12 @@ struct promsxp_struct {
 
 /* Define SWITH_TO_REFCNT to use reference counting instead of the
    'NAMED' mechanism. This uses the R-devel binary layout. The two
-   'named' field bits are used for the REFCNT, so REFCNTMAX is 3. */
-//#define SWITCH_TO_REFCNT
+   'named' field bits are used for the REFCNT, so REFCNTMAX is 3.
+   Reference counting is now the default; compile with
+   -DUSE_NAMED_NOT_REFCNT to use 'NAMED' instead. */
+#ifndef USE_NAMED_NOT_REFCNT
+# define SWITCH_TO_REFCNT
+#endif
 
 #if defined(SWITCH_TO_REFCNT) && ! defined(COMPUTE_REFCNT_VALUES)
 # define COMPUTE_REFCNT_VALUES
@@ -347,17 +351,40 @@ typedef union { VECTOR_SEXPREC s; double align; } SEXPREC_ALIGN;
 #define SET_GROWABLE_BIT(x) (((x)->sxpinfo.gp) |= GROWABLE_MASK)
 #define IS_GROWABLE(x) (GROWABLE_BIT_SET(x) && XLENGTH(x) < XTRUELENGTH(x))
 
+/* Alternative representations of vectors, see altrep.c.  The flag
+   shares the debug bit with closures and environments, so it only
+   counts for the vector types an ALTREP class can have. */
+#define ALTREP_TYPES_MASK \
+    ((1U << LGLSXP) | (1U << INTSXP) | (1U << REALSXP) | (1U << CPLXSXP) | \
+     (1U << STRSXP) | (1U << VECSXP) | (1U << EXPRSXP) | (1U << RAWSXP))
+#define ALTREP(x)	((x)->sxpinfo.debug && \
+			 ((1U << TYPEOF(x)) & ALTREP_TYPES_MASK))
+#define SET_ALTREP(x,v)	(((x)->sxpinfo.debug)=(v))
+
+R_xlen_t ALTREP_LENGTH(SEXP x);
+void *ALTVEC_DATAPTR(SEXP x);
+const void *ALTVEC_DATAPTR_RO(SEXP x);
+const void *ALTVEC_DATAPTR_OR_NULL(SEXP x);
+int ALTINTEGER_ELT(SEXP x, R_xlen_t i);
+double ALTREAL_ELT(SEXP x, R_xlen_t i);
+SEXP ALTSTRING_ELT(SEXP x, R_xlen_t i);
+
 /* Vector Access Macros */
+/* The STDVEC_ macros are for vectors known not to be ALTREP objects,
+   such as CHARSXPs and newly allocated vectors. */
 #ifdef LONG_VECTOR_SUPPORT
-# define IS_LONG_VEC(x) (SHORT_VEC_LENGTH(x) == R_LONG_VEC_TOKEN)
+# define IS_LONG_STDVEC(x) (SHORT_VEC_LENGTH(x) == R_LONG_VEC_TOKEN)
+# define IS_LONG_VEC(x) (ALTREP(x) ? ALTREP_LENGTH(x) > R_SHORT_LEN_MAX : IS_LONG_STDVEC(x))
 # define SHORT_VEC_LENGTH(x) (((VECSEXP) (x))->vecsxp.length)
 # define SHORT_VEC_TRUELENGTH(x) (((VECSEXP) (x))->vecsxp.truelength)
 # define LONG_VEC_LENGTH(x) ((R_long_vec_hdr_t *) (x))[-1].lv_length
 # define LONG_VEC_TRUELENGTH(x) ((R_long_vec_hdr_t *) (x))[-1].lv_truelength
-# define XLENGTH(x) (IS_LONG_VEC(x) ? LONG_VEC_LENGTH(x) : SHORT_VEC_LENGTH(x))
-# define XTRUELENGTH(x)	(IS_LONG_VEC(x) ? LONG_VEC_TRUELENGTH(x) : SHORT_VEC_TRUELENGTH(x))
-# define LENGTH(x) (IS_LONG_VEC(x) ? R_BadLongVector(x, __FILE__, __LINE__) : SHORT_VEC_LENGTH(x))
-# define TRUELENGTH(x) (IS_LONG_VEC(x) ? R_BadLongVector(x, __FILE__, __LINE__) : SHORT_VEC_TRUELENGTH(x))
+# define STDVEC_LENGTH(x) (IS_LONG_STDVEC(x) ? LONG_VEC_LENGTH(x) : SHORT_VEC_LENGTH(x))
+# define STDVEC_TRUELENGTH(x) (IS_LONG_STDVEC(x) ? LONG_VEC_TRUELENGTH(x) : SHORT_VEC_TRUELENGTH(x))
+# define XLENGTH(x) (ALTREP(x) ? ALTREP_LENGTH(x) : STDVEC_LENGTH(x))
+# define XTRUELENGTH(x)	(ALTREP(x) ? 0 : STDVEC_TRUELENGTH(x))
+# define LENGTH(x) (IS_LONG_VEC(x) ? R_BadLongVector(x, __FILE__, __LINE__) : (R_len_t) XLENGTH(x))
+# define TRUELENGTH(x) (ALTREP(x) ? 0 : IS_LONG_STDVEC(x) ? R_BadLongVector(x, __FILE__, __LINE__) : SHORT_VEC_TRUELENGTH(x))
 # define SET_SHORT_VEC_LENGTH(x,v) (SHORT_VEC_LENGTH(x) = (v))
 # define SET_SHORT_VEC_TRUELENGTH(x,v) (SHORT_VEC_TRUELENGTH(x) = (v))
 # define SET_LONG_VEC_LENGTH(x,v) (LONG_VEC_LENGTH(x) = (v))
@@ -365,46 +392,85 @@ typedef union { VECTOR_SEXPREC s; double align; } SEXPREC_ALIGN;
 # define SETLENGTH(x,v) do { \
       SEXP sl__x__ = (x); \
       R_xlen_t sl__v__ = (v); \
-      if (IS_LONG_VEC(sl__x__)) \
+      if (ALTREP(sl__x__)) \
+	  Rf_error("SETLENGTH() cannot be applied to an ALTREP object"); \
+      if (IS_LONG_STDVEC(sl__x__)) \
 	  SET_LONG_VEC_LENGTH(sl__x__,  sl__v__); \
       else SET_SHORT_VEC_LENGTH(sl__x__, (R_len_t) sl__v__); \
   } while (0)
 # define SET_TRUELENGTH(x,v) do { \
       SEXP sl__x__ = (x); \
       R_xlen_t sl__v__ = (v); \
-      if (IS_LONG_VEC(sl__x__)) \
+      if (ALTREP(sl__x__)) \
+	  Rf_error("SET_TRUELENGTH() cannot be applied to an ALTREP object"); \
+      if (IS_LONG_STDVEC(sl__x__)) \
 	  SET_LONG_VEC_TRUELENGTH(sl__x__, sl__v__); \
       else SET_SHORT_VEC_TRUELENGTH(sl__x__, (R_len_t) sl__v__); \
   } while (0)
-# define IS_SCALAR(x, type) (TYPEOF(x) == (type) && SHORT_VEC_LENGTH(x) == 1)
+# define IS_SCALAR(x, type) (TYPEOF(x) == (type) && ! ALTREP(x) && \
+			     SHORT_VEC_LENGTH(x) == 1)
 #else
 # define SHORT_VEC_LENGTH(x) (((VECSEXP) (x))->vecsxp.length)
-# define LENGTH(x)	(((VECSEXP) (x))->vecsxp.length)
-# define TRUELENGTH(x)	(((VECSEXP) (x))->vecsxp.truelength)
+# define SHORT_VEC_TRUELENGTH(x) (((VECSEXP) (x))->vecsxp.truelength)
+# define STDVEC_LENGTH(x) SHORT_VEC_LENGTH(x)
+# define STDVEC_TRUELENGTH(x) SHORT_VEC_TRUELENGTH(x)
+# define LENGTH(x)	(ALTREP(x) ? (R_len_t) ALTREP_LENGTH(x) : STDVEC_LENGTH(x))
+# define TRUELENGTH(x)	(ALTREP(x) ? 0 : STDVEC_TRUELENGTH(x))
 # define XLENGTH(x) LENGTH(x)
 # define XTRUELENGTH(x) TRUELENGTH(x)
-# define SETLENGTH(x,v)		((((VECSEXP) (x))->vecsxp.length)=(v))
-# define SET_TRUELENGTH(x,v)	((((VECSEXP) (x))->vecsxp.truelength)=(v))
-# define SET_SHORT_VEC_LENGTH SETLENGTH
-# define SET_SHORT_VEC_TRUELENGTH SET_TRUELENGTH
+# define SETLENGTH(x,v) do { \
+      SEXP sl__x__ = (x); \
+      if (ALTREP(sl__x__)) \
+	  Rf_error("SETLENGTH() cannot be applied to an ALTREP object"); \
+      SHORT_VEC_LENGTH(sl__x__) = (v); \
+  } while (0)
+# define SET_TRUELENGTH(x,v) do { \
+      SEXP sl__x__ = (x); \
+      if (ALTREP(sl__x__)) \
+	  Rf_error("SET_TRUELENGTH() cannot be applied to an ALTREP object"); \
+      SHORT_VEC_TRUELENGTH(sl__x__) = (v); \
+  } while (0)
+# define SET_SHORT_VEC_LENGTH(x,v) (SHORT_VEC_LENGTH(x) = (v))
+# define SET_SHORT_VEC_TRUELENGTH(x,v) (SHORT_VEC_TRUELENGTH(x) = (v))
 # define IS_LONG_VEC(x) 0
-# define IS_SCALAR(x, type) (TYPEOF(x) == (type) && LENGTH(x) == 1)
+# define IS_SCALAR(x, type) (TYPEOF(x) == (type) && ! ALTREP(x) && \
+			     SHORT_VEC_LENGTH(x) == 1)
 #endif
 
 /* Under the generational allocator the data for vector nodes comes
    immediately after the node structure, so the data address is a
-   known offset from the node SEXP. */
-#define DATAPTR(x)	(((SEXPREC_ALIGN *) (x)) + 1)
-#define CHAR(x)		((const char *) DATAPTR(x))
+   known offset from the node SEXP.  The data of ALTREP objects are
+   provided by their class. */
+#define STDVEC_DATAPTR(x) ((void *) (((SEXPREC_ALIGN *) (x)) + 1))
+
+/* The value of an object for which IS_SCALAR is true; ALTREP objects
+   are never IS_SCALAR, so these need not dispatch. */
+#define SCALAR_LVAL(x)	(((int *) STDVEC_DATAPTR(x))[0])
+#define SCALAR_IVAL(x)	(((int *) STDVEC_DATAPTR(x))[0])
+#define SCALAR_DVAL(x)	(((double *) STDVEC_DATAPTR(x))[0])
+
+/* These call functions so that their arguments are evaluated once;
+   the functions are inlined in R itself, see Rinlinedfuns.h. */
+#define DATAPTR(x)	R_altrep_or_std_dataptr(x)
+#define DATAPTR_RO(x)	R_altrep_or_std_dataptr_ro(x)
+#define DATAPTR_OR_NULL(x) R_altrep_or_std_dataptr_or_null(x)
+#define CHAR(x)		((const char *) STDVEC_DATAPTR(x))
 #define LOGICAL(x)	((int *) DATAPTR(x))
 #define INTEGER(x)	((int *) DATAPTR(x))
 #define RAW(x)		((Rbyte *) DATAPTR(x))
 #define COMPLEX(x)	((Rcomplex *) DATAPTR(x))
 #define REAL(x)		((double *) DATAPTR(x))
-#define STRING_ELT(x,i)	((SEXP *) DATAPTR(x))[i]
-#define VECTOR_ELT(x,i)	((SEXP *) DATAPTR(x))[i]
+#define LOGICAL_RO(x)	((const int *) DATAPTR_RO(x))
+#define INTEGER_RO(x)	((const int *) DATAPTR_RO(x))
+#define RAW_RO(x)	((const Rbyte *) DATAPTR_RO(x))
+#define COMPLEX_RO(x)	((const Rcomplex *) DATAPTR_RO(x))
+#define REAL_RO(x)	((const double *) DATAPTR_RO(x))
+#define INTEGER_ELT(x,i) R_altrep_or_std_integer_elt(x, i)
+#define REAL_ELT(x,i)	R_altrep_or_std_real_elt(x, i)
+#define STRING_ELT(x,i)	R_altrep_or_std_string_elt(x, i)
+#define VECTOR_ELT(x,i)	((SEXP *) STDVEC_DATAPTR(x))[i]
 #define STRING_PTR(x)	((SEXP *) DATAPTR(x))
-#define VECTOR_PTR(x)	((SEXP *) DATAPTR(x))
+#define VECTOR_PTR(x)	((SEXP *) STDVEC_DATAPTR(x))
 
 /* List Access Macros */
 /* These also work for ... objects */
@@ -474,7 +540,7 @@ Rboolean (Rf_isEnvironment)(SEXP s);
 Rboolean (Rf_isString)(SEXP s);
 Rboolean (Rf_isObject)(SEXP s);
 
-# define IS_SCALAR(x, type) (TYPEOF(x) == (type) && XLENGTH(x) == 1)
+# define IS_SCALAR(x, type) (TYPEOF(x) == (type) && ! ALTREP(x) && XLENGTH(x) == 1)
 #endif /* USE_RINTERNALS */
 
 #define IS_SIMPLE_SCALAR(x, type) \
@@ -584,6 +650,13 @@ int  *(INTEGER)(SEXP x);
 Rbyte *(RAW)(SEXP x);
 double *(REAL)(SEXP x);
 Rcomplex *(COMPLEX)(SEXP x);
+const int *(LOGICAL_RO)(SEXP x);
+const int *(INTEGER_RO)(SEXP x);
+const Rbyte *(RAW_RO)(SEXP x);
+const double *(REAL_RO)(SEXP x);
+const Rcomplex *(COMPLEX_RO)(SEXP x);
+int (INTEGER_ELT)(SEXP x, R_xlen_t i);
+double (REAL_ELT)(SEXP x, R_xlen_t i);
 SEXP (STRING_ELT)(SEXP x, R_xlen_t i);
 SEXP (VECTOR_ELT)(SEXP x, R_xlen_t i);
 void SET_STRING_ELT(SEXP x, R_xlen_t i, SEXP v);
@@ -595,6 +668,27 @@ SEXP * NORET (VECTOR_PTR)(SEXP x);
     R_len_t NORET R_BadLongVector(SEXP, const char *, int);
 #endif
 
+/* Alternative representation support, see altrep.c */
+int (ALTREP)(SEXP x);
+const void *(DATAPTR_RO)(SEXP x);
+const void *(DATAPTR_OR_NULL)(SEXP x);
+R_xlen_t INTEGER_GET_REGION(SEXP x, R_xlen_t i, R_xlen_t n, int *buf);
+R_xlen_t REAL_GET_REGION(SEXP x, R_xlen_t i, R_xlen_t n, double *buf);
+int INTEGER_IS_SORTED(SEXP x);
+int INTEGER_NO_NA(SEXP x);
+int REAL_IS_SORTED(SEXP x);
+int REAL_NO_NA(SEXP x);
+int STRING_IS_SORTED(SEXP x);
+int STRING_NO_NA(SEXP x);
+
+/* values returned by the *_IS_SORTED functions */
+#define SORTED_DECR_NA_1ST -2
+#define SORTED_DECR        -1
+#define UNKNOWN_SORTEDNESS INT_MIN
+#define SORTED_INCR         1
+#define SORTED_INCR_NA_1ST  2
+#define KNOWN_UNSORTED      0
+
 /* List Access Functions */
 /* These also work for ... objects */
 #define CONS(a, b)	cons((a), (b))		/* data lists */
@@ -684,7 +778,10 @@ void (SET_HASHVALUE)(SEXP x, int v);
 /* Bytecode access macros */
 #define BCODE_CODE(x)	CAR(x)
 #define BCODE_CONSTS(x) CDR(x)
-#define BCODE_EXPR(x)	TAG(x)
+#define BCODE_FUNCACHE(x) TAG(x)
+/* TAG holds the function lookup cache; the expression is the first
+   constant */
+#define BCODE_EXPR(x)	R_BytecodeExpr(x)
 #define isByteCode(x)	(TYPEOF(x)==BCODESXP)
 
 /* Pointer Protection and Unprotection */
@@ -1363,6 +1460,12 @@ void R_orderVector1(int *indx, int n, SEXP x,       Rboolean nalast, Rboolean de
    It is *essential* that these do not appear in any other header file,
    with or without the Rf_ prefix.
 */
+void *R_altrep_or_std_dataptr(SEXP);
+const void *R_altrep_or_std_dataptr_ro(SEXP);
+const void *R_altrep_or_std_dataptr_or_null(SEXP);
+int R_altrep_or_std_integer_elt(SEXP, R_xlen_t);
+double R_altrep_or_std_real_elt(SEXP, R_xlen_t);
+SEXP R_altrep_or_std_string_elt(SEXP, R_xlen_t);
 SEXP     Rf_allocVector(SEXPTYPE, R_xlen_t);
 Rboolean Rf_conformable(SEXP, SEXP);
 SEXP	 Rf_elt(SEXP, int);
@@ -0,0 +1,955 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2017  The R Core Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  https://www.R-project.org/Licenses/
+ */
+
+/* ALTREP classes used by the base system; the framework is in
+   altrep.c. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <Defn.h>
+#include <Print.h>
+#include <float.h> /* for DBL_DIG */
+
+/* Compact and deferred representations only pay for their indirection
+   for longer vectors; shorter results are allocated as usual. */
+#define ALTREP_MIN_LENGTH 64
+
+
+/*
+ * Compact integer and real sequences
+ */
+
+/* data1 is a real vector holding the length, first value and increment
+   (1 or -1); data2 is R_NilValue or, once a data pointer has been
+   requested, the expanded standard vector.  Compact sequences are
+   marked as not mutable, so the expanded data are never modified. */
+
+static SEXP compact_intseq_class = NULL;
+static SEXP compact_realseq_class = NULL;
+
+#define COMPACT_SEQ_INFO(x) ((double *) STDVEC_DATAPTR(R_altrep_data1(x)))
+#define COMPACT_SEQ_EXPANDED(x) R_altrep_data2(x)
+#define COMPACT_SEQ_LENGTH(x) ((R_xlen_t) COMPACT_SEQ_INFO(x)[0])
+#define COMPACT_SEQ_FIRST(x) COMPACT_SEQ_INFO(x)[1]
+#define COMPACT_SEQ_INCR(x) COMPACT_SEQ_INFO(x)[2]
+
+static R_xlen_t compact_seq_Length(SEXP x)
+{
+    return COMPACT_SEQ_LENGTH(x);
+}
+
+static const void *compact_seq_Dataptr_or_null(SEXP x)
+{
+    SEXP val = COMPACT_SEQ_EXPANDED(x);
+    return val == R_NilValue ? NULL : STDVEC_DATAPTR(val);
+}
+
+static int compact_seq_Is_sorted(SEXP x)
+{
+    return COMPACT_SEQ_INCR(x) > 0 ? SORTED_INCR : SORTED_DECR;
+}
+
+static int compact_seq_No_NA(SEXP x)
+{
+    return TRUE;
+}
+
+static Rboolean compact_seq_Inspect(SEXP x)
+{
+    R_xlen_t n = COMPACT_SEQ_LENGTH(x);
+    double n1 = COMPACT_SEQ_FIRST(x);
+    double n2 = n1 + COMPACT_SEQ_INCR(x) * (n - 1);
+    const char *how = COMPACT_SEQ_EXPANDED(x) == R_NilValue ?
+	"compact" : "expanded";
+    if (TYPEOF(x) == INTSXP)
+	Rprintf(" %d : %d (%s)", (int) n1, (int) n2, how);
+    else
+	Rprintf(" %g : %g (%s)", n1, n2, how);
+    return TRUE;
+}
+
+static void *compact_intseq_Dataptr(SEXP x, Rboolean writeable)
+{
+    if (COMPACT_SEQ_EXPANDED(x) == R_NilValue) {
+	R_xlen_t n = COMPACT_SEQ_LENGTH(x);
+	int n1 = (int) COMPACT_SEQ_FIRST(x);
+	int inc = (int) COMPACT_SEQ_INCR(x);
+	PROTECT(x);
+	SEXP val = allocVector(INTSXP, n);
+	int *data = (int *) STDVEC_DATAPTR(val);
+	for (R_xlen_t i = 0; i < n; i++)
+	    data[i] = (int) (n1 + inc * i);
+	R_set_altrep_data2(x, val);
+	UNPROTECT(1);
+    }
+    return STDVEC_DATAPTR(COMPACT_SEQ_EXPANDED(x));
+}
+
+static int compact_intseq_Elt(SEXP x, R_xlen_t i)
+{
+    SEXP val = COMPACT_SEQ_EXPANDED(x);
+    if (val != R_NilValue)
+	return ((int *) STDVEC_DATAPTR(val))[i];
+    return (int) (COMPACT_SEQ_FIRST(x) + COMPACT_SEQ_INCR(x) * i);
+}
+
+static R_xlen_t compact_intseq_Get_region(SEXP x, R_xlen_t i, R_xlen_t n,
+					  void *buf)
+{
+    R_xlen_t size = COMPACT_SEQ_LENGTH(x);
+    R_xlen_t ncopy = size - i > n ? n : size - i;
+    int *ibuf = (int *) buf;
+    SEXP val = COMPACT_SEQ_EXPANDED(x);
+    if (ncopy <= 0)
+	return 0;
+    if (val != R_NilValue)
+	memcpy(ibuf, (int *) STDVEC_DATAPTR(val) + i, ncopy * sizeof(int));
+    else {
+	int ni = (int) (COMPACT_SEQ_FIRST(x) + COMPACT_SEQ_INCR(x) * i);
+	if (COMPACT_SEQ_INCR(x) > 0)
+	    for (R_xlen_t k = 0; k < ncopy; k++)
+		ibuf[k] = ni + (int) k;
+	else
+	    for (R_xlen_t k = 0; k < ncopy; k++)
+		ibuf[k] = ni - (int) k;
+    }
+    return ncopy;
+}
+
+/* A duplicate is usually about to be modified, so make it standard. */
+static SEXP compact_intseq_Duplicate(SEXP x, Rboolean deep)
+{
+    R_xlen_t n = COMPACT_SEQ_LENGTH(x);
+    PROTECT(x);
+    SEXP val = allocVector(INTSXP, n);
+    compact_intseq_Get_region(x, 0, n, STDVEC_DATAPTR(val));
+    UNPROTECT(1);
+    return val;
+}
+
+static void *compact_realseq_Dataptr(SEXP x, Rboolean writeable)
+{
+    if (COMPACT_SEQ_EXPANDED(x) == R_NilValue) {
+	R_xlen_t n = COMPACT_SEQ_LENGTH(x);
+	double n1 = COMPACT_SEQ_FIRST(x);
+	double inc = COMPACT_SEQ_INCR(x);
+	PROTECT(x);
+	SEXP val = allocVector(REALSXP, n);
+	double *data = (double *) STDVEC_DATAPTR(val);
+	for (R_xlen_t i = 0; i < n; i++)
+	    data[i] = n1 + inc * (double) i;
+	R_set_altrep_data2(x, val);
+	UNPROTECT(1);
+    }
+    return STDVEC_DATAPTR(COMPACT_SEQ_EXPANDED(x));
+}
+
+static double compact_realseq_Elt(SEXP x, R_xlen_t i)
+{
+    SEXP val = COMPACT_SEQ_EXPANDED(x);
+    if (val != R_NilValue)
+	return ((double *) STDVEC_DATAPTR(val))[i];
+    return COMPACT_SEQ_FIRST(x) + COMPACT_SEQ_INCR(x) * (double) i;
+}
+
+static R_xlen_t compact_realseq_Get_region(SEXP x, R_xlen_t i, R_xlen_t n,
+					   void *buf)
+{
+    R_xlen_t size = COMPACT_SEQ_LENGTH(x);
+    R_xlen_t ncopy = size - i > n ? n : size - i;
+    double *dbuf = (double *) buf;
+    SEXP val = COMPACT_SEQ_EXPANDED(x);
+    if (ncopy <= 0)
+	return 0;
+    if (val != R_NilValue)
+	memcpy(dbuf, (double *) STDVEC_DATAPTR(val) + i,
+	       ncopy * sizeof(double));
+    else {
+	double n1 = COMPACT_SEQ_FIRST(x), inc = COMPACT_SEQ_INCR(x);
+	for (R_xlen_t k = 0; k < ncopy; k++)
+	    dbuf[k] = n1 + inc * (double) (i + k);
+    }
+    return ncopy;
+}
+
+static SEXP compact_realseq_Duplicate(SEXP x, Rboolean deep)
+{
+    R_xlen_t n = COMPACT_SEQ_LENGTH(x);
+    PROTECT(x);
+    SEXP val = allocVector(REALSXP, n);
+    compact_realseq_Get_region(x, 0, n, STDVEC_DATAPTR(val));
+    UNPROTECT(1);
+    return val;
+}
+
+static SEXP new_compact_seq(SEXP cls, R_xlen_t n, double n1, double inc)
+{
+    SEXP info = allocVector(REALSXP, 3);
+    double *pi = REAL(info);
+    pi[0] = (double) n;
+    pi[1] = n1;
+    pi[2] = inc;
+    PROTECT(info);
+    SEXP ans = R_new_altrep(cls, info, R_NilValue);
+    MARK_NOT_MUTABLE(ans);
+    UNPROTECT(1);
+    return ans;
+}
+
+/* The integer vector n1:n2 */
+SEXP attribute_hidden R_compact_intrange(R_xlen_t n1, R_xlen_t n2)
+{
+    R_xlen_t n = n1 <= n2 ? n2 - n1 + 1 : n1 - n2 + 1;
+    int inc = n1 <= n2 ? 1 : -1;
+
+    if (n1 <= INT_MIN || n1 > INT_MAX || n2 <= INT_MIN || n2 > INT_MAX)
+	return R_compact_realseq(n, (double) n1, inc);
+
+    if (n < ALTREP_MIN_LENGTH) {
+	SEXP ans = allocVector(INTSXP, n);
+	int *data = INTEGER(ans);
+	for (int i = 0; i < n; i++)
+	    data[i] = (int) n1 + inc * i;
+	return ans;
+    }
+    return new_compact_seq(compact_intseq_class, n, (double) n1, inc);
+}
+
+/* The real vector n1, n1 + inc, ..., of length n, for inc 1 or -1 */
+SEXP attribute_hidden R_compact_realseq(R_xlen_t n, double n1, double inc)
+{
+    if (n < ALTREP_MIN_LENGTH) {
+	SEXP ans = allocVector(REALSXP, n);
+	double *data = REAL(ans);
+	for (R_xlen_t i = 0; i < n; i++)
+	    data[i] = n1 + inc * (double) i;
+	return ans;
+    }
+    return new_compact_seq(compact_realseq_class, n, n1, inc);
+}
+
+
+/* The elements of x from index i on, as a compact sequence, if x is a
+   compact sequence, and otherwise R_NilValue */
+SEXP attribute_hidden R_compact_seq_tail(SEXP x, R_xlen_t i)
+{
+    if (! ALTREP(x) || (ALTREP_CLASS(x) != compact_intseq_class &&
+			ALTREP_CLASS(x) != compact_realseq_class))
+	return R_NilValue;
+
+    R_xlen_t n = COMPACT_SEQ_LENGTH(x);
+    double inc = COMPACT_SEQ_INCR(x);
+    double n1 = COMPACT_SEQ_FIRST(x) + inc * (double) i;
+    if (ALTREP_CLASS(x) == compact_intseq_class)
+	return R_compact_intrange((R_xlen_t) n1,
+				  (R_xlen_t) (n1 + inc * (double) (n - i - 1)));
+    else
+	return R_compact_realseq(n - i, n1, inc);
+}
+
+/*
+ * Deferred string conversion
+ */
+
+/* The result of as.character() on an integer or real vector without
+   attributes; elements are converted as they are accessed.  data1 is
+   R_NilValue once all elements have been converted, and otherwise a
+   pair of the argument, marked as not mutable, and the 'scipen' option
+   in effect when the object was created.  data2 is R_NilValue or a
+   standard string vector of the elements converted so far, with NULL
+   for the others. */
+
+static SEXP deferred_string_class = NULL;
+
+#define DEFERRED_STRING_STATE(x) R_altrep_data1(x)
+#define DEFERRED_STRING_EXPANDED(x) R_altrep_data2(x)
+#define DEFERRED_STRING_STATE_ARG(s) CAR(s)
+#define DEFERRED_STRING_STATE_SCIPEN(s) INTEGER(CDR(s))[0]
+
+/* Convert as coerceToString would: reals with 15 significant digits
+   and "." as the decimal mark.  The caller saves and restores the
+   print parameters around a batch of conversions. */
+#define BEGIN_DEFERRED_CONVERSION(state) \
+    int dc__digits__ = R_print.digits, dc__scipen__ = R_print.scipen; \
+    char *dc__outdec__ = OutDec; \
+    R_print.digits = DBL_DIG; \
+    R_print.scipen = DEFERRED_STRING_STATE_SCIPEN(state); \
+    OutDec = "."
+
+#define END_DEFERRED_CONVERSION() do { \
+	R_print.digits = dc__digits__; \
+	R_print.scipen = dc__scipen__; \
+	OutDec = dc__outdec__; \
+    } while (0)
+
+static R_INLINE SEXP deferred_string_convert(SEXP arg, R_xlen_t i)
+{
+    int warn = 0;
+    if (TYPEOF(arg) == INTSXP)
+	return StringFromInteger(INTEGER_ELT(arg, i), &warn);
+    else
+	return StringFromReal(REAL_ELT(arg, i), &warn);
+}
+
+static R_xlen_t deferred_string_Length(SEXP x)
+{
+    SEXP state = DEFERRED_STRING_STATE(x);
+    return state == R_NilValue ?
+	XLENGTH(DEFERRED_STRING_EXPANDED(x)) :
+	XLENGTH(DEFERRED_STRING_STATE_ARG(state));
+}
+
+static SEXP deferred_string_expanded(SEXP x)
+{
+    SEXP val = DEFERRED_STRING_EXPANDED(x);
+    if (val == R_NilValue) {
+	SEXP arg = DEFERRED_STRING_STATE_ARG(DEFERRED_STRING_STATE(x));
+	R_xlen_t n = XLENGTH(arg);
+	PROTECT(x);
+	val = allocVector(STRSXP, n);
+	SEXP *data = (SEXP *) STDVEC_DATAPTR(val);
+	for (R_xlen_t i = 0; i < n; i++)
+	    data[i] = NULL;
+	R_set_altrep_data2(x, val);
+	UNPROTECT(1);
+    }
+    return val;
+}
+
+static void *deferred_string_Dataptr(SEXP x, Rboolean writeable)
+{
+    SEXP state = DEFERRED_STRING_STATE(x);
+    if (state != R_NilValue) {
+	SEXP arg = DEFERRED_STRING_STATE_ARG(state);
+	PROTECT(x);
+	SEXP val = deferred_string_expanded(x);
+	SEXP *data = (SEXP *) STDVEC_DATAPTR(val);
+	R_xlen_t n = XLENGTH(val);
+	BEGIN_DEFERRED_CONVERSION(state);
+	for (R_xlen_t i = 0; i < n; i++)
+	    if (data[i] == NULL)
+		SET_STRING_ELT(val, i, deferred_string_convert(arg, i));
+	END_DEFERRED_CONVERSION();
+	R_set_altrep_data1(x, R_NilValue);
+	UNPROTECT(1);
+    }
+    return STDVEC_DATAPTR(DEFERRED_STRING_EXPANDED(x));
+}
+
+static const void *deferred_string_Dataptr_or_null(SEXP x)
+{
+    return DEFERRED_STRING_STATE(x) == R_NilValue ?
+	STDVEC_DATAPTR(DEFERRED_STRING_EXPANDED(x)) : NULL;
+}
+
+static SEXP deferred_string_Elt(SEXP x, R_xlen_t i)
+{
+    SEXP state = DEFERRED_STRING_STATE(x);
+    if (state == R_NilValue)
+	return ((SEXP *) STDVEC_DATAPTR(DEFERRED_STRING_EXPANDED(x)))[i];
+
+    PROTECT(x);
+    SEXP val = deferred_string_expanded(x);
+    SEXP elt = ((SEXP *) STDVEC_DATAPTR(val))[i];
+    if (elt == NULL) {
+	BEGIN_DEFERRED_CONVERSION(state);
+	elt = deferred_string_convert(DEFERRED_STRING_STATE_ARG(state), i);
+	END_DEFERRED_CONVERSION();
+	SET_STRING_ELT(val, i, elt);
+    }
+    UNPROTECT(1);
+    return elt;
+}
+
+static void deferred_string_Set_Elt(SEXP x, R_xlen_t i, SEXP v)
+{
+    deferred_string_Dataptr(x, TRUE);
+    SET_STRING_ELT(DEFERRED_STRING_EXPANDED(x), i, v);
+}
+
+static SEXP deferred_string_Duplicate(SEXP x, Rboolean deep)
+{
+    SEXP state = DEFERRED_STRING_STATE(x);
+    if (state == R_NilValue)
+	return NULL;
+    return R_new_altrep(deferred_string_class, state, R_NilValue);
+}
+
+static int deferred_string_No_NA(SEXP x)
+{
+    SEXP state = DEFERRED_STRING_STATE(x);
+    if (state == R_NilValue)
+	return FALSE;
+    SEXP arg = DEFERRED_STRING_STATE_ARG(state);
+    return TYPEOF(arg) == INTSXP ? INTEGER_NO_NA(arg) : REAL_NO_NA(arg);
+}
+
+static Rboolean deferred_string_Inspect(SEXP x)
+{
+    if (DEFERRED_STRING_STATE(x) == R_NilValue)
+	Rprintf(" <expanded string conversion>");
+    else
+	Rprintf(" <deferred string conversion>");
+    return TRUE;
+}
+
+/* Returns NULL if v is not worth converting lazily. */
+SEXP attribute_hidden R_deferred_coerceToString(SEXP v)
+{
+    if ((TYPEOF(v) != INTSXP && TYPEOF(v) != REALSXP) ||
+	ATTRIB(v) != R_NilValue || XLENGTH(v) < ALTREP_MIN_LENGTH ||
+	strcmp(OutDec, "."))
+	return NULL;
+
+    int scipen = 0;
+    if (TYPEOF(v) == REALSXP) {
+	scipen = asInteger(GetOption1(install("scipen")));
+	if (scipen == NA_INTEGER) scipen = 0;
+    }
+    MARK_NOT_MUTABLE(v);
+    SEXP state = PROTECT(CONS(v, ScalarInteger(scipen)));
+    SEXP ans = R_new_altrep(deferred_string_class, state, R_NilValue);
+    UNPROTECT(1);
+    return ans;
+}
+
+
+/*
+ * Wrappers recording sortedness and the absence of NAs
+ */
+
+/* A standard integer or real vector together with what is known about
+   its order and NAs, so that is.unsorted(), anyNA(), min(), max() and
+   match() need not scan it.  data1 is the vector and data2 an integer
+   vector holding the sortedness, as returned by INTEGER_IS_SORTED, and
+   whether there are no NAs.  Wrappers can be modified in place: giving
+   out a writable data pointer forgets the metadata, and first
+   duplicates the vector if it is shared with other objects.  Readers
+   using DATAPTR_RO(), the _ELT accessors or DATAPTR_OR_NULL() keep
+   it. */
+
+static SEXP wrapper_integer_class = NULL;
+static SEXP wrapper_real_class = NULL;
+
+#define WRAPPER_WRAPPED(x) R_altrep_data1(x)
+#define WRAPPER_META(x) ((int *) STDVEC_DATAPTR(R_altrep_data2(x)))
+#define WRAPPER_SORTED(x) WRAPPER_META(x)[0]
+#define WRAPPER_NO_NA(x) WRAPPER_META(x)[1]
+
+static R_xlen_t wrapper_Length(SEXP x)
+{
+    return XLENGTH(WRAPPER_WRAPPED(x));
+}
+
+static void *wrapper_Dataptr(SEXP x, Rboolean writeable)
+{
+    if (writeable) {
+	if (MAYBE_SHARED(WRAPPER_WRAPPED(x)))
+	    R_set_altrep_data1(x, shallow_duplicate(WRAPPER_WRAPPED(x)));
+	WRAPPER_SORTED(x) = UNKNOWN_SORTEDNESS;
+	WRAPPER_NO_NA(x) = 0;
+    }
+    return STDVEC_DATAPTR(WRAPPER_WRAPPED(x));
+}
+
+static const void *wrapper_Dataptr_or_null(SEXP x)
+{
+    return STDVEC_DATAPTR(WRAPPER_WRAPPED(x));
+}
+
+static int wrapper_integer_Elt(SEXP x, R_xlen_t i)
+{
+    return ((int *) STDVEC_DATAPTR(WRAPPER_WRAPPED(x)))[i];
+}
+
+static double wrapper_real_Elt(SEXP x, R_xlen_t i)
+{
+    return ((double *) STDVEC_DATAPTR(WRAPPER_WRAPPED(x)))[i];
+}
+
+static R_xlen_t wrapper_Get_region(SEXP x, R_xlen_t i, R_xlen_t n, void *buf)
+{
+    SEXP val = WRAPPER_WRAPPED(x);
+    return TYPEOF(x) == INTSXP ?
+	INTEGER_GET_REGION(val, i, n, buf) : REAL_GET_REGION(val, i, n, buf);
+}
+
+static int wrapper_Is_sorted(SEXP x)
+{
+    return WRAPPER_SORTED(x);
+}
+
+static int wrapper_No_NA(SEXP x)
+{
+    return WRAPPER_NO_NA(x);
+}
+
+static Rboolean wrapper_Inspect(SEXP x)
+{
+    int sorted = WRAPPER_SORTED(x);
+    if (sorted == UNKNOWN_SORTEDNESS)
+	Rprintf(" wrapper [srt=NA,no_na=%d]", WRAPPER_NO_NA(x));
+    else
+	Rprintf(" wrapper [srt=%d,no_na=%d]", sorted, WRAPPER_NO_NA(x));
+    return TRUE;
+}
+
+/* Returns x with the given sortedness and NA information attached if
+   x is a standard integer or real vector without attributes that is
+   long enough to be worth it, and x itself otherwise. */
+SEXP attribute_hidden R_wrap_meta(SEXP x, int sorted, int no_na)
+{
+    SEXP cls;
+    switch (TYPEOF(x)) {
+    case INTSXP: cls = wrapper_integer_class; break;
+    case REALSXP: cls = wrapper_real_class; break;
+    default: return x;
+    }
+    if (ALTREP(x) || ATTRIB(x) != R_NilValue ||
+	XLENGTH(x) < ALTREP_MIN_LENGTH ||
+	(sorted == UNKNOWN_SORTEDNESS && ! no_na))
+	return x;
+
+    PROTECT(x);
+    SEXP meta = allocVector(INTSXP, 2);
+    INTEGER(meta)[0] = sorted;
+    INTEGER(meta)[1] = no_na;
+    PROTECT(meta);
+    SEXP ans = R_new_altrep(cls, x, meta);
+    UNPROTECT(2);
+    return ans;
+}
+
+/* wrap_meta(x, sorted, no_na); sorted may be NA for unknown */
+SEXP attribute_hidden do_wrap_meta(SEXP call, SEXP op, SEXP args, SEXP env)
+{
+    checkArity(op, args);
+    SEXP x = CAR(args);
+    int sorted = asInteger(CADR(args));
+    int no_na = asLogical(CADDR(args));
+
+    if (sorted == NA_INTEGER)
+	sorted = UNKNOWN_SORTEDNESS;
+    else if (sorted < SORTED_DECR_NA_1ST || sorted > SORTED_INCR_NA_1ST)
+	error(_("invalid '%s' argument"), "sorted");
+    if (no_na == NA_LOGICAL)
+	error(_("invalid '%s' argument"), "no_na");
+    return R_wrap_meta(x, sorted, no_na);
+}
+
+
+/*
+ * Memory-mapped files
+ */
+
+/* The contents of a file mapped into memory, so that creating the
+   vector takes constant time and pages are read when first touched.
+   data1 is an external pointer to the start of the mapping, which its
+   finalizer unmaps; its tag is the file name and its protected value
+   a real vector holding the length of the mapping, the offset of the
+   data in it, the vector length, the offset of the data in the file,
+   whether the mapping is copy-on-write and the device and inode of
+   the file.  data2 is unused.
+
+   Read-only mappings are shared and marked as not mutable.  Their
+   duplicates are copy-on-write mappings of the same data, so R can
+   modify a read-only vector without reading all of it.  Copy-on-write
+   mappings are private and writable: changes are made to copies of
+   the pages written and never reach the file.  As they may have been
+   changed, their duplicates are standard vectors. */
+
+#if defined(HAVE_MMAP) && defined(HAVE_MUNMAP) && ! defined(Win32)
+# define MMAP_FILE_VECTORS
+#endif
+
+static R_INLINE size_t mmap_eltsize(SEXPTYPE type)
+{
+    switch (type) {
+    case REALSXP: return sizeof(double);
+    case RAWSXP: return sizeof(Rbyte);
+    default: return sizeof(int);
+    }
+}
+
+#ifdef MMAP_FILE_VECTORS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static SEXP mmap_logical_class = NULL;
+static SEXP mmap_integer_class = NULL;
+static SEXP mmap_real_class = NULL;
+static SEXP mmap_raw_class = NULL;
+
+#define MMAP_EPTR(x) R_altrep_data1(x)
+#define MMAP_INFO(x) ((double *) STDVEC_DATAPTR(EXTPTR_PROT(MMAP_EPTR(x))))
+#define MMAP_FILE(x) EXTPTR_TAG(MMAP_EPTR(x))
+#define MMAP_DATA(x) \
+    ((char *) EXTPTR_PTR(MMAP_EPTR(x)) + (size_t) MMAP_INFO(x)[1])
+#define MMAP_LENGTH(x) ((R_xlen_t) MMAP_INFO(x)[2])
+#define MMAP_OFFSET(x) MMAP_INFO(x)[3]
+#define MMAP_COW(x) ((int) MMAP_INFO(x)[4])
+#define MMAP_FILE_ID(x) (MMAP_INFO(x) + 5)
+#define MMAP_INFO_LENGTH 7
+
+static void mmap_finalize(SEXP eptr)
+{
+    void *addr = R_ExternalPtrAddr(eptr);
+    if (addr != NULL) {
+	munmap(addr, (size_t) REAL(EXTPTR_PROT(eptr))[0]);
+	R_ClearExternalPtr(eptr);
+    }
+}
+
+static SEXP new_mmap(SEXPTYPE type, SEXP file, int cow, double off,
+		     double n, const double *id, const char **msg);
+
+static R_xlen_t mmap_Length(SEXP x)
+{
+    return MMAP_LENGTH(x);
+}
+
+static void *mmap_Dataptr(SEXP x, Rboolean writeable)
+{
+    return MMAP_DATA(x);
+}
+
+static const void *mmap_Dataptr_or_null(SEXP x)
+{
+    return MMAP_DATA(x);
+}
+
+static int mmap_integer_Elt(SEXP x, R_xlen_t i)
+{
+    return ((int *) MMAP_DATA(x))[i];
+}
+
+static double mmap_real_Elt(SEXP x, R_xlen_t i)
+{
+    return ((double *) MMAP_DATA(x))[i];
+}
+
+static R_xlen_t mmap_Get_region(SEXP x, R_xlen_t i, R_xlen_t n, void *buf)
+{
+    R_xlen_t size = MMAP_LENGTH(x);
+    R_xlen_t ncopy = size - i > n ? n : size - i;
+    size_t eltsize = mmap_eltsize(TYPEOF(x));
+    if (ncopy <= 0)
+	return 0;
+    memcpy(buf, MMAP_DATA(x) + i * eltsize, ncopy * eltsize);
+    return ncopy;
+}
+
+static SEXP mmap_Duplicate(SEXP x, Rboolean deep)
+{
+    const char *msg;
+    if (MMAP_COW(x))
+	return NULL;
+    SEXP val = new_mmap(TYPEOF(x), MMAP_FILE(x), TRUE, MMAP_OFFSET(x),
+			(double) MMAP_LENGTH(x), MMAP_FILE_ID(x), &msg);
+    return val == R_NilValue ? NULL : val;
+}
+
+static Rboolean mmap_Inspect(SEXP x)
+{
+    Rprintf(" mmap '%s' (%s)", CHAR(STRING_ELT(MMAP_FILE(x), 0)),
+	    MMAP_COW(x) ? "copy-on-write" : "read-only");
+    return TRUE;
+}
+
+static SEXP mmap_class(SEXPTYPE type)
+{
+    switch (type) {
+    case LGLSXP: return mmap_logical_class;
+    case INTSXP: return mmap_integer_class;
+    case REALSXP: return mmap_real_class;
+    default: return mmap_raw_class;
+    }
+}
+
+/* Maps n elements of the given type, starting off bytes into the file
+   named by the string file, or as many as the file holds if n is NA.
+   If id is not NULL the mapping must be of exactly n elements of the
+   file with that device and inode.  On failure returns R_NilValue and
+   sets *msg. */
+static SEXP new_mmap(SEXPTYPE type, SEXP file, int cow, double off,
+		     double n, const double *id, const char **msg)
+{
+    size_t eltsize = mmap_eltsize(type);
+    long pagesize = sysconf(_SC_PAGESIZE);
+    struct stat sb;
+    SEXP val = R_NilValue;
+
+    /* allocate first so that neither the descriptor nor the mapping
+       can leak */
+    SEXP info = PROTECT(allocVector(REALSXP, MMAP_INFO_LENGTH));
+    SEXP eptr = PROTECT(R_MakeExternalPtr(NULL, file, info));
+    R_RegisterCFinalizer(eptr, mmap_finalize);
+    SEXP ans = PROTECT(R_new_altrep(mmap_class(type), eptr, R_NilValue));
+    double *pi = REAL(info);
+    for (int k = 0; k < MMAP_INFO_LENGTH; k++)
+	pi[k] = 0;
+
+    *msg = NULL;
+    int fd = open(CHAR(STRING_ELT(file, 0)), O_RDONLY);
+    if (fd < 0) {
+	*msg = strerror(errno);
+	goto done;
+    }
+    if (fstat(fd, &sb) != 0)
+	*msg = strerror(errno);
+    else if (! S_ISREG(sb.st_mode))
+	*msg = _("not a regular file");
+    else if (id != NULL && (id[0] != (double) sb.st_dev ||
+			    id[1] != (double) sb.st_ino))
+	*msg = _("file has been replaced");
+    else {
+	double avail = off < sb.st_size ?
+	    floor((sb.st_size - off) / eltsize) : 0;
+	if (ISNAN(n) || n > avail) {
+	    if (id != NULL)
+		*msg = _("file has been truncated");
+	    n = avail;
+	}
+	if (n > R_XLEN_T_MAX || n * eltsize > SIZE_MAX - pagesize)
+	    *msg = _("file is too large");
+    }
+    if (*msg == NULL && n > 0) {
+	off_t base = (off_t) off - (off_t) off % pagesize;
+	size_t delta = (size_t) ((off_t) off - base);
+	size_t maplen = delta + (size_t) n * eltsize;
+	void *addr = mmap(NULL, maplen,
+			  cow ? PROT_READ | PROT_WRITE : PROT_READ,
+			  cow ? MAP_PRIVATE : MAP_SHARED, fd, base);
+	if (addr == MAP_FAILED)
+	    *msg = strerror(errno);
+	else {
+	    R_SetExternalPtrAddr(eptr, addr);
+	    pi[0] = (double) maplen;
+	    pi[1] = (double) delta;
+	}
+    }
+    close(fd);
+    if (*msg == NULL) {
+	pi[2] = n;
+	pi[3] = off;
+	pi[4] = cow;
+	pi[5] = (double) sb.st_dev;
+	pi[6] = (double) sb.st_ino;
+	if (! cow)
+	    MARK_NOT_MUTABLE(ans);
+	val = ans;
+    }
+done:
+    UNPROTECT(3);
+    return val;
+}
+#endif
+
+/* mmapBin(file, what, n, offset, copyOnWrite) */
+SEXP attribute_hidden do_mmapbin(SEXP call, SEXP op, SEXP args, SEXP env)
+{
+    checkArity(op, args);
+    SEXP file = CAR(args), swhat = CADR(args);
+    SEXPTYPE type;
+
+    if (! isString(file) || LENGTH(file) != 1 ||
+	STRING_ELT(file, 0) == NA_STRING)
+	error(_("invalid '%s' argument"), "file");
+    if (! isString(swhat) || LENGTH(swhat) != 1)
+	error(_("invalid '%s' argument"), "what");
+    const char *what = CHAR(STRING_ELT(swhat, 0)); /* ASCII */
+    if (! strcmp(what, "numeric") || ! strcmp(what, "double"))
+	type = REALSXP;
+    else if (! strcmp(what, "integer") || ! strcmp(what, "int"))
+	type = INTSXP;
+    else if (! strcmp(what, "logical"))
+	type = LGLSXP;
+    else if (! strcmp(what, "raw"))
+	type = RAWSXP;
+    else
+	error(_("invalid '%s' argument"), "what");
+    double n = asReal(CADDR(args));
+    if (! ISNA(n) && (ISNAN(n) || n < 0 || n != floor(n)))
+	error(_("invalid '%s' argument"), "n");
+    double off = asReal(CADDDR(args));
+    if (! R_FINITE(off) || off < 0 || off != floor(off))
+	error(_("invalid '%s' argument"), "offset");
+    if (fmod(off, (double) mmap_eltsize(type)) != 0)
+	error(_("'offset' must be a multiple of the element size"));
+    int cow = asLogical(CAD4R(args));
+    if (cow == NA_LOGICAL)
+	error(_("invalid '%s' argument"), "copyOnWrite");
+
+#ifdef MMAP_FILE_VECTORS
+    const char *path = R_ExpandFileName(translateChar(STRING_ELT(file, 0)));
+    const char *msg;
+    SEXP spath = PROTECT(mkString(path));
+    SEXP ans = new_mmap(type, spath, cow, off, n, NULL, &msg);
+    if (ans == R_NilValue)
+	error(_("cannot map file '%s': %s"), path, msg);
+    if (XLENGTH(ans) == 0)
+	ans = allocVector(type, 0);
+    UNPROTECT(1);
+    return ans;
+#else
+    error(_("memory-mapped files are not supported on this platform"));
+    return R_NilValue; /* -Wall */
+#endif
+}
+
+
+/*
+ * Class registration
+ */
+
+static R_altrep_methods_t compact_intseq_methods = {
+    .name = "compact_intseq",
+    .type = INTSXP,
+    .Length = compact_seq_Length,
+    .Duplicate = compact_intseq_Duplicate,
+    .Inspect = compact_seq_Inspect,
+    .Dataptr = compact_intseq_Dataptr,
+    .Dataptr_or_null = compact_seq_Dataptr_or_null,
+    .Integer_Elt = compact_intseq_Elt,
+    .Get_region = compact_intseq_Get_region,
+    .Is_sorted = compact_seq_Is_sorted,
+    .No_NA = compact_seq_No_NA
+};
+
+static R_altrep_methods_t compact_realseq_methods = {
+    .name = "compact_realseq",
+    .type = REALSXP,
+    .Length = compact_seq_Length,
+    .Duplicate = compact_realseq_Duplicate,
+    .Inspect = compact_seq_Inspect,
+    .Dataptr = compact_realseq_Dataptr,
+    .Dataptr_or_null = compact_seq_Dataptr_or_null,
+    .Real_Elt = compact_realseq_Elt,
+    .Get_region = compact_realseq_Get_region,
+    .Is_sorted = compact_seq_Is_sorted,
+    .No_NA = compact_seq_No_NA
+};
+
+static R_altrep_methods_t deferred_string_methods = {
+    .name = "deferred_string",
+    .type = STRSXP,
+    .Length = deferred_string_Length,
+    .Duplicate = deferred_string_Duplicate,
+    .Inspect = deferred_string_Inspect,
+    .Dataptr = deferred_string_Dataptr,
+    .Dataptr_or_null = deferred_string_Dataptr_or_null,
+    .String_Elt = deferred_string_Elt,
+    .Set_String_Elt = deferred_string_Set_Elt,
+    .No_NA = deferred_string_No_NA
+};
+
+static R_altrep_methods_t wrapper_integer_methods = {
+    .name = "wrapper_integer",
+    .type = INTSXP,
+    .Length = wrapper_Length,
+    .Inspect = wrapper_Inspect,
+    .Dataptr = wrapper_Dataptr,
+    .Dataptr_or_null = wrapper_Dataptr_or_null,
+    .Integer_Elt = wrapper_integer_Elt,
+    .Get_region = wrapper_Get_region,
+    .Is_sorted = wrapper_Is_sorted,
+    .No_NA = wrapper_No_NA
+};
+
+static R_altrep_methods_t wrapper_real_methods = {
+    .name = "wrapper_real",
+    .type = REALSXP,
+    .Length = wrapper_Length,
+    .Inspect = wrapper_Inspect,
+    .Dataptr = wrapper_Dataptr,
+    .Dataptr_or_null = wrapper_Dataptr_or_null,
+    .Real_Elt = wrapper_real_Elt,
+    .Get_region = wrapper_Get_region,
+    .Is_sorted = wrapper_Is_sorted,
+    .No_NA = wrapper_No_NA
+};
+
+#ifdef MMAP_FILE_VECTORS
+static R_altrep_methods_t mmap_logical_methods = {
+    .name = "mmap_logical",
+    .type = LGLSXP,
+    .Length = mmap_Length,
+    .Duplicate = mmap_Duplicate,
+    .Inspect = mmap_Inspect,
+    .Dataptr = mmap_Dataptr,
+    .Dataptr_or_null = mmap_Dataptr_or_null,
+    .Integer_Elt = mmap_integer_Elt,
+    .Get_region = mmap_Get_region
+};
+
+static R_altrep_methods_t mmap_integer_methods = {
+    .name = "mmap_integer",
+    .type = INTSXP,
+    .Length = mmap_Length,
+    .Duplicate = mmap_Duplicate,
+    .Inspect = mmap_Inspect,
+    .Dataptr = mmap_Dataptr,
+    .Dataptr_or_null = mmap_Dataptr_or_null,
+    .Integer_Elt = mmap_integer_Elt,
+    .Get_region = mmap_Get_region
+};
+
+static R_altrep_methods_t mmap_real_methods = {
+    .name = "mmap_real",
+    .type = REALSXP,
+    .Length = mmap_Length,
+    .Duplicate = mmap_Duplicate,
+    .Inspect = mmap_Inspect,
+    .Dataptr = mmap_Dataptr,
+    .Dataptr_or_null = mmap_Dataptr_or_null,
+    .Real_Elt = mmap_real_Elt,
+    .Get_region = mmap_Get_region
+};
+
+static R_altrep_methods_t mmap_raw_methods = {
+    .name = "mmap_raw",
+    .type = RAWSXP,
+    .Length = mmap_Length,
+    .Duplicate = mmap_Duplicate,
+    .Inspect = mmap_Inspect,
+    .Dataptr = mmap_Dataptr,
+    .Dataptr_or_null = mmap_Dataptr_or_null,
+    .Get_region = mmap_Get_region
+};
+#endif
+
+void attribute_hidden R_init_altclasses(void)
+{
+    compact_intseq_class = R_make_altrep_class(&compact_intseq_methods);
+    compact_realseq_class = R_make_altrep_class(&compact_realseq_methods);
+    deferred_string_class = R_make_altrep_class(&deferred_string_methods);
+    wrapper_integer_class = R_make_altrep_class(&wrapper_integer_methods);
+    wrapper_real_class = R_make_altrep_class(&wrapper_real_methods);
+#ifdef MMAP_FILE_VECTORS
+    mmap_logical_class = R_make_altrep_class(&mmap_logical_methods);
+    mmap_integer_class = R_make_altrep_class(&mmap_integer_methods);
+    mmap_real_class = R_make_altrep_class(&mmap_real_methods);
+    mmap_raw_class = R_make_altrep_class(&mmap_raw_methods);
+#endif
+}
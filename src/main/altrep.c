@@ -0,0 +1,322 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2017  The R Core Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  https://www.R-project.org/Licenses/
+ */
+
+/* Alternative representations of vectors.
+
+   An ALTREP object is a vector whose length and data are provided by
+   the methods of its class rather than stored after the header.  The
+   object is a node with the ALTREP bit set, the vector type in its
+   type field, two data fields for the class to use in CAR and CDR, and
+   the class in TAG; attributes are stored as usual.  The accessor
+   macros in Rinternals.h dispatch to the functions here when the bit
+   is set, so code using LENGTH, INTEGER_ELT, STRING_ELT and so on
+   works unchanged.  Code asking for a data pointer with DATAPTR,
+   INTEGER, REAL, ... gets one, but that may require the class to
+   allocate and fill a standard vector; code that can avoid this
+   should use the element and region accessors, or DATAPTR_OR_NULL.
+
+   The classes themselves are in altclasses.c. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <Defn.h>
+
+#define CLASS_METHODS(x) ((R_altrep_methods_t *) EXTPTR_PTR(ALTREP_CLASS(x)))
+
+static void NORET altrep_no_method(SEXP x, const char *what)
+{
+    error(_("no '%s' method for ALTREP class '%s'"), what,
+	  CLASS_METHODS(x)->name);
+}
+
+
+/*
+ * Default methods
+ */
+
+static void *altrep_Dataptr_default(SEXP x, Rboolean writeable)
+{
+    altrep_no_method(x, "Dataptr");
+}
+
+static const void *altrep_Dataptr_or_null_default(SEXP x)
+{
+    return NULL;
+}
+
+static int altrep_Integer_Elt_default(SEXP x, R_xlen_t i)
+{
+    return ((int *) ALTVEC_DATAPTR(x))[i];
+}
+
+static double altrep_Real_Elt_default(SEXP x, R_xlen_t i)
+{
+    return ((double *) ALTVEC_DATAPTR(x))[i];
+}
+
+static SEXP altrep_String_Elt_default(SEXP x, R_xlen_t i)
+{
+    return ((SEXP *) ALTVEC_DATAPTR(x))[i];
+}
+
+static void altrep_Set_String_Elt_default(SEXP x, R_xlen_t i, SEXP v)
+{
+    altrep_no_method(x, "Set_String_Elt");
+}
+
+static R_xlen_t altrep_Get_region_default(SEXP x, R_xlen_t i, R_xlen_t n,
+					  void *buf)
+{
+    R_altrep_methods_t *m = CLASS_METHODS(x);
+    R_xlen_t size = m->Length(x);
+    R_xlen_t ncopy = size - i > n ? n : size - i;
+    R_xlen_t k;
+
+    switch (m->type) {
+    case LGLSXP:
+    case INTSXP:
+	for (k = 0; k < ncopy; k++)
+	    ((int *) buf)[k] = m->Integer_Elt(x, k + i);
+	break;
+    case REALSXP:
+	for (k = 0; k < ncopy; k++)
+	    ((double *) buf)[k] = m->Real_Elt(x, k + i);
+	break;
+    default:
+	altrep_no_method(x, "Get_region");
+    }
+    return ncopy;
+}
+
+static int altrep_Is_sorted_default(SEXP x)
+{
+    return UNKNOWN_SORTEDNESS;
+}
+
+static int altrep_No_NA_default(SEXP x)
+{
+    return 0;
+}
+
+
+/*
+ * Classes and instances
+ */
+
+/* The method table is completed in place and must stay valid for the
+   rest of the session. */
+SEXP attribute_hidden R_make_altrep_class(R_altrep_methods_t *m)
+{
+    if (m->Length == NULL)
+	error("ALTREP class '%s' has no Length method", m->name);
+    if (m->Dataptr == NULL)
+	m->Dataptr = altrep_Dataptr_default;
+    if (m->Dataptr_or_null == NULL)
+	m->Dataptr_or_null = altrep_Dataptr_or_null_default;
+    if (m->Integer_Elt == NULL)
+	m->Integer_Elt = altrep_Integer_Elt_default;
+    if (m->Real_Elt == NULL)
+	m->Real_Elt = altrep_Real_Elt_default;
+    if (m->String_Elt == NULL)
+	m->String_Elt = altrep_String_Elt_default;
+    if (m->Set_String_Elt == NULL)
+	m->Set_String_Elt = altrep_Set_String_Elt_default;
+    if (m->Get_region == NULL)
+	m->Get_region = altrep_Get_region_default;
+    if (m->Is_sorted == NULL)
+	m->Is_sorted = altrep_Is_sorted_default;
+    if (m->No_NA == NULL)
+	m->No_NA = altrep_No_NA_default;
+
+    SEXP cls = R_MakeExternalPtr(m, install(m->name), R_NilValue);
+    R_PreserveObject(cls);
+    return cls;
+}
+
+SEXP attribute_hidden R_new_altrep(SEXP cls, SEXP data1, SEXP data2)
+{
+    R_altrep_methods_t *m = (R_altrep_methods_t *) EXTPTR_PTR(cls);
+    SEXP ans = CONS(data1, data2);
+    SET_TYPEOF(ans, m->type);
+    SET_TAG(ans, cls);
+    SET_ALTREP(ans, 1);
+    return ans;
+}
+
+const char attribute_hidden *R_altrep_class_name(SEXP x)
+{
+    return CLASS_METHODS(x)->name;
+}
+
+
+/*
+ * Dispatch
+ */
+
+R_xlen_t ALTREP_LENGTH(SEXP x)
+{
+    return CLASS_METHODS(x)->Length(x);
+}
+
+/* The Dataptr method may allocate the expanded data, so INTEGER(),
+   REAL(), DATAPTR() and their _RO forms on an ALTREP object can
+   trigger a collection like any other allocating call; x is protected
+   while the data are materialized and keeps them reachable afterwards.
+   Only the _RO forms promise not to write through the pointer. */
+void *ALTVEC_DATAPTR(SEXP x)
+{
+    if (R_in_gc)
+	error("cannot get ALTVEC DATAPTR during GC");
+    PROTECT(x);
+    void *val = CLASS_METHODS(x)->Dataptr(x, TRUE);
+    UNPROTECT(1);
+    return val;
+}
+
+const void *ALTVEC_DATAPTR_RO(SEXP x)
+{
+    if (R_in_gc)
+	error("cannot get ALTVEC DATAPTR during GC");
+    PROTECT(x);
+    const void *val = CLASS_METHODS(x)->Dataptr(x, FALSE);
+    UNPROTECT(1);
+    return val;
+}
+
+const void *ALTVEC_DATAPTR_OR_NULL(SEXP x)
+{
+    return CLASS_METHODS(x)->Dataptr_or_null(x);
+}
+
+int ALTINTEGER_ELT(SEXP x, R_xlen_t i)
+{
+    return CLASS_METHODS(x)->Integer_Elt(x, i);
+}
+
+double ALTREAL_ELT(SEXP x, R_xlen_t i)
+{
+    return CLASS_METHODS(x)->Real_Elt(x, i);
+}
+
+/* Much code written for standard vectors holds unprotected objects
+   across calls to STRING_ELT() and SET_STRING_ELT(), so the methods
+   behind these, which may allocate, are run with the collector
+   suspended.  A collection that falls due meanwhile is run
+   at the next allocation after the method returns.  R_GCEnabled is
+   restored by the context code if the method signals an error. */
+SEXP ALTSTRING_ELT(SEXP x, R_xlen_t i)
+{
+    int enabled = R_GCEnabled;
+    R_GCEnabled = FALSE;
+    SEXP val = CLASS_METHODS(x)->String_Elt(x, i);
+    R_GCEnabled = enabled;
+    return val;
+}
+
+void attribute_hidden ALTSTRING_SET_ELT(SEXP x, R_xlen_t i, SEXP v)
+{
+    int enabled = R_GCEnabled;
+    R_GCEnabled = FALSE;
+    CLASS_METHODS(x)->Set_String_Elt(x, i, v);
+    R_GCEnabled = enabled;
+}
+
+/* Returns NULL if x should be duplicated as a standard vector. */
+SEXP attribute_hidden ALTREP_DUPLICATE(SEXP x, Rboolean deep)
+{
+    R_altrep_methods_t *m = CLASS_METHODS(x);
+    return m->Duplicate != NULL ? m->Duplicate(x, deep) : NULL;
+}
+
+/* Prints a description of x for .Internal(inspect()); returns FALSE if
+   the class has nothing to say. */
+Rboolean attribute_hidden ALTREP_INSPECT(SEXP x)
+{
+    R_altrep_methods_t *m = CLASS_METHODS(x);
+    return m->Inspect != NULL ? m->Inspect(x) : FALSE;
+}
+
+
+/*
+ * Region and hint accessors.  These work for standard vectors too.
+ */
+
+R_xlen_t INTEGER_GET_REGION(SEXP x, R_xlen_t i, R_xlen_t n, int *buf)
+{
+    if (ALTREP(x))
+	return CLASS_METHODS(x)->Get_region(x, i, n, buf);
+    else {
+	R_xlen_t size = XLENGTH(x);
+	R_xlen_t ncopy = size - i > n ? n : size - i;
+	if (ncopy > 0)
+	    memcpy(buf, INTEGER(x) + i, ncopy * sizeof(int));
+	return ncopy;
+    }
+}
+
+R_xlen_t REAL_GET_REGION(SEXP x, R_xlen_t i, R_xlen_t n, double *buf)
+{
+    if (ALTREP(x))
+	return CLASS_METHODS(x)->Get_region(x, i, n, buf);
+    else {
+	R_xlen_t size = XLENGTH(x);
+	R_xlen_t ncopy = size - i > n ? n : size - i;
+	if (ncopy > 0)
+	    memcpy(buf, REAL(x) + i, ncopy * sizeof(double));
+	return ncopy;
+    }
+}
+
+int INTEGER_IS_SORTED(SEXP x)
+{
+    return ALTREP(x) ? CLASS_METHODS(x)->Is_sorted(x) : UNKNOWN_SORTEDNESS;
+}
+
+int INTEGER_NO_NA(SEXP x)
+{
+    return ALTREP(x) ? CLASS_METHODS(x)->No_NA(x) : 0;
+}
+
+int REAL_IS_SORTED(SEXP x)
+{
+    return ALTREP(x) ? CLASS_METHODS(x)->Is_sorted(x) : UNKNOWN_SORTEDNESS;
+}
+
+int REAL_NO_NA(SEXP x)
+{
+    return ALTREP(x) ? CLASS_METHODS(x)->No_NA(x) : 0;
+}
+
+int STRING_IS_SORTED(SEXP x)
+{
+    return ALTREP(x) ? CLASS_METHODS(x)->Is_sorted(x) : UNKNOWN_SORTEDNESS;
+}
+
+int STRING_NO_NA(SEXP x)
+{
+    return ALTREP(x) ? CLASS_METHODS(x)->No_NA(x) : 0;
+}
+
+
+void attribute_hidden InitAltrep(void)
+{
+    R_init_altclasses();
+}
@@ -1,6 +1,6 @@
 /*
  *  R : A Computer Language for Statistical Data Analysis
- *  Copyright (C) 2000-2016  The R Core Team
+ *  Copyright (C) 2000-2017  The R Core Team
  *
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
@@ -24,6 +24,109 @@
 #include <Defn.h>
 #include <Internal.h>
 
+/* Fast path for lapply and vapply.  When X is a vector without a
+   class, X[[i]] needs no dispatch and the element can be extracted
+   directly.  FUN is then looked up once; a closure is applied to an
+   argument list built once, with its first cell set to a promise for
+   X[[i]] that is already forced, and a builtin is called on the
+   element and the values of '...', which are also evaluated once.
+   The call FUN(X[[i]], ...) is still used for the context, so
+   sys.call() and substitute() in FUN see what they would for the
+   general call. */
+
+static R_INLINE Rboolean applyFastX(SEXP XX)
+{
+    switch (TYPEOF(XX)) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case STRSXP:
+    case RAWSXP:
+    case VECSXP:
+	return ! OBJECT(XX);
+    default:
+	return FALSE;
+    }
+}
+
+/* X[[i]] for a vector accepted by applyFastX */
+static SEXP applyFastElt(SEXP XX, R_xlen_t i)
+{
+    SEXP val;
+    if (TYPEOF(XX) == VECSXP) {
+	val = VECTOR_ELT(XX, i);
+	SET_NAMED(val, 2);
+	return val;
+    }
+    val = allocVector(TYPEOF(XX), 1);
+    switch (TYPEOF(XX)) {
+    case LGLSXP:  LOGICAL(val)[0] = LOGICAL(XX)[i]; break;
+    case INTSXP:  INTEGER(val)[0] = INTEGER(XX)[i]; break;
+    case REALSXP: REAL(val)[0] = REAL(XX)[i]; break;
+    case CPLXSXP: COMPLEX(val)[0] = COMPLEX(XX)[i]; break;
+    case STRSXP:  SET_STRING_ELT(val, 0, STRING_ELT(XX, i)); break;
+    case RAWSXP:  RAW(val)[0] = RAW(XX)[i]; break;
+    }
+    return val;
+}
+
+/* The argument list used by applyFastCall for FUN(X[[i]], ...), or
+   R_NilValue if 'fun' must be called by R_forceAndCall. */
+static SEXP applyFastArgs(SEXP call, SEXP fun, SEXP rho)
+{
+    switch (TYPEOF(fun)) {
+    case CLOSXP:
+	return promiseArgs(CDR(call), rho);
+    case BUILTINSXP:
+	return CONS(R_NilValue, evalList(CDDR(call), rho, call, 1));
+    default:
+	return R_NilValue;
+    }
+}
+
+static SEXP applyFastCall(SEXP call, SEXP fun, SEXP args, SEXP XX,
+			  R_xlen_t i, SEXP rho)
+{
+    SEXP val, elt = PROTECT(applyFastElt(XX, i));
+
+    if (TYPEOF(fun) == CLOSXP) {
+	SETCAR(args, R_mkEVPROMISE(CADR(call), elt));
+	val = applyClosure(call, fun, args, rho, R_NilValue);
+    }
+    else {
+	/* builtins may modify their argument list, e.g. fixup_NaRm */
+	if (CDR(args) != R_NilValue)
+	    args = CONS(elt, shallow_duplicate(CDR(args)));
+	else
+	    args = CONS(elt, R_NilValue);
+	PROTECT(args);
+	val = R_applyBuiltin(call, fun, args, rho);
+	UNPROTECT(1); /* args */
+    }
+    UNPROTECT(1); /* elt */
+    return val;
+}
+
+/* Set up the fast path: returns the function to call, and its
+   argument list in *args, or R_NilValue if the general call must be
+   used. */
+static SEXP applyFastSetup(SEXP call, SEXP XX, SEXP rho, SEXP *args)
+{
+    SEXP fun;
+
+    *args = R_NilValue;
+    if (! applyFastX(XX))
+	return R_NilValue;
+    if (TYPEOF(CAR(call)) == SYMSXP)
+	PROTECT(fun = findFun(CAR(call), rho));
+    else
+	PROTECT(fun = eval(CAR(call), rho));
+    *args = applyFastArgs(call, fun, rho);
+    UNPROTECT(1);
+    return *args == R_NilValue ? R_NilValue : fun;
+}
+
 /* .Internal(lapply(X, FUN)) */
 
 /* This is a special .Internal, so has unevaluated arguments.  It is
@@ -64,15 +167,24 @@ SEXP attribute_hidden do_lapply(SEXP call, SEXP op, SEXP args, SEXP rho)
     SEXP R_fcall = PROTECT(LCONS(FUN,
 				 LCONS(tmp, LCONS(R_DotsSymbol, R_NilValue))));
 
+    SEXP fun = R_NilValue, fargs = R_NilValue;
+    if (n > 0)
+	fun = applyFastSetup(R_fcall, XX, rho, &fargs);
+    PROTECT(fun);
+    PROTECT(fargs);
+
     for(R_xlen_t i = 0; i < n; i++) {
 	if (realIndx) REAL(ind)[0] = (double)(i + 1);
 	else INTEGER(ind)[0] = (int)(i + 1);
-	tmp = R_forceAndCall(R_fcall, 1, rho);
+	if (fun != R_NilValue)
+	    tmp = applyFastCall(R_fcall, fun, fargs, XX, i, rho);
+	else
+	    tmp = R_forceAndCall(R_fcall, 1, rho);
 	if (MAYBE_REFERENCED(tmp)) tmp = lazy_duplicate(tmp);
 	SET_VECTOR_ELT(ans, i, tmp);
     }
 
-    UNPROTECT(6);
+    UNPROTECT(8);
     return ans;
 }
 
@@ -149,13 +261,22 @@ SEXP attribute_hidden do_vapply(SEXP call, SEXP op, SEXP args, SEXP rho)
 	PROTECT(R_fcall = LCONS(FUN,
 				LCONS(tmp, LCONS(R_DotsSymbol, R_NilValue))));
 
+	SEXP fun = R_NilValue, fargs = R_NilValue;
+	if (n > 0)
+	    fun = applyFastSetup(R_fcall, XX, rho, &fargs);
+	PROTECT(fun);
+	PROTECT(fargs);
+
 	int common_len_offset = 0;
 	for(i = 0; i < n; i++) {
 	    SEXP val; SEXPTYPE valType;
 	    PROTECT_INDEX indx;
 	    if (realIndx) REAL(ind)[0] = (double)(i + 1);
 	    else INTEGER(ind)[0] = (int)(i + 1);
-	    val = R_forceAndCall(R_fcall, 1, rho);
+	    if (fun != R_NilValue)
+		val = applyFastCall(R_fcall, fun, fargs, XX, i, rho);
+	    else
+		val = R_forceAndCall(R_fcall, 1, rho);
 	    if (MAYBE_REFERENCED(val))
 		val = lazy_duplicate(val); // Need to duplicate? Copying again anyway
 	    PROTECT_WITH_INDEX(val, &indx);
@@ -222,7 +343,7 @@ SEXP attribute_hidden do_vapply(SEXP call, SEXP op, SEXP args, SEXP rho)
 	    }
 	    UNPROTECT(1);
 	}
-	UNPROTECT(3);
+	UNPROTECT(5);
     }
 
     if (commonLen != 1) {
@@ -406,60 +406,60 @@ SEXP attribute_hidden do_arith(SEXP call, SEXP op, SEXP args, SEXP env)
 	/* Handle some scaler operations immediately */
 	if (IS_SCALAR(arg1, REALSXP)) {
 	    if (IS_SCALAR(arg2, REALSXP)) {
-		double x1 = REAL(arg1)[0];
-		double x2 = REAL(arg2)[0];
+		double x1 = SCALAR_DVAL(arg1);
+		double x2 = SCALAR_DVAL(arg2);
 		ans = ScalarValue2(arg1, arg2);
 		switch (PRIMVAL(op)) {
-		case PLUSOP: REAL(ans)[0] = x1 + x2; return ans;
-		case MINUSOP: REAL(ans)[0] = x1 - x2; return ans;
-		case TIMESOP: REAL(ans)[0] = x1 * x2; return ans;
-		case DIVOP: REAL(ans)[0] = x1 / x2; return ans;
+		case PLUSOP: SCALAR_DVAL(ans) = x1 + x2; return ans;
+		case MINUSOP: SCALAR_DVAL(ans) = x1 - x2; return ans;
+		case TIMESOP: SCALAR_DVAL(ans) = x1 * x2; return ans;
+		case DIVOP: SCALAR_DVAL(ans) = x1 / x2; return ans;
 		}
 	    }
 	    else if (IS_SCALAR(arg2, INTSXP)) {
-		double x1 = REAL(arg1)[0];
-		double x2 = INTEGER(arg2)[0] != NA_INTEGER ?
-		    (double) INTEGER(arg2)[0] : NA_REAL;
+		double x1 = SCALAR_DVAL(arg1);
+		double x2 = SCALAR_IVAL(arg2) != NA_INTEGER ?
+		    (double) SCALAR_IVAL(arg2) : NA_REAL;
 		ans = ScalarValue1(arg1);
 		switch (PRIMVAL(op)) {
-		case PLUSOP: REAL(ans)[0] = x1 + x2; return ans;
-		case MINUSOP: REAL(ans)[0] = x1 - x2; return ans;
-		case TIMESOP: REAL(ans)[0] = x1 * x2; return ans;
-		case DIVOP: REAL(ans)[0] = x1 / x2; return ans;
+		case PLUSOP: SCALAR_DVAL(ans) = x1 + x2; return ans;
+		case MINUSOP: SCALAR_DVAL(ans) = x1 - x2; return ans;
+		case TIMESOP: SCALAR_DVAL(ans) = x1 * x2; return ans;
+		case DIVOP: SCALAR_DVAL(ans) = x1 / x2; return ans;
 		}
 	    }
 	}
 	else if (IS_SCALAR(arg1, INTSXP)) {
 	    if (IS_SCALAR(arg2, REALSXP)) {
-		double x1 = INTEGER(arg1)[0] != NA_INTEGER ?
-		    (double) INTEGER(arg1)[0] : NA_REAL;
-		double x2 = REAL(arg2)[0];
+		double x1 = SCALAR_IVAL(arg1) != NA_INTEGER ?
+		    (double) SCALAR_IVAL(arg1) : NA_REAL;
+		double x2 = SCALAR_DVAL(arg2);
 		ans = ScalarValue1(arg2);
 		switch (PRIMVAL(op)) {
-		case PLUSOP: REAL(ans)[0] = x1 + x2; return ans;
-		case MINUSOP: REAL(ans)[0] = x1 - x2; return ans;
-		case TIMESOP: REAL(ans)[0] = x1 * x2; return ans;
-		case DIVOP: REAL(ans)[0] = x1 / x2; return ans;
+		case PLUSOP: SCALAR_DVAL(ans) = x1 + x2; return ans;
+		case MINUSOP: SCALAR_DVAL(ans) = x1 - x2; return ans;
+		case TIMESOP: SCALAR_DVAL(ans) = x1 * x2; return ans;
+		case DIVOP: SCALAR_DVAL(ans) = x1 / x2; return ans;
 		}
 	    }
 	    else if (IS_SCALAR(arg2, INTSXP)) {
 		Rboolean naflag = FALSE;
-		int x1 = INTEGER(arg1)[0];
-		int x2 = INTEGER(arg2)[0];
+		int x1 = SCALAR_IVAL(arg1);
+		int x2 = SCALAR_IVAL(arg2);
 		switch (PRIMVAL(op)) {
 		case PLUSOP:
 		    ans = ScalarValue2(arg1, arg2);
-		    INTEGER(ans)[0] = R_integer_plus(x1, x2, &naflag);
+		    SCALAR_IVAL(ans) = R_integer_plus(x1, x2, &naflag);
 		    CHECK_INTEGER_OVERFLOW(call, ans, naflag);
 		    return ans;
 		case MINUSOP:
 		    ans = ScalarValue2(arg1, arg2);
-		    INTEGER(ans)[0] = R_integer_minus(x1, x2, &naflag);
+		    SCALAR_IVAL(ans) = R_integer_minus(x1, x2, &naflag);
 		    CHECK_INTEGER_OVERFLOW(call, ans, naflag);
 		    return ans;
 		case TIMESOP:
 		    ans = ScalarValue2(arg1, arg2);
-		    INTEGER(ans)[0] = R_integer_times(x1, x2, &naflag);
+		    SCALAR_IVAL(ans) = R_integer_times(x1, x2, &naflag);
 		    CHECK_INTEGER_OVERFLOW(call, ans, naflag);
 		    return ans;
 		case DIVOP:
@@ -475,7 +475,7 @@ SEXP attribute_hidden do_arith(SEXP call, SEXP op, SEXP args, SEXP env)
 	    case PLUSOP: return(arg1);
 	    case MINUSOP:
 		ans = ScalarValue1(arg1);
-		REAL(ans)[0] = -REAL(arg1)[0];
+		SCALAR_DVAL(ans) = -SCALAR_DVAL(arg1);
 		return ans;
 	    }
 	}
@@ -484,8 +484,8 @@ SEXP attribute_hidden do_arith(SEXP call, SEXP op, SEXP args, SEXP env)
 	    case PLUSOP: return(arg1);
 	    case MINUSOP:
 		ans = ScalarValue1(arg1);
-		INTEGER(ans)[0] = INTEGER(arg1)[0] == NA_INTEGER ?
-		    NA_INTEGER : -INTEGER(arg1)[0];
+		SCALAR_IVAL(ans) = SCALAR_IVAL(arg1) == NA_INTEGER ?
+		    NA_INTEGER : -SCALAR_IVAL(arg1);
 		return ans;
 	    }
 	}
@@ -794,6 +794,63 @@ static SEXP real_unary(ARITHOP_TYPE code, SEXP s1, SEXP lcall)
     return s1;			/* never used; to keep -Wall happy */
 }
 
+/* Kernels for SIMD_ARITH (see arithmetic.h).  The integer kernels
+   form sums and differences modulo 2^32, detecting overflow from the
+   signs, and products in double precision, so they give exactly the
+   results of R_integer_plus() and friends; 'novf' is set when an
+   operation on non-NA operands overflowed. */
+
+/* Integer and logical operands are converted to double without a
+   test for NA, which would keep the loops from being vectorized: the
+   kernels are only used when they have none. */
+static Rboolean simd_anyNA_int(SEXP x)
+{
+    if ((TYPEOF(x) != INTSXP && TYPEOF(x) != LGLSXP) || INTEGER_NO_NA(x))
+	return FALSE;
+    const int *px = INTEGER_RO(x);
+    R_xlen_t n = XLENGTH(x);
+    int na = 0;
+    SIMD_LOOP_OR(na)
+    for (R_xlen_t i = 0; i < n; i++)
+	na |= px[i] == NA_INTEGER;
+    return na != 0;
+}
+
+#define IPLUS_KERNEL(X, Y) do {						\
+	int __x__ = X, __y__ = Y;					\
+	int __z__ = (int) ((unsigned int) __x__ + (unsigned int) __y__); \
+	int __na__ = (__x__ == NA_INTEGER) | (__y__ == NA_INTEGER);	\
+	int __ovf__ = (((__x__ ^ __z__) & (__y__ ^ __z__)) < 0) |	\
+	    (__z__ == NA_INTEGER);					\
+	pa[i] = (__na__ | __ovf__) ? NA_INTEGER : __z__;		\
+	novf |= __ovf__ & !__na__;					\
+    } while (0)
+
+#define IMINUS_KERNEL(X, Y) do {					\
+	int __x__ = X, __y__ = Y;					\
+	int __z__ = (int) ((unsigned int) __x__ - (unsigned int) __y__); \
+	int __na__ = (__x__ == NA_INTEGER) | (__y__ == NA_INTEGER);	\
+	int __ovf__ = (((__x__ ^ __y__) & (__x__ ^ __z__)) < 0) |	\
+	    (__z__ == NA_INTEGER);					\
+	pa[i] = (__na__ | __ovf__) ? NA_INTEGER : __z__;		\
+	novf |= __ovf__ & !__na__;					\
+    } while (0)
+
+#define ITIMES_KERNEL(X, Y) do {					\
+	int __x__ = X, __y__ = Y;					\
+	double __z__ = (double) __x__ * (double) __y__;			\
+	int __na__ = (__x__ == NA_INTEGER) | (__y__ == NA_INTEGER);	\
+	int __ovf__ = (__z__ > R_INT_MAX) | (__z__ < R_INT_MIN);	\
+	pa[i] = (__na__ | __ovf__) ? NA_INTEGER : (int) __z__;		\
+	novf |= __ovf__ & !__na__;					\
+    } while (0)
+
+#define RPLUS_KERNEL(X, Y) da[i] = NAN_FIRST(X, (X) + (Y))
+#define RMINUS_KERNEL(X, Y) da[i] = (X) - (Y)
+#define RTIMES_KERNEL(X, Y) da[i] = NAN_FIRST(X, (X) * (Y))
+#define RDIV_KERNEL(X, Y) da[i] = (X) / (Y)
+#define RSQUARE_KERNEL(X) do { double __x__ = X; da[i] = __x__ * __x__; } while (0)
+
 static SEXP integer_binary(ARITHOP_TYPE code, SEXP s1, SEXP s2, SEXP lcall)
 {
     R_xlen_t i, i1, i2, n, n1, n2;
@@ -812,56 +869,91 @@ static SEXP integer_binary(ARITHOP_TYPE code, SEXP s1, SEXP s2, SEXP lcall)
 	ans = R_allocOrReuseVector(s1, s2, INTSXP, n);
     if (n == 0) return(ans);
     PROTECT(ans);
+    const int *px1 = INTEGER_RO(s1), *px2 = INTEGER_RO(s2);
 
     switch (code) {
     case PLUSOP:
-	MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
-		x1 = INTEGER(s1)[i1];
-		x2 = INTEGER(s2)[i2];
-		INTEGER(ans)[i] = R_integer_plus(x1, x2, &naflag);
-	    });
+	if (SIMD_ARITH_OK(n1, n2)) {
+	    int *pa = INTEGER(ans), novf = 0;
+	    SIMD_ARITH(SIMD_LOOP_OR(novf), int, px1, NO_CONV, int, px2, NO_CONV,
+		       IPLUS_KERNEL);
+	    naflag = novf != 0;
+	}
+	else
+	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
+		    x1 = px1[i1];
+		    x2 = px2[i2];
+		    INTEGER(ans)[i] = R_integer_plus(x1, x2, &naflag);
+		});
 	if (naflag)
 	    warningcall(lcall, INTEGER_OVERFLOW_WARNING);
 	break;
     case MINUSOP:
-	MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
-		x1 = INTEGER(s1)[i1];
-		x2 = INTEGER(s2)[i2];
-		INTEGER(ans)[i] = R_integer_minus(x1, x2, &naflag);
-	    });
+	if (SIMD_ARITH_OK(n1, n2)) {
+	    int *pa = INTEGER(ans), novf = 0;
+	    SIMD_ARITH(SIMD_LOOP_OR(novf), int, px1, NO_CONV, int, px2, NO_CONV,
+		       IMINUS_KERNEL);
+	    naflag = novf != 0;
+	}
+	else
+	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
+		    x1 = px1[i1];
+		    x2 = px2[i2];
+		    INTEGER(ans)[i] = R_integer_minus(x1, x2, &naflag);
+		});
 	if (naflag)
 	    warningcall(lcall, INTEGER_OVERFLOW_WARNING);
 	break;
     case TIMESOP:
-	MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
-		x1 = INTEGER(s1)[i1];
-		x2 = INTEGER(s2)[i2];
-		INTEGER(ans)[i] = R_integer_times(x1, x2, &naflag);
-	    });
+	if (SIMD_ARITH_OK(n1, n2)) {
+	    int *pa = INTEGER(ans), novf = 0;
+	    SIMD_ARITH(SIMD_LOOP_OR(novf), int, px1, NO_CONV, int, px2, NO_CONV,
+		       ITIMES_KERNEL);
+	    naflag = novf != 0;
+	}
+	else
+	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
+		    x1 = px1[i1];
+		    x2 = px2[i2];
+		    INTEGER(ans)[i] = R_integer_times(x1, x2, &naflag);
+		});
 	if (naflag)
 	    warningcall(lcall, INTEGER_OVERFLOW_WARNING);
 	break;
     case DIVOP:
-	MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
-		x1 = INTEGER(s1)[i1];
-		x2 = INTEGER(s2)[i2];
-		REAL(ans)[i] = R_integer_divide(x1, x2);
-	    });
+	if (SIMD_ARITH_OK(n1, n2) &&
+	    !simd_anyNA_int(s1) && !simd_anyNA_int(s2)) {
+	    double *da = REAL(ans);
+	    SIMD_ARITH(SIMD_LOOP, int, px1, TO_REAL, int, px2, TO_REAL,
+		       RDIV_KERNEL);
+	}
+	else
+	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
+		    x1 = px1[i1];
+		    x2 = px2[i2];
+		    REAL(ans)[i] = R_integer_divide(x1, x2);
+		});
 	break;
     case POWOP:
-	MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
-		if((x1 = INTEGER(s1)[i1]) == 1 || (x2 = INTEGER(s2)[i2]) == 0)
-		    REAL(ans)[i] = 1.;
-		else if (x1 == NA_INTEGER || x2 == NA_INTEGER)
-		    REAL(ans)[i] = NA_REAL;
-		else
-		    REAL(ans)[i] = R_POW((double) x1, (double) x2);
-	    });
+	if (n2 == 1 && px2[0] == 2 && !simd_anyNA_int(s1)) {
+	    double *da = REAL(ans);
+	    SIMD_ITERATE_CHECK(NINTERRUPT, n, i, SIMD_LOOP,
+			       RSQUARE_KERNEL(TO_REAL(px1[i])););
+	}
+	else
+	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
+		    if((x1 = px1[i1]) == 1 || (x2 = px2[i2]) == 0)
+			REAL(ans)[i] = 1.;
+		    else if (x1 == NA_INTEGER || x2 == NA_INTEGER)
+			REAL(ans)[i] = NA_REAL;
+		    else
+			REAL(ans)[i] = R_POW((double) x1, (double) x2);
+		});
 	break;
     case MODOP:
 	MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
-		x1 = INTEGER(s1)[i1];
-		x2 = INTEGER(s2)[i2];
+		x1 = px1[i1];
+		x2 = px2[i2];
 		if (x1 == NA_INTEGER || x2 == NA_INTEGER || x2 == 0)
 		    INTEGER(ans)[i] = NA_INTEGER;
 		else {
@@ -873,8 +965,8 @@ static SEXP integer_binary(ARITHOP_TYPE code, SEXP s1, SEXP s2, SEXP lcall)
 	break;
     case IDIVOP:
 	MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2, {
-		x1 = INTEGER(s1)[i1];
-		x2 = INTEGER(s2)[i2];
+		x1 = px1[i1];
+		x2 = px2[i2];
 		/* This had x %/% 0 == 0 prior to 2.14.1, but
 		   it seems conventionally to be undefined */
 		if (x1 == NA_INTEGER || x2 == NA_INTEGER || x2 == 0)
@@ -916,52 +1008,78 @@ static SEXP real_binary(ARITHOP_TYPE code, SEXP s1, SEXP s2)
 
     n = (n1 > n2) ? n1 : n2;
     PROTECT(ans = R_allocOrReuseVector(s1, s2, REALSXP, n));
+    /* NA_REAL as arithmetic returns it, i.e. quiet */
+    double na_arith = NA_REAL + 0.0;
 
     switch (code) {
     case PLUSOP:
-	if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+	if (SIMD_ARITH_OK(n1, n2) &&
+	    !simd_anyNA_int(s1) && !simd_anyNA_int(s2)) {
 	    double *da = REAL(ans);
-	    double *dx = REAL(s1);
-	    double *dy = REAL(s2);
-	    if (n2 == 1) {
-		double tmp = dy[0];
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = dx[i] + tmp;);
+	    if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+		const double *dx = REAL_RO(s1), *dy = REAL_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, double, dx, NO_CONV, double, dy, NO_CONV,
+			   RPLUS_KERNEL);
 	    }
-	    else if (n1 == 1) {
-		double tmp = dx[0];
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = tmp + dy[i];);
+	    else if(TYPEOF(s1) == INTSXP ) {
+		const int *px = INTEGER_RO(s1);
+		const double *dy = REAL_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, int, px, TO_REAL, double, dy, NO_CONV,
+			   RPLUS_KERNEL);
+	    }
+	    else if(TYPEOF(s2) == INTSXP ) {
+		const double *dx = REAL_RO(s1);
+		const int *py = INTEGER_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, double, dx, NO_CONV, int, py, TO_REAL,
+			   RPLUS_KERNEL);
 	    }
-	    else if (n1 == n2)
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = dx[i] + dy[i];);
-	    else
-		MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
-				  da[i] = dx[i1] + dy[i2];);
+	}
+	else if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+	    double *da = REAL(ans);
+	    double *dx = REAL(s1);
+	    double *dy = REAL(s2);
+	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
+			      da[i] = NAN_FIRST(dx[i1], dx[i1] + dy[i2]););
 	}
 	else if(TYPEOF(s1) == INTSXP )
+	    /* NA even when s2 is NaN: the first operand propagates, as
+	       with NAN_FIRST */
 	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
-			      REAL(ans)[i] = R_INTEGER(s1, i1) + REAL(s2)[i2];);
+			      REAL(ans)[i] = INTEGER(s1)[i1] == NA_INTEGER ?
+			      na_arith : INTEGER(s1)[i1] + REAL(s2)[i2];);
 	else if(TYPEOF(s2) == INTSXP )
 	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
-			      REAL(ans)[i] = REAL(s1)[i1] + R_INTEGER(s2, i2););
+			      REAL(ans)[i] = NAN_FIRST(REAL(s1)[i1],
+						       REAL(s1)[i1] + R_INTEGER(s2, i2)););
 	break;
     case MINUSOP:
-	if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+	if (SIMD_ARITH_OK(n1, n2) &&
+	    !simd_anyNA_int(s1) && !simd_anyNA_int(s2)) {
 	    double *da = REAL(ans);
-	    double *dx = REAL(s1);
-	    double *dy = REAL(s2);
-	    if (n2 == 1) {
-		double tmp = dy[0];
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = dx[i] - tmp;);
+	    if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+		const double *dx = REAL_RO(s1), *dy = REAL_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, double, dx, NO_CONV, double, dy, NO_CONV,
+			   RMINUS_KERNEL);
 	    }
-	    else if (n1 == 1) {
-		double tmp = dx[0];
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = tmp - dy[i];);
+	    else if(TYPEOF(s1) == INTSXP ) {
+		const int *px = INTEGER_RO(s1);
+		const double *dy = REAL_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, int, px, TO_REAL, double, dy, NO_CONV,
+			   RMINUS_KERNEL);
 	    }
-	    else if (n1 == n2)
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = dx[i] - dy[i];);
-	    else
-		MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
-				  da[i] = dx[i1] - dy[i2];);
+	    else if(TYPEOF(s2) == INTSXP ) {
+		const double *dx = REAL_RO(s1);
+		const int *py = INTEGER_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, double, dx, NO_CONV, int, py, TO_REAL,
+			   RMINUS_KERNEL);
+	    }
+	}
+	else if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+	    double *da = REAL(ans);
+	    double *dx = REAL(s1);
+	    double *dy = REAL(s2);
+	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
+			      da[i] = dx[i1] - dy[i2];);
 	}
 	else if(TYPEOF(s1) == INTSXP )
 	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
@@ -971,49 +1089,72 @@ static SEXP real_binary(ARITHOP_TYPE code, SEXP s1, SEXP s2)
 			      REAL(ans)[i] = REAL(s1)[i1] - R_INTEGER(s2, i2););
 	break;
     case TIMESOP:
-	if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+	if (SIMD_ARITH_OK(n1, n2) &&
+	    !simd_anyNA_int(s1) && !simd_anyNA_int(s2)) {
 	    double *da = REAL(ans);
-	    double *dx = REAL(s1);
-	    double *dy = REAL(s2);
-	    if (n2 == 1) {
-		double tmp = dy[0];
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = dx[i] * tmp;);
+	    if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+		const double *dx = REAL_RO(s1), *dy = REAL_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, double, dx, NO_CONV, double, dy, NO_CONV,
+			   RTIMES_KERNEL);
 	    }
-	    else if (n1 == 1) {
-		double tmp = REAL(s1)[0];
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = tmp * dy[i];);
+	    else if(TYPEOF(s1) == INTSXP ) {
+		const int *px = INTEGER_RO(s1);
+		const double *dy = REAL_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, int, px, TO_REAL, double, dy, NO_CONV,
+			   RTIMES_KERNEL);
+	    }
+	    else if(TYPEOF(s2) == INTSXP ) {
+		const double *dx = REAL_RO(s1);
+		const int *py = INTEGER_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, double, dx, NO_CONV, int, py, TO_REAL,
+			   RTIMES_KERNEL);
 	    }
-	    else if (n1 == n2)
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = dx[i] * dy[i];);
-	    else
-		MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
-				  da[i] = dx[i1] * dy[i2];);
+	}
+	else if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+	    double *da = REAL(ans);
+	    double *dx = REAL(s1);
+	    double *dy = REAL(s2);
+	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
+			      da[i] = NAN_FIRST(dx[i1], dx[i1] * dy[i2]););
 	}
 	else if(TYPEOF(s1) == INTSXP )
+	    /* NA even when s2 is NaN, see PLUSOP */
 	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
-			      REAL(ans)[i] = R_INTEGER(s1, i1) * REAL(s2)[i2];);
+			      REAL(ans)[i] = INTEGER(s1)[i1] == NA_INTEGER ?
+			      na_arith : INTEGER(s1)[i1] * REAL(s2)[i2];);
 	else if(TYPEOF(s2) == INTSXP )
 	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
-			      REAL(ans)[i] = REAL(s1)[i1] * R_INTEGER(s2, i2););
+			      REAL(ans)[i] = NAN_FIRST(REAL(s1)[i1],
+						       REAL(s1)[i1] * R_INTEGER(s2, i2)););
 	break;
     case DIVOP:
-	if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+	if (SIMD_ARITH_OK(n1, n2) &&
+	    !simd_anyNA_int(s1) && !simd_anyNA_int(s2)) {
 	    double *da = REAL(ans);
-	    double *dx = REAL(s1);
-	    double *dy = REAL(s2);
-	    if (n2 == 1) {
-		double tmp = dy[0];
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = dx[i] / tmp;);
+	    if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+		const double *dx = REAL_RO(s1), *dy = REAL_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, double, dx, NO_CONV, double, dy, NO_CONV,
+			   RDIV_KERNEL);
 	    }
-	    else if (n1 == 1) {
-		double tmp = dx[0];
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = tmp / dy[i];);
+	    else if(TYPEOF(s1) == INTSXP ) {
+		const int *px = INTEGER_RO(s1);
+		const double *dy = REAL_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, int, px, TO_REAL, double, dy, NO_CONV,
+			   RDIV_KERNEL);
+	    }
+	    else if(TYPEOF(s2) == INTSXP ) {
+		const double *dx = REAL_RO(s1);
+		const int *py = INTEGER_RO(s2);
+		SIMD_ARITH(SIMD_LOOP, double, dx, NO_CONV, int, py, TO_REAL,
+			   RDIV_KERNEL);
 	    }
-	    else if (n1 == n2)
-		R_ITERATE_CHECK(NINTERRUPT, n, i, da[i] = dx[i] / dy[i];);
-	    else
-		MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
-				  da[i] = dx[i1] / dy[i2];);
+	}
+	else if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+	    double *da = REAL(ans);
+	    double *dx = REAL(s1);
+	    double *dy = REAL(s2);
+	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
+			      da[i] = dx[i1] / dy[i2];);
 	}
 	else if(TYPEOF(s1) == INTSXP )
 	    MOD_ITERATE2_CHECK(NINTERRUPT, n, n1, n2, i, i1, i2,
@@ -1023,7 +1164,22 @@ static SEXP real_binary(ARITHOP_TYPE code, SEXP s1, SEXP s2)
 			      REAL(ans)[i] = REAL(s1)[i1] / R_INTEGER(s2, i2););
 	break;
     case POWOP:
-	if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
+	if(n2 == 1 && (TYPEOF(s2) == REALSXP ? REAL(s2)[0] == 2.0 :
+		       INTEGER(s2)[0] == 2) && !simd_anyNA_int(s1)) {
+	    /* x ^ 2, as computed by R_POW() */
+	    double *da = REAL(ans);
+	    if(TYPEOF(s1) == REALSXP) {
+		const double *dx = REAL_RO(s1);
+		SIMD_ITERATE_CHECK(NINTERRUPT, n, i, SIMD_LOOP,
+				   RSQUARE_KERNEL(dx[i]););
+	    }
+	    else {
+		const int *px = INTEGER_RO(s1);
+		SIMD_ITERATE_CHECK(NINTERRUPT, n, i, SIMD_LOOP,
+				   RSQUARE_KERNEL(TO_REAL(px[i])););
+	    }
+	}
+	else if(TYPEOF(s1) == REALSXP && TYPEOF(s2) == REALSXP) {
 	    double *da = REAL(ans);
 	    double *dx = REAL(s1);
 	    double *dy = REAL(s2);
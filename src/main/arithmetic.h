@@ -95,6 +95,64 @@ static R_INLINE SEXP R_allocOrReuseVector(SEXP s1, SEXP s2,
     return allocVector(type, n);
 }
 
+/* Loops over the elements of binary operations for the cases where
+   neither operand is recycled or one of them is a scalar, marked as
+   SIMD loops so that compilers supporting OpenMP 4.0 emit vector code
+   for branch-free kernels.  Interrupts are checked every NINTERRUPT
+   elements, as by R_ITERATE_CHECK.  The kernels are macros of the
+   two operands storing element i of the result. */
+#if defined(_OPENMP) && HAVE_OPENMP_SIMDRED
+# define SIMD_PRAGMA(x) _Pragma(#x)
+# define SIMD_LOOP SIMD_PRAGMA(omp simd)
+# define SIMD_LOOP_OR(v) SIMD_PRAGMA(omp simd reduction(|:v))
+# define SIMD_LOOP_SUM(v) SIMD_PRAGMA(omp simd reduction(+:v))
+#else
+# define SIMD_LOOP
+# define SIMD_LOOP_OR(v)
+# define SIMD_LOOP_SUM(v)
+#endif
+
+#define SIMD_ITERATE_CORE(n, i, PRAGMA, ...) do {			\
+	R_xlen_t __simd_start__ = i, __simd_end__ = (R_xlen_t) (n);	\
+	PRAGMA								\
+	for (i = __simd_start__; i < __simd_end__; i++) { __VA_ARGS__ } \
+    } while (0)
+
+#define SIMD_ITERATE_CHECK(ncheck, n, i, PRAGMA, ...) do {		\
+	i = 0;								\
+	LOOP_WITH_INTERRUPT_CHECK(SIMD_ITERATE_CORE, ncheck, n, i,	\
+				  PRAGMA, __VA_ARGS__);			\
+    } while (0)
+
+/* needs n1 == n2, n1 == 1 or n2 == 1 */
+#define SIMD_ARITH(PRAGMA, type1, px1, CONV1, type2, px2, CONV2, KERNEL) do { \
+	if (n1 == n2)							\
+	    SIMD_ITERATE_CHECK(NINTERRUPT, n, i, PRAGMA,		\
+			       KERNEL(CONV1(px1[i]), CONV2(px2[i])););	\
+	else if (n2 == 1) {						\
+	    type2 __s2__ = px2[0];					\
+	    SIMD_ITERATE_CHECK(NINTERRUPT, n, i, PRAGMA,		\
+			       KERNEL(CONV1(px1[i]), CONV2(__s2__)););	\
+	}								\
+	else {								\
+	    type1 __s1__ = px1[0];					\
+	    SIMD_ITERATE_CHECK(NINTERRUPT, n, i, PRAGMA,		\
+			       KERNEL(CONV1(__s1__), CONV2(px2[i])););	\
+	}								\
+    } while (0)
+
+#define SIMD_ARITH_OK(n1, n2) ((n1) == (n2) || (n1) == 1 || (n2) == 1)
+
+/* When both operands of + or * are NaN the result has the payload of
+   the one the hardware sees first, and the compiler is free to swap
+   them.  Select the first operand explicitly, so that NaN and NA
+   propagate in operand order in the vector kernels and in the byte
+   code fast path for scalars alike. */
+#define NAN_FIRST(X, Z) (ISNAN(X) ? (X) + 0.0 : (Z))
+
+#define NO_CONV(x) (x)
+#define TO_REAL(x) ((double) (x))
+
 #if defined(HAVE_TANPI) || defined(HAVE___TANPI)
 // we document that tanpi(0.5) is NaN, but TS 18661-4:2015
 // does not require this and the Solaris and macOS versions give Inf.
@@ -319,9 +319,15 @@ IntegerAnswer(SEXP x, struct BindData *data, SEXP call)
 	    INTEGER(data->ans_ptr)[data->ans_length++] = LOGICAL(x)[i];
 	break;
     case INTSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    INTEGER(data->ans_ptr)[data->ans_length++] = INTEGER(x)[i];
+    {
+	R_xlen_t n = XLENGTH(x);
+	const int *px = INTEGER_RO(x);
+	int *pa = INTEGER(data->ans_ptr) + data->ans_length;
+	for (i = 0; i < n; i++)
+	    pa[i] = px[i];
+	data->ans_length += n;
 	break;
+    }
     case RAWSXP:
 	for (i = 0; i < XLENGTH(x); i++)
 	    INTEGER(data->ans_ptr)[data->ans_length++] = (int)RAW(x)[i];
@@ -352,9 +358,15 @@ RealAnswer(SEXP x, struct BindData *data, SEXP call)
 	    RealAnswer(VECTOR_ELT(x, i), data, call);
 	break;
     case REALSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    REAL(data->ans_ptr)[data->ans_length++] = REAL(x)[i];
+    {
+	R_xlen_t n = XLENGTH(x);
+	const double *px = REAL_RO(x);
+	double *pa = REAL(data->ans_ptr) + data->ans_length;
+	for (i = 0; i < n; i++)
+	    pa[i] = px[i];
+	data->ans_length += n;
 	break;
+    }
     case LGLSXP:
 	for (i = 0; i < XLENGTH(x); i++) {
 	    xi = LOGICAL(x)[i];
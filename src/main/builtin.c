@@ -413,6 +413,7 @@ SEXP attribute_hidden do_parentenvgets(SEXP call, SEXP op, SEXP args, SEXP rho)
 	error(_("'parent' is not an environment"));
 
     SET_ENCLOS(env, parent);
+    R_LOOKUP_CHANGED(); /* S3 methods and functions may now differ */
 
     return( CAR(args) );
 }
@@ -720,6 +720,12 @@ static SEXP coerceToString(SEXP v)
     int savedigits, warn = 0;
     R_xlen_t i, n;
 
+#ifdef R_MEMORY_PROFILING
+    if (!RTRACE(v))
+#endif
+    if ((ans = R_deferred_coerceToString(v)) != NULL)
+	return ans;
+
     PROTECT(ans = allocVector(STRSXP, n = XLENGTH(v)));
 #ifdef R_MEMORY_PROFILING
     if (RTRACE(v)){
@@ -2007,13 +2013,29 @@ SEXP attribute_hidden do_isna(SEXP call, SEXP op, SEXP args, SEXP rho)
 	    LOGICAL(ans)[i] = (LOGICAL(x)[i] == NA_LOGICAL);
 	break;
     case INTSXP:
+    {
+	int *pa = LOGICAL(ans);
+	if (INTEGER_NO_NA(x)) {
+	    for (i = 0; i < n; i++) pa[i] = 0;
+	    break;
+	}
+	const int *px = INTEGER_RO(x);
 	for (i = 0; i < n; i++)
-	    LOGICAL(ans)[i] = (INTEGER(x)[i] == NA_INTEGER);
+	    pa[i] = (px[i] == NA_INTEGER);
 	break;
+    }
     case REALSXP:
+    {
+	int *pa = LOGICAL(ans);
+	if (REAL_NO_NA(x)) {
+	    for (i = 0; i < n; i++) pa[i] = 0;
+	    break;
+	}
+	const double *px = REAL_RO(x);
 	for (i = 0; i < n; i++)
-	    LOGICAL(ans)[i] = ISNAN(REAL(x)[i]);
+	    pa[i] = ISNAN(px[i]);
 	break;
+    }
     case CPLXSXP:
 	for (i = 0; i < n; i++)
 	    LOGICAL(ans)[i] = (ISNAN(COMPLEX(x)[i].r) ||
@@ -2113,6 +2135,7 @@ static Rboolean anyNA(SEXP call, SEXP op, SEXP args, SEXP env)
     switch (xT) {
     case REALSXP:
     {
+	if (REAL_NO_NA(x)) break;
 	double *xD = REAL(x);
 	for (i = 0; i < n; i++)
 	    if (ISNAN(xD[i])) return TRUE;
@@ -2120,6 +2143,7 @@ static Rboolean anyNA(SEXP call, SEXP op, SEXP args, SEXP env)
     }
     case INTSXP:
     {
+	if (INTEGER_NO_NA(x)) break;
 	int *xI = INTEGER(x);
 	for (i = 0; i < n; i++)
 	    if (xI[i] == NA_INTEGER) return TRUE;
@@ -169,6 +169,8 @@ static void R_restore_globals(RCNTXT *cptr)
     R_BCIntActive = cptr->bcintactive;
     R_BCpc = cptr->bcpc;
     R_BCbody = cptr->bcbody;
+    if (R_BCCountFrame != cptr->bccountframe)
+	R_BCCountUnwind(cptr->bccountframe);
     R_EvalDepth = cptr->evaldepth;
     vmaxset(cptr->vmax);
     R_interrupts_suspended = cptr->intsusp;
@@ -249,6 +251,7 @@ void begincontext(RCNTXT * cptr, int flags,
     cptr->gcenabled = R_GCEnabled;
     cptr->bcpc = R_BCpc;
     cptr->bcbody = R_BCbody;
+    cptr->bccountframe = R_BCCountFrame;
     cptr->bcintactive = R_BCIntActive;
     cptr->evaldepth = R_EvalDepth;
     cptr->callflag = flags;
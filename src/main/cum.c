@@ -28,8 +28,9 @@
 static SEXP cumsum(SEXP x, SEXP s)
 {
     LDOUBLE sum = 0.;
-    double *rx = REAL(x), *rs = REAL(s);
-    for (R_xlen_t i = 0 ; i < XLENGTH(x) ; i++) {
+    const double *rx = REAL_RO(x);
+    double *rs = REAL(s);
+    for (R_xlen_t i = 0, n = XLENGTH(x) ; i < n ; i++) {
 	sum += rx[i]; /* NA and NaN propagated */
 	rs[i] = (double) sum;
     }
@@ -39,9 +40,10 @@ static SEXP cumsum(SEXP x, SEXP s)
 /* We need to ensure that overflow gives NA here */
 static SEXP icumsum(SEXP x, SEXP s)
 {
-    int *ix = INTEGER(x), *is = INTEGER(s);
+    const int *ix = INTEGER_RO(x);
+    int *is = INTEGER(s);
     double sum = 0.0;
-    for (R_xlen_t i = 0 ; i < XLENGTH(x) ; i++) {
+    for (R_xlen_t i = 0, n = XLENGTH(x) ; i < n ; i++) {
 	if (ix[i] == NA_INTEGER) break;
 	sum += ix[i];
 	if(sum > INT_MAX || sum < 1 + INT_MIN) { /* INT_MIN is NA_INTEGER */
@@ -58,7 +60,7 @@ static SEXP ccumsum(SEXP x, SEXP s)
     Rcomplex sum;
     sum.r = 0;
     sum.i = 0;
-    for (R_xlen_t i = 0 ; i < XLENGTH(x) ; i++) {
+    for (R_xlen_t i = 0, n = XLENGTH(x) ; i < n ; i++) {
 	sum.r += COMPLEX(x)[i].r;
 	sum.i += COMPLEX(x)[i].i;
 	COMPLEX(s)[i].r = sum.r;
@@ -70,9 +72,10 @@ static SEXP ccumsum(SEXP x, SEXP s)
 static SEXP cumprod(SEXP x, SEXP s)
 {
     LDOUBLE prod;
-    double *rx = REAL(x), *rs = REAL(s);
+    const double *rx = REAL_RO(x);
+    double *rs = REAL(s);
     prod = 1.0;
-    for (R_xlen_t i = 0 ; i < XLENGTH(x) ; i++) {
+    for (R_xlen_t i = 0, n = XLENGTH(x) ; i < n ; i++) {
 	prod *= rx[i]; /* NA and NaN propagated */
 	rs[i] = (double) prod;
     }
@@ -84,7 +87,7 @@ static SEXP ccumprod(SEXP x, SEXP s)
     Rcomplex prod, tmp;
     prod.r = 1;
     prod.i = 0;
-    for (R_xlen_t i = 0 ; i < XLENGTH(x) ; i++) {
+    for (R_xlen_t i = 0, n = XLENGTH(x) ; i < n ; i++) {
 	tmp.r = prod.r;
 	tmp.i = prod.i;
 	prod.r = COMPLEX(x)[i].r * tmp.r - COMPLEX(x)[i].i * tmp.i;
@@ -97,9 +100,10 @@ static SEXP ccumprod(SEXP x, SEXP s)
 
 static SEXP cummax(SEXP x, SEXP s)
 {
-    double max, *rx = REAL(x), *rs = REAL(s);
+    double max, *rs = REAL(s);
+    const double *rx = REAL_RO(x);
     max = R_NegInf;
-    for (R_xlen_t i = 0 ; i < XLENGTH(x) ; i++) {
+    for (R_xlen_t i = 0, n = XLENGTH(x) ; i < n ; i++) {
 	if(ISNAN(rx[i]) || ISNAN(max))
 	    max = max + rx[i];  /* propagate NA and NaN */
 	else
@@ -111,9 +115,10 @@ static SEXP cummax(SEXP x, SEXP s)
 
 static SEXP cummin(SEXP x, SEXP s)
 {
-    double min, *rx = REAL(x), *rs = REAL(s);
+    double min, *rs = REAL(s);
+    const double *rx = REAL_RO(x);
     min = R_PosInf; /* always positive, not NA */
-    for (R_xlen_t i = 0 ; i < XLENGTH(x) ; i++ ) {
+    for (R_xlen_t i = 0, n = XLENGTH(x) ; i < n ; i++) {
 	if (ISNAN(rx[i]) || ISNAN(min))
 	    min = min + rx[i];  /* propagate NA and NaN */
 	else
@@ -125,12 +130,12 @@ static SEXP cummin(SEXP x, SEXP s)
 
 static SEXP icummax(SEXP x, SEXP s)
 {
-    int *ix = INTEGER(x);
+    const int *ix = INTEGER_RO(x);
     if(ix[0] == NA_INTEGER)
 	return s; // all NA
     int *is = INTEGER(s), max = ix[0];
     is[0] = max;
-    for (R_xlen_t i = 1 ; i < XLENGTH(x) ; i++) {
+    for (R_xlen_t i = 1, n = XLENGTH(x) ; i < n ; i++) {
 	if(ix[i] == NA_INTEGER) break;
 	is[i] = max = (max > ix[i]) ? max : ix[i];
     }
@@ -139,10 +144,11 @@ static SEXP icummax(SEXP x, SEXP s)
 
 static SEXP icummin(SEXP x, SEXP s)
 {
-    int *ix = INTEGER(x), *is = INTEGER(s);
+    const int *ix = INTEGER_RO(x);
+    int *is = INTEGER(s);
     int min = ix[0];
     is[0] = min;
-    for (R_xlen_t i = 1 ; i < XLENGTH(x) ; i++ ) {
+    for (R_xlen_t i = 1, n = XLENGTH(x) ; i < n ; i++) {
 	if(ix[i] == NA_INTEGER) break;
 	is[i] = min = (min < ix[i]) ? min : ix[i];
     }
@@ -278,6 +278,20 @@ static SEXP duplicate1(SEXP s, Rboolean deep)
     SEXP t;
     R_xlen_t i, n;
 
+    if (isVector(s) && ALTREP(s)) {
+	PROTECT(s);
+	t = ALTREP_DUPLICATE(s, deep);
+	if (t != NULL) {
+	    PROTECT(t);
+	    DUPLICATE_ATTRIB(t, s, deep);
+	    SET_OBJECT(t, OBJECT(s));
+	    (IS_S4_OBJECT(s) ? SET_S4_OBJECT(t) : UNSET_S4_OBJECT(t));
+	    UNPROTECT(2);
+	    return t;
+	}
+	UNPROTECT(1);
+    }
+
     switch (TYPEOF(s)) {
     case NILSXP:
     case SYMSXP:
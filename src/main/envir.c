@@ -120,6 +120,7 @@
   if (BINDING_IS_LOCKED(__b__)) \
     error(_("cannot change value of locked binding for '%s'"), \
 	  CHAR(PRINTNAME(TAG(__b__)))); \
+  R_BINDING_CHANGED(TAG(__b__)); \
   if (IS_ACTIVE_BINDING(__b__)) \
     setActiveValue(CAR(__b__), __val__); \
   else \
@@ -132,6 +133,7 @@
   if (BINDING_IS_LOCKED(__sym__)) \
     error(_("cannot change value of locked binding for '%s'"), \
 	  CHAR(PRINTNAME(__sym__))); \
+  R_BINDING_CHANGED(__sym__); \
   if (IS_ACTIVE_BINDING(__sym__)) \
     setActiveValue(SYMVALUE(__sym__), __val__); \
   else \
@@ -178,8 +180,25 @@ Rboolean R_envHasNoSpecialSymbols (SEXP env)
 
   Hash Tables
 
-  We use a basic separate chaining algorithm.	A hash table consists
-  of SEXP (vector) which contains a number of SEXPs (lists).
+  We use open addressing with linear probing.  A hash table is a
+  SEXP (vector) whose length is a power of two; each slot is either
+  R_NilValue or a single binding cell, a one-element tagged list
+  holding the symbol and its value.  Since every slot is still a
+  (possibly empty) list, code that walks the table chain by chain
+  keeps working unchanged.  The binding cells are never copied when
+  the table grows, so references to them (the global cache, the byte
+  code engine) stay valid.
+
+  The slot for a symbol is found by scrambling the hash value cached
+  in its print name; HASHPRI holds the number of bindings, and the
+  table is doubled once this exceeds HASHMAXLOAD of the slots, so
+  probe sequences are short and always end at an empty slot.
+  Deletion shifts later entries of the probe run back, so no
+  tombstones are needed.
+
+  Tables are saved in the chained layout used by earlier versions of
+  R (see R_HashTableForSave) and rebuilt when they are read back
+  (see R_RestoreHashCount).
 
   The only non-static function is R_NewHashedEnv, which allows code to
   request a hashed environment.  All others are static to allow
@@ -188,10 +207,17 @@ Rboolean R_envHasNoSpecialSymbols (SEXP env)
 
 #define HASHSIZE(x)	     LENGTH(x)
 #define HASHPRI(x)	     TRUELENGTH(x)
-#define HASHTABLEGROWTHRATE  1.2
-#define HASHMINSIZE	     29
+#define HASHTABLEGROWTHRATE  2
+#define HASHMINSIZE	     32
+#define HASHMAXSIZE	     1073741824 /* 2^30 */
+#define HASHMAXLOAD	     0.7
 #define SET_HASHPRI(x,v)     SET_TRUELENGTH(x,v)
 
+/* Fibonacci hashing of the PJW hash value; 'size' is a power of two */
+#define HASHSLOT(h, size) \
+  ((int) ((((uint64_t) (unsigned int) (h)) * 0x9E3779B97F4A7C15ULL) >> 32) \
+   & ((size) - 1))
+
 #define IS_HASHED(x)	     (HASHTAB(x) != R_NilValue)
 
 /*----------------------------------------------------------------------
@@ -223,38 +249,83 @@ int attribute_hidden R_Newhashpjw(const char *s)
     return h;
 }
 
+static R_INLINE int symbolHash(SEXP symbol)
+{
+    SEXP c = PRINTNAME(symbol);
+    if( !HASHASH(c) ) {
+	SET_HASHVALUE(c, R_Newhashpjw(CHAR(c)));
+	SET_HASHASH(c, 1);
+    }
+    return HASHVALUE(c);
+}
+
+/*----------------------------------------------------------------------
+
+  R_HashFind
+
+  Probes 'table' for 'symbol' starting at the slot for 'hashcode'.
+  Returns the index of the slot holding the binding cell, or -1 - i
+  where i is the empty slot that ended the probe sequence.
+
+*/
+
+static R_INLINE int R_HashFind(int hashcode, SEXP symbol, SEXP table)
+{
+    int mask = HASHSIZE(table) - 1;
+    int i = HASHSLOT(hashcode, HASHSIZE(table));
+    SEXP cell;
+
+    while ((cell = VECTOR_ELT(table, i)) != R_NilValue) {
+	if (TAG(cell) == symbol)
+	    return i;
+	i = (i + 1) & mask;
+    }
+    return -1 - i;
+}
+
+/* Enter an existing binding cell without checking for duplicates;
+   used when (re)building tables. */
+static void R_HashInsertCell(SEXP cell, SEXP table)
+{
+    int mask = HASHSIZE(table) - 1;
+    int i = HASHSLOT(symbolHash(TAG(cell)), HASHSIZE(table));
+
+    while (VECTOR_ELT(table, i) != R_NilValue)
+	i = (i + 1) & mask;
+    SETCDR(cell, R_NilValue);
+    SET_VECTOR_ELT(table, i, cell);
+    SET_HASHPRI(table, HASHPRI(table) + 1);
+}
+
 /*----------------------------------------------------------------------
 
   R_HashSet
 
   Hashtable set function.  Sets 'symbol' in 'table' to be 'value'.
-  'hashcode' must be provided by user.	Allocates some memory for list
-  entries.
+  'hashcode' must be provided by user.	Allocates a binding cell for
+  new entries; the caller is responsible for growing the table.
 
 */
 
 static void R_HashSet(int hashcode, SEXP symbol, SEXP table, SEXP value,
 		      Rboolean frame_locked)
 {
-    SEXP chain;
-
-    /* Grab the chain from the hashtable */
-    chain = VECTOR_ELT(table, hashcode);
+    SEXP cell;
+    int i = R_HashFind(hashcode, symbol, table);
 
-    /* Search for the value in the chain */
-    for (; !ISNULL(chain); chain = CDR(chain))
-	if (TAG(chain) == symbol) {
-	    SET_BINDING_VALUE(chain, value);
-	    SET_MISSING(chain, 0);	/* Over-ride for new value */
-	    return;
-	}
+    if (i >= 0) {
+	cell = VECTOR_ELT(table, i);
+	SET_BINDING_VALUE(cell, value);
+	SET_MISSING(cell, 0);	/* Over-ride for new value */
+	return;
+    }
     if (frame_locked)
 	error(_("cannot add bindings to a locked environment"));
-    if (ISNULL(chain))
-	SET_HASHPRI(table, HASHPRI(table) + 1);
-    /* Add the value into the chain */
-    SET_VECTOR_ELT(table, hashcode, CONS(value, VECTOR_ELT(table, hashcode)));
-    SET_TAG(VECTOR_ELT(table, hashcode), symbol);
+    /* Add the value in the empty slot that ended the probe */
+    cell = CONS(value, R_NilValue);
+    SET_TAG(cell, symbol);
+    SET_VECTOR_ELT(table, -1 - i, cell);
+    SET_HASHPRI(table, HASHPRI(table) + 1);
     return;
 }
 
@@ -272,28 +343,13 @@ static void R_HashSet(int hashcode, SEXP symbol, SEXP table, SEXP value,
 
 static SEXP R_HashGet(int hashcode, SEXP symbol, SEXP table)
 {
-    SEXP chain;
-
-    /* Grab the chain from the hashtable */
-    chain = VECTOR_ELT(table, hashcode);
-    /* Retrieve the value from the chain */
-    for (; chain != R_NilValue ; chain = CDR(chain))
-	if (TAG(chain) == symbol) return BINDING_VALUE(chain);
-    /* If not found */
-    return R_UnboundValue;
+    int i = R_HashFind(hashcode, symbol, table);
+    return i >= 0 ? BINDING_VALUE(VECTOR_ELT(table, i)) : R_UnboundValue;
 }
 
 static Rboolean R_HashExists(int hashcode, SEXP symbol, SEXP table)
 {
-    SEXP chain;
-
-    /* Grab the chain from the hashtable */
-    chain = VECTOR_ELT(table, hashcode);
-    /* Find the binding in the chain */
-    for (; chain != R_NilValue ; chain = CDR(chain))
-	if (TAG(chain) == symbol) return TRUE;
-    /* If not found */
-    return FALSE;
+    return R_HashFind(hashcode, symbol, table) >= 0;
 }
 
 
@@ -310,15 +366,8 @@ static Rboolean R_HashExists(int hashcode, SEXP symbol, SEXP table)
 
 static SEXP R_HashGetLoc(int hashcode, SEXP symbol, SEXP table)
 {
-    SEXP chain;
-
-    /* Grab the chain from the hashtable */
-    chain = VECTOR_ELT(table, hashcode);
-    /* Retrieve the value from the chain */
-    for (; !ISNULL(chain); chain = CDR(chain))
-	if (TAG(chain) == symbol) return chain;
-    /* If not found */
-    return R_NilValue;
+    int i = R_HashFind(hashcode, symbol, table);
+    return i >= 0 ? VECTOR_ELT(table, i) : R_NilValue;
 }
 
 
@@ -327,19 +376,22 @@ static SEXP R_HashGetLoc(int hashcode, SEXP symbol, SEXP table)
 
   R_NewHashTable
 
-  Hash table initialisation function.  Creates a table of size 'size'
-  that increases in size by 'growth_rate' after a threshold is met.
+  Hash table initialisation function.  Creates a table with at least
+  'size' slots, rounded up to a power of two.
 
 */
 
 static SEXP R_NewHashTable(int size)
 {
     SEXP table;
+    int n;
 
     if (size <= 0) size = HASHMINSIZE;
+    if (size > HASHMAXSIZE) size = HASHMAXSIZE;
+    for (n = 1; n < size; n *= 2);
 
     /* Allocate hash table in the form of a vector */
-    PROTECT(table = allocVector(VECSXP, size));
+    PROTECT(table = allocVector(VECSXP, n));
     SET_HASHPRI(table, 0);
     UNPROTECT(1);
     return(table);
@@ -370,32 +422,37 @@ SEXP R_NewHashedEnv(SEXP enclos, SEXP size)
 
   R_HashDelete
 
-  Hash table delete function.  Symbols are not removed from the table.
-  They have their value set to 'R_UnboundValue'.
+  Hash table delete function.  Removes the binding cell for 'symbol'
+  and moves later entries of its probe run back into the gap.
+  Returns 1 if a binding was removed, 0 otherwise.
 
 */
 
-static SEXP DeleteItem(SEXP symbol, SEXP lst)
+static int R_HashDelete(int hashcode, SEXP symbol, SEXP table)
 {
-    if (lst != R_NilValue) {
-	SETCDR(lst, DeleteItem(symbol, CDR(lst)));
-	if (TAG(lst) == symbol) {
-	    SETCAR(lst, R_UnboundValue); /* in case binding is cached */
-	    LOCK_BINDING(lst);           /* in case binding is cached */
-	    lst = CDR(lst);
-	}
+    int mask = HASHSIZE(table) - 1, i, j, k;
+    SEXP cell;
+
+    R_BINDING_CHANGED(symbol);
+    i = R_HashFind(hashcode, symbol, table);
+    if (i < 0)
+	return 0;
+    cell = VECTOR_ELT(table, i);
+    SETCAR(cell, R_UnboundValue); /* in case binding is cached */
+    LOCK_BINDING(cell);           /* in case binding is cached */
+    for (j = (i + 1) & mask; (cell = VECTOR_ELT(table, j)) != R_NilValue;
+	 j = (j + 1) & mask) {
+	/* An entry can fill the gap at i unless its home slot k lies
+	   cyclically in (i, j]. */
+	k = HASHSLOT(symbolHash(TAG(cell)), HASHSIZE(table));
+	if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+	    continue;
+	SET_VECTOR_ELT(table, i, cell);
+	i = j;
     }
-    return lst;
-}
-
-static void R_HashDelete(int hashcode, SEXP symbol, SEXP table)
-{
-    SEXP list = DeleteItem(symbol,
-			   VECTOR_ELT(table, hashcode % HASHSIZE(table)));
-    if (list == R_NilValue)
-	SET_HASHPRI(table, HASHPRI(table) - 1);
-    SET_VECTOR_ELT(table, hashcode % HASHSIZE(table), list);
-    return;
+    SET_VECTOR_ELT(table, i, R_NilValue);
+    SET_HASHPRI(table, HASHPRI(table) - 1);
+    return 1;
 }
 
 
@@ -404,50 +461,32 @@ static void R_HashDelete(int hashcode, SEXP symbol, SEXP table)
 
   R_HashResize
 
-  Hash table resizing function Increase the size of the hash table by
-  the growth_rate of the table.	 The vector is reallocated, however
-  the lists with in the hash table have their pointers shuffled around
-  so that they are not reallocated.
+  Hash table resizing function.  Increase the size of the hash table
+  by the growth rate of the table.  The vector is reallocated, however
+  the binding cells are moved to the new table so that they are not
+  reallocated.
 
 */
 
 static SEXP R_HashResize(SEXP table)
 {
-    SEXP new_table, chain, new_chain, tmp_chain;
-    int counter, new_hashcode;
+    SEXP new_table, cell;
+    int counter;
 
     /* Do some checking */
     if (TYPEOF(table) != VECSXP)
 	error("first argument ('table') not of type VECSXP, from R_HashResize");
-
-    /* This may have to change.	 The growth rate should
-       be independent of the size (not implemented yet) */
-    /* hash_grow = HASHSIZE(table); */
+    if (HASHSIZE(table) >= HASHMAXSIZE)
+	return table;
 
     /* Allocate the new hash table */
-    new_table = R_NewHashTable((int)(HASHSIZE(table) * HASHTABLEGROWTHRATE));
-    for (counter = 0; counter < length(table); counter++) {
-	chain = VECTOR_ELT(table, counter);
-	while (!ISNULL(chain)) {
-	    new_hashcode = R_Newhashpjw(CHAR(PRINTNAME(TAG(chain)))) %
-		HASHSIZE(new_table);
-	    new_chain = VECTOR_ELT(new_table, new_hashcode);
-	    /* If using a primary slot then increase HASHPRI */
-	    if (ISNULL(new_chain))
-		SET_HASHPRI(new_table, HASHPRI(new_table) + 1);
-	    tmp_chain = chain;
-	    chain = CDR(chain);
-	    SETCDR(tmp_chain, new_chain);
-	    SET_VECTOR_ELT(new_table, new_hashcode,  tmp_chain);
-#ifdef MIKE_DEBUG
-	    fprintf(stdout, "HASHSIZE = %d\nHASHPRI = %d\ncounter = %d\nHASHCODE = %d\n",
-		    HASHSIZE(table), HASHPRI(table), counter, new_hashcode);
-#endif
-	}
+    new_table = R_NewHashTable(HASHSIZE(table) * HASHTABLEGROWTHRATE);
+    for (counter = 0; counter < HASHSIZE(table); counter++) {
+	cell = VECTOR_ELT(table, counter);
+	if (!ISNULL(cell))
+	    R_HashInsertCell(cell, new_table);
     }
-    /* Some debugging statements */
 #ifdef MIKE_DEBUG
-    fprintf(stdout, "Resized O.K.\n");
     fprintf(stdout, "Old size: %d, New size: %d\n",
 	    HASHSIZE(table), HASHSIZE(new_table));
     fprintf(stdout, "Old pri: %d, New pri: %d\n",
@@ -463,23 +502,20 @@ static SEXP R_HashResize(SEXP table)
   R_HashSizeCheck
 
   Hash table size rechecking function.	Compares the load factor
-  (size/# of primary slots used)  to a particular threshhold value.
-  Returns true if the table needs to be resized.
+  (# of bindings/size) to HASHMAXLOAD.  Returns true if the table
+  needs to be resized.
 
 */
 
 static int R_HashSizeCheck(SEXP table)
 {
-    int resize;
-    double thresh_val;
-
     /* Do some checking */
     if (TYPEOF(table) != VECSXP)
 	error("first argument ('table') not of type VECSXP, R_HashSizeCheck");
-    resize = 0; thresh_val = 0.85;
-    if ((double)HASHPRI(table) > (double)HASHSIZE(table) * thresh_val)
-	resize = 1;
-    return resize;
+    if (HASHPRI(table) + 1 >= HASHSIZE(table) &&
+	HASHSIZE(table) >= HASHMAXSIZE)
+	error(_("hash table is full"));
+    return (double)HASHPRI(table) > (double)HASHSIZE(table) * HASHMAXLOAD;
 }
 
 
@@ -497,33 +533,59 @@ static int R_HashSizeCheck(SEXP table)
 
 static SEXP R_HashFrame(SEXP rho)
 {
-    int hashcode;
-    SEXP frame, chain, tmp_chain, table;
+    SEXP frame, cell;
 
     /* Do some checking */
     if (TYPEOF(rho) != ENVSXP)
 	error("first argument ('table') not of type ENVSXP, from R_HashVector2Hash");
-    table = HASHTAB(rho);
     frame = FRAME(rho);
     while (!ISNULL(frame)) {
-	if( !HASHASH(PRINTNAME(TAG(frame))) ) {
-	    SET_HASHVALUE(PRINTNAME(TAG(frame)),
-			  R_Newhashpjw(CHAR(PRINTNAME(TAG(frame)))));
-	    SET_HASHASH(PRINTNAME(TAG(frame)), 1);
-	}
-	hashcode = HASHVALUE(PRINTNAME(TAG(frame))) % HASHSIZE(table);
-	chain = VECTOR_ELT(table, hashcode);
-	/* If using a primary slot then increase HASHPRI */
-	if (ISNULL(chain)) SET_HASHPRI(table, HASHPRI(table) + 1);
-	tmp_chain = frame;
+	cell = frame;
 	frame = CDR(frame);
-	SETCDR(tmp_chain, chain);
-	SET_VECTOR_ELT(table, hashcode, tmp_chain);
+	/* keep the rest of the frame reachable while the table grows */
+	SET_FRAME(rho, frame);
+	R_HashInsertCell(cell, HASHTAB(rho));
+	if (R_HashSizeCheck(HASHTAB(rho)))
+	    SET_HASHTAB(rho, R_HashResize(HASHTAB(rho)));
     }
-    SET_FRAME(rho, R_NilValue);
     return rho;
 }
 
+/*----------------------------------------------------------------------
+
+  R_HashTableForSave
+
+  Returns a copy of 'table' in the chained layout of earlier versions
+  of R, with each binding in the chain at position hash % size, so
+  that saved environments can still be read by them.  The copied cells
+  keep the locked, active and missing bits of the bindings.
+
+*/
+
+SEXP attribute_hidden R_HashTableForSave(SEXP table)
+{
+    SEXP val, cell, copy;
+    int i, k, size;
+
+    if (TYPEOF(table) != VECSXP)
+	return table;
+    size = HASHSIZE(table);
+    PROTECT(table);
+    PROTECT(val = allocVector(VECSXP, size));
+    for (i = 0; i < size; i++) {
+	cell = VECTOR_ELT(table, i);
+	if (!ISNULL(cell)) {
+	    k = symbolHash(TAG(cell)) % size;
+	    copy = CONS(CAR(cell), VECTOR_ELT(val, k));
+	    SET_TAG(copy, TAG(cell));
+	    SETLEVELS(copy, LEVELS(cell));
+	    SET_VECTOR_ELT(val, k, copy);
+	}
+    }
+    UNPROTECT(2);
+    return val;
+}
+
 
 /* ---------------------------------------------------------------------
 
@@ -534,38 +596,36 @@ static SEXP R_HashFrame(SEXP rho)
 
    size: the total size of the hash table
 
-   nchains: the number of non-null chains in the table (as reported by
+   nchains: the number of bindings in the table (as reported by
 	    HASHPRI())
 
-   counts: an integer vector the same length as size giving the length of
-	   each chain (or zero if no chain is present).  This allows
-	   for assessing collisions in the hash table.
+   counts: an integer vector the same length as size giving the number
+	   of probes needed to find the binding in each slot (or zero
+	   if the slot is empty).  This allows for assessing collisions
+	   in the hash table.
  */
 
 static SEXP R_HashProfile(SEXP table)
 {
-    SEXP chain, ans, chain_counts, nms;
-    int i, count;
+    SEXP cell, ans, chain_counts, nms;
+    int i, size = HASHSIZE(table);
 
     PROTECT(ans = allocVector(VECSXP, 3));
     PROTECT(nms = allocVector(STRSXP, 3));
     SET_STRING_ELT(nms, 0, mkChar("size"));    /* size of hashtable */
-    SET_STRING_ELT(nms, 1, mkChar("nchains")); /* number of non-null chains */
-    SET_STRING_ELT(nms, 2, mkChar("counts"));  /* length of each chain */
+    SET_STRING_ELT(nms, 1, mkChar("nchains")); /* number of bindings */
+    SET_STRING_ELT(nms, 2, mkChar("counts"));  /* probes for each slot */
     setAttrib(ans, R_NamesSymbol, nms);
     UNPROTECT(1);
 
     SET_VECTOR_ELT(ans, 0, ScalarInteger(length(table)));
     SET_VECTOR_ELT(ans, 1, ScalarInteger(HASHPRI(table)));
 
-    PROTECT(chain_counts = allocVector(INTSXP, length(table)));
-    for (i = 0; i < length(table); i++) {
-	chain = VECTOR_ELT(table, i);
-	count = 0;
-	for (; chain != R_NilValue ; chain = CDR(chain)) {
-	    count++;
-	}
-	INTEGER(chain_counts)[i] = count;
+    PROTECT(chain_counts = allocVector(INTSXP, size));
+    for (i = 0; i < size; i++) {
+	cell = VECTOR_ELT(table, i);
+	INTEGER(chain_counts)[i] = ISNULL(cell) ? 0 :
+	    ((i - HASHSLOT(symbolHash(TAG(cell)), size)) & (size - 1)) + 1;
     }
 
     SET_VECTOR_ELT(ans, 2, chain_counts);
@@ -686,19 +746,9 @@ void attribute_hidden InitGlobalEnv()
 }
 
 #ifdef USE_GLOBAL_CACHE
-static int hashIndex(SEXP symbol, SEXP table)
-{
-    SEXP c = PRINTNAME(symbol);
-    if( !HASHASH(c) ) {
-	SET_HASHVALUE(c, R_Newhashpjw(CHAR(c)));
-	SET_HASHASH(c, 1);
-    }
-    return HASHVALUE(c) % HASHSIZE(table);
-}
-
 static void R_FlushGlobalCache(SEXP sym)
 {
-    SEXP entry = R_HashGetLoc(hashIndex(sym, R_GlobalCache), sym,
+    SEXP entry = R_HashGetLoc(symbolHash(sym), sym,
 			      R_GlobalCache);
     if (entry != R_NilValue) {
 	SETCAR(entry, R_UnboundValue);
@@ -738,8 +788,7 @@ static void R_FlushGlobalCacheFromUserTable(SEXP udb)
 
 static void R_AddGlobalCache(SEXP symbol, SEXP place)
 {
-    int oldpri = HASHPRI(R_GlobalCache);
-    R_HashSet(hashIndex(symbol, R_GlobalCache), symbol, R_GlobalCache, place,
+    R_HashSet(symbolHash(symbol), symbol, R_GlobalCache, place,
 	      FALSE);
 #ifdef FAST_BASE_CACHE_LOOKUP
     if (symbol == place)
@@ -747,8 +796,7 @@ static void R_AddGlobalCache(SEXP symbol, SEXP place)
     else
 	UNSET_BASE_SYM_CACHED(symbol);
 #endif
-    if (oldpri != HASHPRI(R_GlobalCache) &&
-	HASHPRI(R_GlobalCache) > 0.85 * HASHSIZE(R_GlobalCache)) {
+    if (R_HashSizeCheck(R_GlobalCache)) {
 	R_GlobalCache = R_HashResize(R_GlobalCache);
 	SETCAR(R_GlobalCachePreserve, R_GlobalCache);
     }
@@ -763,7 +811,7 @@ static SEXP R_GetGlobalCache(SEXP symbol)
 	return SYMBOL_BINDING_VALUE(symbol);
 #endif
 
-    vl = R_HashGet(hashIndex(symbol, R_GlobalCache), symbol,
+    vl = R_HashGet(symbolHash(symbol), symbol,
 			R_GlobalCache);
     switch(TYPEOF(vl)) {
     case SYMSXP:
@@ -794,6 +842,7 @@ static SEXP R_GetGlobalCache(SEXP symbol)
 
 static SEXP RemoveFromList(SEXP thing, SEXP list, int *found)
 {
+    R_BINDING_CHANGED(thing);
     if (list == R_NilValue) {
 	*found = 0;
 	return R_NilValue;
@@ -859,7 +908,7 @@ void attribute_hidden unbindVar(SEXP symbol, SEXP rho)
 	    SET_HASHVALUE(c, R_Newhashpjw(CHAR(c)));
 	    SET_HASHASH(c, 1);
 	}
-	hashcode = HASHVALUE(c) % HASHSIZE(HASHTAB(rho));
+	hashcode = HASHVALUE(c);
 	R_HashDelete(hashcode, symbol, HASHTAB(rho));
 	/* we have no record here if deletion worked */
 	if (rho == R_GlobalEnv) R_DirtyImage = 1;
@@ -931,7 +980,7 @@ static SEXP findVarLocInFrame(SEXP rho, SEXP symbol, Rboolean *canCache)
 	    SET_HASHVALUE(c, R_Newhashpjw(CHAR(c)));
 	    SET_HASHASH(c,  1);
 	}
-	hashcode = HASHVALUE(c) % HASHSIZE(HASHTAB(rho));
+	hashcode = HASHVALUE(c);
 	/* Will return 'R_NilValue' if not found */
 	return R_HashGetLoc(hashcode, symbol, HASHTAB(rho));
     }
@@ -1037,7 +1086,7 @@ SEXP findVarInFrame3(SEXP rho, SEXP symbol, Rboolean doGet)
 	    SET_HASHVALUE(c, R_Newhashpjw(CHAR(c)));
 	    SET_HASHASH(c, 1);
 	}
-	hashcode = HASHVALUE(c) % HASHSIZE(HASHTAB(rho));
+	hashcode = HASHVALUE(c);
 	/* Will return 'R_UnboundValue' if not found */
 	return(R_HashGet(hashcode, symbol, HASHTAB(rho)));
     }
@@ -1086,7 +1135,7 @@ static Rboolean existsVarInFrame(SEXP rho, SEXP symbol)
 	    SET_HASHVALUE(c, R_Newhashpjw(CHAR(c)));
 	    SET_HASHASH(c, 1);
 	}
-	hashcode = HASHVALUE(c) % HASHSIZE(HASHTAB(rho));
+	hashcode = HASHVALUE(c);
 	/* Will return 'R_UnboundValue' if not found */
 	return R_HashExists(hashcode, symbol, HASHTAB(rho));
     }
@@ -1523,6 +1572,7 @@ void defineVar(SEXP symbol, SEXP value, SEXP rho)
 
 	if (IS_SPECIAL_SYMBOL(symbol))
 	    UNSET_NO_SPECIAL_SYMBOLS(rho);
+	R_BINDING_CHANGED(symbol);
 
 	if (HASHTAB(rho) == R_NilValue) {
 	    /* First check for an existing binding */
@@ -1546,7 +1596,7 @@ void defineVar(SEXP symbol, SEXP value, SEXP rho)
 		SET_HASHVALUE(c, R_Newhashpjw(CHAR(c)));
 		SET_HASHASH(c, 1);
 	    }
-	    hashcode = HASHVALUE(c) % HASHSIZE(HASHTAB(rho));
+	    hashcode = HASHVALUE(c);
 	    R_HashSet(hashcode, symbol, HASHTAB(rho), value,
 		      FRAME_IS_LOCKED(rho));
 	    if (R_HashSizeCheck(HASHTAB(rho)))
@@ -1664,7 +1714,7 @@ static SEXP setVarInFrame(SEXP rho, SEXP symbol, SEXP value)
 	    SET_HASHVALUE(c, R_Newhashpjw(CHAR(c)));
 	    SET_HASHASH(c, 1);
 	}
-	hashcode = HASHVALUE(c) % HASHSIZE(HASHTAB(rho));
+	hashcode = HASHVALUE(c);
 	frame = R_HashGetLoc(hashcode, symbol, HASHTAB(rho));
 	if (frame != R_NilValue) {
 	    SET_BINDING_VALUE(frame, value);
@@ -1833,14 +1883,9 @@ static int RemoveVariable(SEXP name, int hashcode, SEXP env)
     }
 
     if (IS_HASHED(env)) {
-	SEXP hashtab = HASHTAB(env);
-	int idx = hashcode % HASHSIZE(hashtab);
-	list = RemoveFromList(name, VECTOR_ELT(hashtab, idx), &found);
+	found = R_HashDelete(hashcode, name, HASHTAB(env));
 	if (found) {
 	    if(env == R_GlobalEnv) R_DirtyImage = 1;
-	    if (list == R_NilValue)
-		SET_HASHPRI(hashtab, HASHPRI(hashtab) - 1);
-	    SET_VECTOR_ELT(hashtab, idx, list);
 #ifdef USE_GLOBAL_CACHE
 	    if (IS_GLOBAL_FRAME(env))
 		R_FlushGlobalCache(name);
@@ -2387,10 +2432,6 @@ SEXP attribute_hidden do_attach(SEXP call, SEXP op, SEXP args, SEXP env)
 	SET_HASHTAB(s, R_NewHashTable(hsize));
 	s = R_HashFrame(s);
 
-	/* FIXME: A little inefficient */
-	while (R_HashSizeCheck(HASHTAB(s)))
-	    SET_HASHTAB(s, R_HashResize(HASHTAB(s)));
-
     } else { /* is a user object */
 	/* Having this here (rather than below) means that the onAttach routine
 	   is called before the table is attached. This may not be necessary or
@@ -2416,6 +2457,7 @@ SEXP attribute_hidden do_attach(SEXP call, SEXP op, SEXP args, SEXP env)
 	SET_ENCLOS(t, s);
 	SET_ENCLOS(s, x);
     }
+    R_LOOKUP_CHANGED(); /* the search path has changed */
 
     if(!isSpecial) { /* Temporary: need to remove the elements identified by objects(CAR(args)) */
 #ifdef USE_GLOBAL_CACHE
@@ -2476,6 +2518,7 @@ SEXP attribute_hidden do_detach(SEXP call, SEXP op, SEXP args, SEXP env)
 	}
 
 	SET_ENCLOS(s, R_BaseEnv);
+	R_LOOKUP_CHANGED(); /* the search path has changed */
     }
 #ifdef USE_GLOBAL_CACHE
     if(!isSpecial) {
@@ -3258,6 +3301,9 @@ void R_MakeActiveBinding(SEXP sym, SEXP fun, SEXP env)
     if (TYPEOF(env) != ENVSXP &&
 	TYPEOF((env = simple_as_environment(env))) != ENVSXP)
 	error(_("not an environment"));
+    /* method and function lookups of this symbol can no longer be cached */
+    SET_HAD_ACTIVE_BINDING(sym);
+    R_BINDING_CHANGED(sym);
     if (env == R_BaseEnv || env == R_BaseNamespace) {
 	if (SYMVALUE(sym) != R_UnboundValue && ! IS_ACTIVE_BINDING(sym))
 	    error(_("symbol already has a regular binding"));
@@ -3415,24 +3461,38 @@ SEXP attribute_hidden do_mkUnbound(SEXP call, SEXP op, SEXP args, SEXP rho)
     if (R_BindingIsActive(sym, R_BaseEnv))
 	error(_("cannot unbind an active binding"));
     SET_SYMVALUE(sym, R_UnboundValue);
+    R_BINDING_CHANGED(sym);
 #ifdef USE_GLOBAL_CACHE
     R_FlushGlobalCache(sym);
 #endif
     return R_NilValue;
 }
 
+/* Hash tables are saved in chained form (see R_HashTableForSave), so
+   the open addressing table is rebuilt from the chains here. */
 void R_RestoreHashCount(SEXP rho)
 {
-    if (IS_HASHED(rho)) {
-	SEXP table;
+    if (IS_HASHED(rho) && TYPEOF(HASHTAB(rho)) == VECSXP) {
+	SEXP table, new_table, chain, cell;
 	int i, count, size;
 
 	table = HASHTAB(rho);
 	size = HASHSIZE(table);
 	for (i = 0, count = 0; i < size; i++)
-	    if (VECTOR_ELT(table, i) != R_NilValue)
+	    for (chain = VECTOR_ELT(table, i); chain != R_NilValue;
+		 chain = CDR(chain))
 		count++;
-	SET_HASHPRI(table, count);
+	PROTECT(new_table = R_NewHashTable((int) (count / HASHMAXLOAD) + 1));
+	for (i = 0; i < size; i++) {
+	    chain = VECTOR_ELT(table, i);
+	    while (chain != R_NilValue) {
+		cell = chain;
+		chain = CDR(chain);
+		R_HashInsertCell(cell, new_table);
+	    }
+	}
+	SET_HASHTAB(rho, new_table);
+	UNPROTECT(1);
     }
 }
 
@@ -3913,7 +3973,7 @@ SEXP mkCharLenCE(const char *name, int len, cetype_t enc)
 	   Maximum possible power of two is 2^30 for a VECSXP.
 	   FIXME: this has changed with long vectors.
 	*/
-	if (R_HashSizeCheck(R_StringHash)
+	if (HASHPRI(R_StringHash) > 0.85 * HASHSIZE(R_StringHash)
 	    && char_hash_size < 1073741824 /* 2^30 */)
 	    R_StringHash_resize(char_hash_size * 2);
 
@@ -29,6 +29,10 @@
 #include <Rinterface.h>
 #include <Fileio.h>
 #include <R_ext/Print.h>
+#include <Rversion.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>		/* for getpid */
+#endif
 
 
 static SEXP bcEval(SEXP, SEXP, Rboolean);
@@ -40,6 +44,12 @@ static SEXP bcEval(SEXP, SEXP, Rboolean);
 static Rboolean bc_profiling = FALSE;
 #endif
 
+/* Byte code execution counting is available in all builds; its time
+   sampling uses the profiling timer and so cannot be combined with
+   Rprof(). */
+static Rboolean bc_counting = FALSE;
+static Rboolean bc_count_timing = FALSE;
+
 static int R_Profiling = 0;
 
 #ifdef R_PROFILING
@@ -104,6 +114,18 @@ static char **R_Srcfiles;			   /* an array of pointers into the filename buffer
 static size_t R_Srcfile_bufcount;                  /* how big is the array above? */
 static SEXP R_Srcfiles_buffer = NULL;              /* a big RAWSXP to use as a buffer for filenames and pointers to them */
 static int R_Profiling_Error;		   /* record errors here */
+static int R_Native_Profiling = 0;		   /* also record native frames */
+static int R_Profiling_Format = 0;		   /* the output format, see below */
+static FILE *R_ProfileRecords = NULL;		   /* samples to be converted */
+static char R_ProfileRecordsBuf[BUFSIZ];	   /* its stdio buffer */
+static int R_Profiling_Interval;		   /* in microseconds */
+static double R_Profiling_Start;
+
+enum {
+    PROF_FORMAT_RPROF = 0,	/* text read by summaryRprof */
+    PROF_FORMAT_COLLAPSED = 1,	/* folded stacks for flame graphs */
+    PROF_FORMAT_PPROF = 2	/* protocol buffers read by pprof */
+};
 
 #ifdef Win32
 HANDLE MainThread;
@@ -158,19 +180,24 @@ static int getFilenum(const char* filename) {
    file is wrong. Maybe writing an overflow marker of some sort would
    be better.  LT */
 
+static const char *srcrefFilename(SEXP srcref)
+{
+    SEXP srcfile = getAttrib(srcref, R_SrcfileSymbol);
+
+    if (!srcfile || TYPEOF(srcfile) != ENVSXP) return NULL;
+    srcfile = findVar(install("filename"), srcfile);
+    if (TYPEOF(srcfile) != STRSXP || !length(srcfile)) return NULL;
+    return CHAR(STRING_ELT(srcfile, 0));
+}
+
 static void lineprof(char* buf, SEXP srcref)
 {
     size_t len;
     if (srcref && !isNull(srcref) && (len = strlen(buf)) < PROFLINEMAX) {
 	int fnum, line = asInteger(srcref);
-	SEXP srcfile = getAttrib(srcref, R_SrcfileSymbol);
-	const char *filename;
-
-	if (!srcfile || TYPEOF(srcfile) != ENVSXP) return;
-	srcfile = findVar(install("filename"), srcfile);
-	if (TYPEOF(srcfile) != STRSXP || !length(srcfile)) return;
-	filename = CHAR(STRING_ELT(srcfile, 0));
+	const char *filename = srcrefFilename(srcref);
 
+	if (!filename) return;
 	if ((fnum = getFilenum(filename)))
 	    snprintf(buf+len, PROFBUFSIZ - len, "%d#%d ", fnum, line);
     }
@@ -189,6 +216,245 @@ static pthread_t R_profiled_thread;
 # endif
 #endif
 
+/* The name shown for a function call in the profile. */
+static void profItemName(SEXP fun, char *itembuf)
+{
+    if (TYPEOF(fun) == SYMSXP) {
+	snprintf(itembuf, PROFITEMMAX-1, "%s", CHAR(PRINTNAME(fun)));
+
+    } else if ((CAR(fun) == R_DoubleColonSymbol ||
+		CAR(fun) == R_TripleColonSymbol ||
+		CAR(fun) == R_DollarSymbol) &&
+	       TYPEOF(CADR(fun)) == SYMSXP &&
+	       TYPEOF(CADDR(fun)) == SYMSXP) {
+	/* Function accessed via ::, :::, or $. Both args must be
+	   symbols. It is possible to use strings with these
+	   functions, as in "base"::"list", but that's a very rare
+	   case so we won't bother handling it. */
+	snprintf(itembuf, PROFITEMMAX-1, "%s%s%s",
+		 CHAR(PRINTNAME(CADR(fun))),
+		 CHAR(PRINTNAME(CAR(fun))),
+		 CHAR(PRINTNAME(CADDR(fun))));
+
+    } else if (CAR(fun) == R_Bracket2Symbol &&
+	       TYPEOF(CADR(fun)) == SYMSXP &&
+	       ((TYPEOF(CADDR(fun)) == SYMSXP ||
+		 TYPEOF(CADDR(fun)) == STRSXP ||
+		 TYPEOF(CADDR(fun)) == INTSXP ||
+		 TYPEOF(CADDR(fun)) == REALSXP) &&
+		length(CADDR(fun)) > 0)) {
+	/* Function accessed via [[. The first arg must be a symbol
+	   and the second can be a symbol, string, integer, or
+	   real. */
+	SEXP arg1 = CADR(fun);
+	SEXP arg2 = CADDR(fun);
+	char arg2buf[PROFITEMMAX];
+
+	if (TYPEOF(arg2) == SYMSXP) {
+	    snprintf(arg2buf, PROFITEMMAX-1, "%s", CHAR(PRINTNAME(arg2)));
+
+	} else if (TYPEOF(arg2) == STRSXP) {
+	    snprintf(arg2buf, PROFITEMMAX-1, "\"%s\"", CHAR(STRING_ELT(arg2, 0)));
+
+	} else if (TYPEOF(arg2) == INTSXP) {
+	    snprintf(arg2buf, PROFITEMMAX-1, "%d", INTEGER(arg2)[0]);
+
+	} else if (TYPEOF(arg2) == REALSXP) {
+	    snprintf(arg2buf, PROFITEMMAX-1, "%.0f", REAL(arg2)[0]);
+
+	} else {
+	    /* Shouldn't get here, but just in case. */
+	    arg2buf[0] = '\0';
+	}
+
+	snprintf(itembuf, PROFITEMMAX-1, "%s[[%s]]",
+		 CHAR(PRINTNAME(arg1)),
+		 arg2buf);
+
+    } else {
+	sprintf(itembuf, "<Anonymous>");
+    }
+}
+
+/* Native stack capture.  The frames of C code running below the
+   innermost context are recorded by unwinding the C stack from the
+   signal handler with the unwinder used for C++ exceptions; only the
+   return addresses are collected there.  Names are looked up with
+   dladdr, so they come from the dynamic symbol tables: addresses in
+   functions not exported from their shared object are shown as an
+   offset in that object, which can be resolved with addr2line. */
+
+#if !defined(Win32) && defined(__GNUC__) && defined(HAVE_DLADDR) && \
+    defined(HAVE_DLFCN_H)
+# define HAVE_NATIVE_PROFILING
+# include <unwind.h>
+# include <dlfcn.h>
+# ifdef __GLIBC__
+#  include <link.h>
+# endif
+#endif
+
+#define PROFNATIVEMAX 64
+
+#ifdef HAVE_NATIVE_PROFILING
+typedef struct {
+    uintptr_t ip[PROFNATIVEMAX];
+    uintptr_t limit;
+    int n;
+    Rboolean started;
+} nativestack_t;
+
+static _Unwind_Reason_Code nativeFrame(struct _Unwind_Context *ctx,
+				       void *data)
+{
+    nativestack_t *ns = data;
+    int before_insn = 0;
+    uintptr_t ip = _Unwind_GetIPInfo(ctx, &before_insn);
+
+    if (!ns->started) {
+	/* Skip the frames of the handler: the interrupted frame is the
+	   first one unwound through the signal trampoline. */
+	if (!before_insn) return _URC_NO_REASON;
+	ns->started = TRUE;
+    }
+    else ip--; /* a return address; point into the call instruction */
+    if (ip + 1 <= 1 || (ns->limit && _Unwind_GetCFA(ctx) > ns->limit))
+	return _URC_END_OF_STACK;
+    ns->ip[ns->n++] = ip;
+    return ns->n < PROFNATIVEMAX ? _URC_NO_REASON : _URC_END_OF_STACK;
+}
+
+/* Collect the native frames innermost first, up to the frame which
+   established the innermost context. */
+static int getNativeStack(nativestack_t *ns)
+{
+    uintptr_t cptr = (uintptr_t) R_GlobalContext;
+
+    ns->n = 0;
+    ns->started = FALSE;
+    ns->limit = 0;
+    if (R_CStackDir == 1 && R_CStackStart != (uintptr_t) -1 &&
+	cptr < R_CStackStart && R_CStackStart - cptr < R_CStackLimit)
+	ns->limit = cptr;
+    _Unwind_Backtrace(nativeFrame, ns);
+    return ns->n;
+}
+
+/* Write the name of the function containing 'ip' to 'buf'; returns
+   FALSE if 'ip' is not within an exported function, in which case the
+   name is the offset in the object it lies in.  That object and its
+   load address are returned in 'module' and 'base' when found. */
+static Rboolean nativeFrameName(uintptr_t ip, char *buf, size_t size,
+				const char **module, uintptr_t *base)
+{
+    Dl_info info;
+    Rboolean insym;
+# ifdef __GLIBC__
+    const ElfW(Sym) *sym = NULL;
+
+    *module = NULL;
+    if (!dladdr1((void *) ip, &info, (void **) &sym, RTLD_DL_SYMENT)) {
+	snprintf(buf, size, "0x%lx", (unsigned long) ip);
+	return FALSE;
+    }
+    insym = info.dli_sname && sym &&
+	ip - (uintptr_t) info.dli_saddr < sym->st_size;
+# else
+    *module = NULL;
+    if (!dladdr((void *) ip, &info)) {
+	snprintf(buf, size, "0x%lx", (unsigned long) ip);
+	return FALSE;
+    }
+    insym = info.dli_sname != NULL;
+# endif
+    *module = info.dli_fname;
+    *base = (uintptr_t) info.dli_fbase;
+    if (insym)
+	snprintf(buf, size, "%s", info.dli_sname);
+    else {
+	const char *p = info.dli_fname ? strrchr(info.dli_fname, '/') : NULL;
+	snprintf(buf, size, "%s+0x%lx",
+		 p ? p + 1 : (info.dli_fname ? info.dli_fname : "?"),
+		 (unsigned long) (ip - *base));
+    }
+    return insym;
+}
+#endif /* HAVE_NATIVE_PROFILING */
+
+/* Samples for the "collapsed" and "pprof" formats, and with native
+   frames, are written to a temporary file as they are taken, one line
+   per sample, and converted when profiling ends: looking up the names
+   of native frames in the handler could deadlock.  A line holds tab-separated items,
+   innermost first: the memory use ("-" when not recorded), then "G"
+   while GC is running, "N" and the hex address of each native frame,
+   and "R" and the name of each R function, followed by the file name
+   and line number, separated by \037, when line profiling. */
+
+static void profRecordSrcref(char *buf, SEXP srcref)
+{
+    size_t len;
+    if (srcref && !isNull(srcref) && (len = strlen(buf)) < PROFLINEMAX) {
+	const char *filename = srcrefFilename(srcref);
+	if (filename)
+	    snprintf(buf + len, PROFBUFSIZ - len, "\037%s\037%d",
+		     filename, asInteger(srcref));
+    }
+}
+
+static void profRecord(void)
+{
+    RCNTXT *cptr;
+    char buf[PROFBUFSIZ], itembuf[PROFITEMMAX];
+    size_t bigv, smallv, nodes;
+    size_t len;
+    SEXP srcref;
+
+    if (R_Mem_Profiling) {
+	get_current_mem(&smallv, &bigv, &nodes);
+	snprintf(buf, PROFBUFSIZ, "%lu:%lu:%lu:%lu",
+		 (unsigned long) smallv, (unsigned long) bigv,
+		 (unsigned long) nodes, get_duplicate_counter());
+	reset_duplicate_counter();
+    }
+    else strcpy(buf, "-");
+
+    if (R_GC_Profiling && R_gc_running())
+	strcat(buf, "\tG");
+
+#ifdef HAVE_NATIVE_PROFILING
+    if (R_Native_Profiling) {
+	nativestack_t ns;
+	int n = getNativeStack(&ns);
+	for (int i = 0; i < n; i++)
+	    if ((len = strlen(buf)) < PROFLINEMAX)
+		snprintf(buf + len, PROFBUFSIZ - len, "\tN%lx",
+			 (unsigned long) ns.ip[i]);
+    }
+#endif
+
+    /* A function is attributed the line it is executing: the current
+       one for the innermost, the call site of the next inner call for
+       the others. */
+    srcref = R_Line_Profiling ? R_getCurrentSrcref() : NULL;
+    for (cptr = R_GlobalContext; cptr; cptr = cptr->nextcontext) {
+	if ((cptr->callflag & (CTXT_FUNCTION | CTXT_BUILTIN))
+	    && TYPEOF(cptr->call) == LANGSXP) {
+	    if ((len = strlen(buf)) >= PROFLINEMAX) break;
+	    profItemName(CAR(cptr->call), itembuf);
+	    for (char *p = itembuf; *p; p++)
+		if (*p == '\t' || *p == '\n' || *p == '\037') *p = ' ';
+	    snprintf(buf + len, PROFBUFSIZ - len, "\tR%s", itembuf);
+	    if (R_Line_Profiling) {
+		if (cptr->callflag & CTXT_FUNCTION)
+		    profRecordSrcref(buf, srcref);
+		srcref = (cptr->srcref == R_InBCInterpreter) ?
+		    R_findBCInterpreterSrcref(cptr) : cptr->srcref;
+	    }
+	}
+    }
+    fprintf(R_ProfileRecords, "%s\n", buf);
+}
+
 static void doprof(int sig)  /* sig is ignored in Windows */
 {
     RCNTXT *cptr;
@@ -208,6 +474,16 @@ static void doprof(int sig)  /* sig is ignored in Windows */
     }
 #endif /* Win32 */
 
+    if (R_ProfileRecords) {
+	profRecord();
+#ifdef Win32
+	ResumeThread(MainThread);
+#else
+	signal(SIGPROF, doprof);
+#endif
+	return;
+    }
+
     if (R_Mem_Profiling){
 	    get_current_mem(&smallv, &bigv, &nodes);
 	    if((len = strlen(buf)) < PROFLINEMAX)
@@ -233,62 +509,7 @@ static void doprof(int sig)  /* sig is ignored in Windows */
 
 		char itembuf[PROFITEMMAX];
 
-		if (TYPEOF(fun) == SYMSXP) {
-		    snprintf(itembuf, PROFITEMMAX-1, "%s", CHAR(PRINTNAME(fun)));
-
-		} else if ((CAR(fun) == R_DoubleColonSymbol ||
-			    CAR(fun) == R_TripleColonSymbol ||
-			    CAR(fun) == R_DollarSymbol) &&
-			   TYPEOF(CADR(fun)) == SYMSXP &&
-			   TYPEOF(CADDR(fun)) == SYMSXP) {
-		    /* Function accessed via ::, :::, or $. Both args must be
-		       symbols. It is possible to use strings with these
-		       functions, as in "base"::"list", but that's a very rare
-		       case so we won't bother handling it. */
-		    snprintf(itembuf, PROFITEMMAX-1, "%s%s%s",
-			     CHAR(PRINTNAME(CADR(fun))),
-			     CHAR(PRINTNAME(CAR(fun))),
-			     CHAR(PRINTNAME(CADDR(fun))));
-
-		} else if (CAR(fun) == R_Bracket2Symbol &&
-			   TYPEOF(CADR(fun)) == SYMSXP &&
-			   ((TYPEOF(CADDR(fun)) == SYMSXP ||
-			     TYPEOF(CADDR(fun)) == STRSXP ||
-			     TYPEOF(CADDR(fun)) == INTSXP ||
-			     TYPEOF(CADDR(fun)) == REALSXP) &&
-			    length(CADDR(fun)) > 0)) {
-		    /* Function accessed via [[. The first arg must be a symbol
-		       and the second can be a symbol, string, integer, or
-		       real. */
-		    SEXP arg1 = CADR(fun);
-		    SEXP arg2 = CADDR(fun);
-		    char arg2buf[PROFITEMMAX];
-
-		    if (TYPEOF(arg2) == SYMSXP) {
-			snprintf(arg2buf, PROFITEMMAX-1, "%s", CHAR(PRINTNAME(arg2)));
-
-		    } else if (TYPEOF(arg2) == STRSXP) {
-			snprintf(arg2buf, PROFITEMMAX-1, "\"%s\"", CHAR(STRING_ELT(arg2, 0)));
-
-		    } else if (TYPEOF(arg2) == INTSXP) {
-			snprintf(arg2buf, PROFITEMMAX-1, "%d", INTEGER(arg2)[0]);
-
-		    } else if (TYPEOF(arg2) == REALSXP) {
-			snprintf(arg2buf, PROFITEMMAX-1, "%.0f", REAL(arg2)[0]);
-
-		    } else {
-			/* Shouldn't get here, but just in case. */
-			arg2buf[0] = '\0';
-		    }
-
-		    snprintf(itembuf, PROFITEMMAX-1, "%s[[%s]]",
-			     CHAR(PRINTNAME(arg1)),
-			     arg2buf);
-
-		} else {
-		    sprintf(itembuf, "<Anonymous>");
-		}
-
+		profItemName(fun, itembuf);
 		strcat(buf, itembuf);
 		strcat(buf, "\" ");
 		if (R_Line_Profiling) {
@@ -339,6 +560,467 @@ static void doprof_null(int sig)
 #endif /* not Win32 */
 
 
+/* Conversion of the recorded samples.  This runs when profiling
+   ends, outside the signal handler, so it may allocate; R_alloc'ed
+   memory is released when the call to Rprof returns. */
+
+static void *profGrow(void *p, int n, int *max, size_t eltsize)
+{
+    if (n < *max) return p;
+    *max = 2 * *max + 256;
+    void *q = R_alloc(*max, eltsize);
+    if (n) memcpy(q, p, n * eltsize);
+    return q;
+}
+
+typedef struct {
+    char **keys;	/* by id */
+    int *slots;		/* ids, or -1 */
+    int n, nslots;
+} profhash_t;
+
+static void profHashInit(profhash_t *h)
+{
+    h->n = 0;
+    h->nslots = 1024;
+    h->keys = (char **) R_alloc(h->nslots / 2, sizeof(char *));
+    h->slots = (int *) R_alloc(h->nslots, sizeof(int));
+    for (int i = 0; i < h->nslots; i++) h->slots[i] = -1;
+}
+
+static unsigned int profHashString(const char *s)
+{
+    unsigned int h = 5381;
+    while (*s) h = h * 33 + (unsigned char) *s++;
+    return h;
+}
+
+/* Returns the id of 'key', adding it if it is new; ids are given out
+   in order from 0. */
+static int profIntern(profhash_t *h, const char *key)
+{
+    int i = profHashString(key) & (h->nslots - 1);
+    while (h->slots[i] >= 0) {
+	if (!strcmp(h->keys[h->slots[i]], key)) return h->slots[i];
+	i = (i + 1) & (h->nslots - 1);
+    }
+    if (2 * (h->n + 1) > h->nslots) {
+	int nslots = 2 * h->nslots;
+	char **keys = (char **) R_alloc(nslots / 2, sizeof(char *));
+	memcpy(keys, h->keys, h->n * sizeof(char *));
+	h->keys = keys;
+	h->nslots = nslots;
+	h->slots = (int *) R_alloc(nslots, sizeof(int));
+	for (i = 0; i < nslots; i++) h->slots[i] = -1;
+	for (int id = 0; id < h->n; id++) {
+	    i = profHashString(h->keys[id]) & (nslots - 1);
+	    while (h->slots[i] >= 0) i = (i + 1) & (nslots - 1);
+	    h->slots[i] = id;
+	}
+	return profIntern(h, key);
+    }
+    h->keys[h->n] = strcpy(R_alloc(strlen(key) + 1, 1), key);
+    h->slots[i] = h->n;
+    return h->n++;
+}
+
+/* Native addresses, resolved once each */
+typedef struct {
+    profhash_t addrs;
+    char **names;
+    const char **modules;
+    uintptr_t *ips, *bases;
+    Rboolean *insym;
+    int max;
+} profnative_t;
+
+static void profNativeInit(profnative_t *nt)
+{
+    profHashInit(&nt->addrs);
+    nt->max = 0;
+    nt->names = NULL;
+    nt->modules = NULL;
+    nt->ips = nt->bases = NULL;
+    nt->insym = NULL;
+}
+
+static int profNative(profnative_t *nt, const char *addr)
+{
+    int n = nt->addrs.n, id = profIntern(&nt->addrs, addr);
+    if (id == n) {
+	int max = nt->max;
+	nt->names = profGrow(nt->names, n, &max, sizeof(char *));
+	max = nt->max;
+	nt->modules = profGrow(nt->modules, n, &max, sizeof(char *));
+	max = nt->max;
+	nt->ips = profGrow(nt->ips, n, &max, sizeof(uintptr_t));
+	max = nt->max;
+	nt->bases = profGrow(nt->bases, n, &max, sizeof(uintptr_t));
+	nt->insym = profGrow(nt->insym, n, &nt->max, sizeof(Rboolean));
+
+	char buf[PROFITEMMAX];
+	nt->ips[id] = (uintptr_t) strtoul(addr, NULL, 16);
+	nt->bases[id] = 0;
+#ifdef HAVE_NATIVE_PROFILING
+	nt->insym[id] = nativeFrameName(nt->ips[id], buf, PROFITEMMAX,
+					nt->modules + id, nt->bases + id);
+#else
+	snprintf(buf, PROFITEMMAX, "0x%s", addr);
+	nt->modules[id] = NULL;
+	nt->insym[id] = FALSE;
+#endif
+	nt->names[id] = strcpy(R_alloc(strlen(buf) + 1, 1), buf);
+    }
+    return id;
+}
+
+typedef struct {
+    char kind;		/* 'G', 'N' or 'R' */
+    char *name;		/* the hex address for 'N' */
+    char *file;
+    int line;
+} profframe_t;
+
+#define PROFFRAMEMAX (PROFBUFSIZ / 2)
+
+/* Split a sample line in place; returns the number of frames. */
+static int profParseSample(char *line, char **mem, profframe_t *frames)
+{
+    int n = 0;
+    char *item, *next;
+
+    line[strcspn(line, "\n")] = '\0';
+    if ((next = strchr(line, '\t'))) *next++ = '\0';
+    *mem = strcmp(line, "-") ? line : NULL;
+    for (item = next; item && n < PROFFRAMEMAX; item = next) {
+	profframe_t *f = frames + n++;
+	char *sep;
+
+	if ((next = strchr(item, '\t'))) *next++ = '\0';
+	f->kind = item[0];
+	f->name = item + 1;
+	f->file = NULL;
+	f->line = 0;
+	if ((sep = strchr(f->name, '\037'))) {
+	    *sep++ = '\0';
+	    f->file = sep;
+	    if ((sep = strrchr(sep, '\037'))) {
+		*sep++ = '\0';
+		f->line = atoi(sep);
+	    }
+	}
+    }
+    return n;
+}
+
+static int profCompareStrings(const void *a, const void *b)
+{
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/* The folded format used by flame graph tools: the frames of each
+   distinct stack, outermost first and separated by semicolons,
+   followed by the number of samples. */
+static void profWriteCollapsed(FILE *in, FILE *out)
+{
+    char line[PROFBUFSIZ + 2], item[PROFBUFSIZ], *mem;
+    profframe_t *frames =
+	(profframe_t *) R_alloc(PROFFRAMEMAX, sizeof(profframe_t));
+    char **stacks = NULL;
+    int nstacks = 0, maxstacks = 0;
+    profnative_t native;
+
+    profNativeInit(&native);
+    while (fgets(line, sizeof(line), in)) {
+	int n = profParseSample(line, &mem, frames);
+	size_t len = 0, size = 1;
+
+	if (n == 0) continue;
+	for (int i = 0; i < n; i++)
+	    size += strlen(frames[i].name) + PROFITEMMAX +
+		(frames[i].file ? strlen(frames[i].file) : 0);
+	char *stack = R_alloc(size, 1);
+	for (int i = n - 1; i >= 0; i--) {
+	    profframe_t *f = frames + i;
+	    if (f->kind == 'G')
+		strcpy(item, "<GC>");
+	    else if (f->kind == 'N') {
+		int id = profNative(&native, f->name);
+		strcpy(item, native.names[id]);
+	    }
+	    else if (f->file)
+		snprintf(item, PROFBUFSIZ, "%s (%s:%d)",
+			 f->name, f->file, f->line);
+	    else
+		strcpy(item, f->name);
+	    /* semicolons separate the frames */
+	    for (char *p = item; *p && len < size - 2; p++)
+		stack[len++] = (*p == ';') ? ':' : *p;
+	    if (i > 0) stack[len++] = ';';
+	}
+	stack[len] = '\0';
+	stacks = profGrow(stacks, nstacks, &maxstacks, sizeof(char *));
+	stacks[nstacks++] = stack;
+    }
+
+    qsort(stacks, nstacks, sizeof(char *), profCompareStrings);
+    for (int i = 0, j; i < nstacks; i = j) {
+	for (j = i + 1; j < nstacks && !strcmp(stacks[i], stacks[j]); j++);
+	fprintf(out, "%s %d\n", stacks[i], j - i);
+    }
+}
+
+/* The usual format, as written by doprof */
+static void profWriteRprof(FILE *in, FILE *out)
+{
+    char line[PROFBUFSIZ + 2], buf[2 * PROFBUFSIZ], *mem;
+    profframe_t *frames =
+	(profframe_t *) R_alloc(PROFFRAMEMAX, sizeof(profframe_t));
+    profhash_t files;
+    profnative_t native;
+
+    profHashInit(&files);
+    profNativeInit(&native);
+    while (fgets(line, sizeof(line), in)) {
+	int n = profParseSample(line, &mem, frames);
+	size_t len = 0;
+
+	buf[0] = '\0';
+	if (mem)
+	    len += snprintf(buf, sizeof(buf), ":%s:", mem);
+	for (int i = 0; i < n && len < PROFBUFSIZ; i++) {
+	    profframe_t *f = frames + i;
+	    const char *name = f->name;
+	    if (f->kind == 'G')
+		name = "<GC>";
+	    else if (f->kind == 'N') {
+		int id = profNative(&native, f->name);
+		name = native.names[id];
+	    }
+	    else if (f->file) {
+		/* Files are listed before the first sample using them */
+		int nf = files.n, fnum = profIntern(&files, f->file) + 1;
+		if (fnum > nf)
+		    fprintf(out, "#File %d: %s\n", fnum, f->file);
+		len += snprintf(buf + len, sizeof(buf) - len, "%d#%d ",
+				fnum, f->line);
+	    }
+	    len += snprintf(buf + len, sizeof(buf) - len, "\"%s\" ", name);
+	}
+	if (len)
+	    fprintf(out, "%s\n", buf);
+    }
+}
+
+/* Protocol buffer encoding, for the pprof format */
+
+typedef struct {
+    unsigned char *data;
+    size_t len, size;
+} pbuf_t;
+
+static void pbReserve(pbuf_t *b, size_t n)
+{
+    if (b->len + n > b->size) {
+	size_t size = 2 * b->size + n + 256;
+	unsigned char *data = (unsigned char *) R_alloc(size, 1);
+	if (b->len) memcpy(data, b->data, b->len);
+	b->data = data;
+	b->size = size;
+    }
+}
+
+static void pbVarint(pbuf_t *b, uint64_t v)
+{
+    pbReserve(b, 10);
+    while (v >= 0x80) {
+	b->data[b->len++] = (unsigned char) (v | 0x80);
+	v >>= 7;
+    }
+    b->data[b->len++] = (unsigned char) v;
+}
+
+/* A varint field; zero is the default and is not written. */
+static void pbField(pbuf_t *b, int field, uint64_t v)
+{
+    if (v) {
+	pbVarint(b, (uint64_t) field << 3);
+	pbVarint(b, v);
+    }
+}
+
+/* A length-delimited field: a string, a message or a packed array. */
+static void pbBytes(pbuf_t *b, int field, const void *data, size_t n)
+{
+    pbVarint(b, ((uint64_t) field << 3) | 2);
+    pbVarint(b, n);
+    pbReserve(b, n);
+    if (n) memcpy(b->data + b->len, data, n);
+    b->len += n;
+}
+
+static void pbValueType(pbuf_t *b, int field, profhash_t *strings,
+			const char *type, const char *unit)
+{
+    pbuf_t m = {NULL, 0, 0};
+    pbField(&m, 1, profIntern(strings, type));
+    pbField(&m, 2, profIntern(strings, unit));
+    pbBytes(b, field, m.data, m.len);
+}
+
+/* The profile.proto format read by pprof.  Each sample has the
+   number of samples and the CPU time as values and, with memory
+   profiling, the memory use as numeric labels.  R functions have
+   their source files and the locations their lines; native frames
+   outside exported functions are left unsymbolized, with the
+   mapping of their object so pprof can resolve them. */
+static void profWritePprof(FILE *in, FILE *out, int interval)
+{
+    static const char *memlabels[] = {
+	"small_vcells", "large_vcells", "node_bytes", "duplications"
+    };
+    char line[PROFBUFSIZ + 2], key[PROFBUFSIZ + 64], *mem;
+    profframe_t *frames =
+	(profframe_t *) R_alloc(PROFFRAMEMAX, sizeof(profframe_t));
+    profhash_t strings, functions, locations, mappings;
+    profnative_t native;
+    int *fname = NULL, *ffile = NULL, maxf = 0, maxf2 = 0;
+    int *lfun = NULL, *lline = NULL, *lmap = NULL,
+	maxl = 0, maxl2 = 0, maxl3 = 0, maxl4 = 0;
+    uintptr_t *laddr = NULL, *mstart = NULL, *mlimit = NULL;
+    int maxm = 0, maxm2 = 0;
+    pbuf_t prof = {NULL, 0, 0}, msg = {NULL, 0, 0}, sub = {NULL, 0, 0},
+	ids = {NULL, 0, 0};
+    uint64_t period = (uint64_t) interval * 1000;
+
+    profHashInit(&strings);
+    profHashInit(&functions);
+    profHashInit(&locations);
+    profHashInit(&mappings);
+    profNativeInit(&native);
+    profIntern(&strings, "");
+
+    pbValueType(&prof, 1, &strings, "samples", "count");
+    pbValueType(&prof, 1, &strings, "cpu", "nanoseconds");
+
+    while (fgets(line, sizeof(line), in)) {
+	int n = profParseSample(line, &mem, frames);
+
+	if (n == 0) continue;
+	ids.len = 0;
+	for (int i = 0; i < n; i++) {
+	    profframe_t *f = frames + i;
+	    const char *name = f->name, *file = "";
+	    int lid, nl = locations.n, fid = -1, mid = -1;
+	    uintptr_t addr = 0;
+
+	    if (f->kind == 'G')
+		name = "<GC>";
+	    else if (f->kind == 'N') {
+		int id = profNative(&native, f->name);
+		name = native.names[id];
+		file = native.modules[id] ? native.modules[id] : "";
+		if (!native.insym[id] && native.modules[id]) {
+		    int nm = mappings.n;
+		    mid = profIntern(&mappings, file);
+		    if (mid == nm) {
+			mstart = profGrow(mstart, mid, &maxm, sizeof(uintptr_t));
+			mlimit = profGrow(mlimit, mid, &maxm2, sizeof(uintptr_t));
+			mstart[mid] = native.bases[id];
+			mlimit[mid] = native.bases[id] + 1;
+		    }
+		    addr = native.ips[id];
+		    if (addr >= mlimit[mid]) mlimit[mid] = addr + 1;
+		}
+	    }
+	    else if (f->file)
+		file = f->file;
+
+	    if (mid >= 0)
+		snprintf(key, sizeof(key), "@%lx", (unsigned long) addr);
+	    else {
+		snprintf(key, sizeof(key), "%c%s\037%s", f->kind, name, file);
+		int nf = functions.n;
+		fid = profIntern(&functions, key);
+		if (fid == nf) {
+		    fname = profGrow(fname, fid, &maxf, sizeof(int));
+		    ffile = profGrow(ffile, fid, &maxf2, sizeof(int));
+		    fname[fid] = profIntern(&strings, name);
+		    ffile[fid] = profIntern(&strings, file);
+		}
+		snprintf(key, sizeof(key), "%d:%d", fid, f->line);
+	    }
+	    lid = profIntern(&locations, key);
+	    if (lid == nl) {
+		lfun = profGrow(lfun, lid, &maxl, sizeof(int));
+		lline = profGrow(lline, lid, &maxl2, sizeof(int));
+		lmap = profGrow(lmap, lid, &maxl3, sizeof(int));
+		laddr = profGrow(laddr, lid, &maxl4, sizeof(uintptr_t));
+		lfun[lid] = fid;
+		lline[lid] = f->line;
+		lmap[lid] = mid;
+		laddr[lid] = addr;
+	    }
+	    pbVarint(&ids, lid + 1);
+	}
+	msg.len = 0;
+	pbBytes(&msg, 1, ids.data, ids.len);
+	sub.len = 0;
+	pbVarint(&sub, 1);
+	pbVarint(&sub, period);
+	pbBytes(&msg, 2, sub.data, sub.len);
+	if (mem) {
+	    for (int i = 0; i < 4; i++) {
+		sub.len = 0;
+		pbField(&sub, 1, profIntern(&strings, memlabels[i]));
+		pbField(&sub, 3, strtoull(mem, &mem, 10));
+		if (*mem == ':') mem++;
+		pbBytes(&msg, 3, sub.data, sub.len);
+	    }
+	}
+	pbBytes(&prof, 2, msg.data, msg.len);
+    }
+
+    for (int i = 0; i < mappings.n; i++) {
+	msg.len = 0;
+	pbField(&msg, 1, i + 1);
+	pbField(&msg, 2, mstart[i]);
+	pbField(&msg, 3, mlimit[i]);
+	pbField(&msg, 5, profIntern(&strings, mappings.keys[i]));
+	pbBytes(&prof, 3, msg.data, msg.len);
+    }
+    for (int i = 0; i < locations.n; i++) {
+	msg.len = 0;
+	pbField(&msg, 1, i + 1);
+	if (lmap[i] >= 0) {
+	    pbField(&msg, 2, lmap[i] + 1);
+	    pbField(&msg, 3, laddr[i]);
+	}
+	else {
+	    sub.len = 0;
+	    pbField(&sub, 1, lfun[i] + 1);
+	    pbField(&sub, 2, lline[i]);
+	    pbBytes(&msg, 4, sub.data, sub.len);
+	}
+	pbBytes(&prof, 4, msg.data, msg.len);
+    }
+    for (int i = 0; i < functions.n; i++) {
+	msg.len = 0;
+	pbField(&msg, 1, i + 1);
+	pbField(&msg, 2, fname[i]);
+	pbField(&msg, 3, fname[i]);
+	pbField(&msg, 4, ffile[i]);
+	pbBytes(&prof, 5, msg.data, msg.len);
+    }
+    pbField(&prof, 9, (uint64_t) (R_Profiling_Start * 1e9));
+    pbValueType(&prof, 11, &strings, "cpu", "nanoseconds");
+    pbField(&prof, 12, period);
+    for (int i = 0; i < strings.n; i++)
+	pbBytes(&prof, 6, strings.keys[i], strlen(strings.keys[i]));
+
+    fwrite(prof.data, 1, prof.len, out);
+}
+
 static void R_EndProfiling(void)
 {
 #ifdef Win32
@@ -355,6 +1037,21 @@ static void R_EndProfiling(void)
     signal(SIGPROF, doprof_null);
 
 #endif /* not Win32 */
+    if (R_ProfileRecords) {
+	FILE *records = R_ProfileRecords;
+	R_ProfileRecords = NULL;
+	if (R_ProfileOutfile) {
+	    rewind(records);
+	    if (R_Profiling_Format == PROF_FORMAT_PPROF)
+		profWritePprof(records, R_ProfileOutfile,
+			       R_Profiling_Interval);
+	    else if (R_Profiling_Format == PROF_FORMAT_COLLAPSED)
+		profWriteCollapsed(records, R_ProfileOutfile);
+	    else
+		profWriteRprof(records, R_ProfileOutfile);
+	}
+	fclose(records);
+    }
     if(R_ProfileOutfile) fclose(R_ProfileOutfile);
     R_ProfileOutfile = NULL;
     R_Profiling = 0;
@@ -369,7 +1066,8 @@ static void R_EndProfiling(void)
 
 static void R_InitProfiling(SEXP filename, int append, double dinterval,
 			    int mem_profiling, int gc_profiling,
-			    int line_profiling, int numfiles, int bufsize)
+			    int line_profiling, int numfiles, int bufsize,
+			    int native, int format)
 {
 #ifndef Win32
     struct itimerval itv;
@@ -381,17 +1079,50 @@ static void R_InitProfiling(SEXP filename, int append, double dinterval,
 
     interval = (int)(1e6 * dinterval + 0.5);
     if(R_ProfileOutfile != NULL) R_EndProfiling();
-    R_ProfileOutfile = RC_fopen(filename, append ? "a" : "w", TRUE);
+    if (append && format == PROF_FORMAT_PPROF)
+	error(_("Rprof: cannot append to a profile in pprof format"));
+#ifndef HAVE_NATIVE_PROFILING
+    if (native)
+	warning(_("Rprof: native stack capture is not available on this system"));
+    native = 0;
+#endif
+    R_ProfileOutfile = RC_fopen(filename, append ? "a" :
+				(format == PROF_FORMAT_PPROF ? "wb" : "w"),
+				TRUE);
     if (R_ProfileOutfile == NULL)
 	error(_("Rprof: cannot open profile file '%s'"),
 	      translateChar(filename));
-    if(mem_profiling)
-	fprintf(R_ProfileOutfile, "memory profiling: ");
-    if(gc_profiling)
-	fprintf(R_ProfileOutfile, "GC profiling: ");
-    if(line_profiling)
-	fprintf(R_ProfileOutfile, "line profiling: ");
-    fprintf(R_ProfileOutfile, "sample.interval=%d\n", interval);
+    if ((format != PROF_FORMAT_RPROF || native) &&
+	(R_ProfileRecords = tmpfile()) == NULL) {
+	fclose(R_ProfileOutfile);
+	R_ProfileOutfile = NULL;
+	error(_("Rprof: cannot open a temporary file"));
+    }
+    /* Nothing the signal handler does may allocate, as it could
+       interrupt malloc: give the records a buffer of their own, and
+       unwind once here as the first unwind initializes the unwinder. */
+    if (R_ProfileRecords)
+	setvbuf(R_ProfileRecords, R_ProfileRecordsBuf, _IOFBF,
+		sizeof R_ProfileRecordsBuf);
+#ifdef HAVE_NATIVE_PROFILING
+    if (native) {
+	nativestack_t ns;
+	getNativeStack(&ns);
+    }
+#endif
+    if (format == PROF_FORMAT_RPROF) {
+	if(mem_profiling)
+	    fprintf(R_ProfileOutfile, "memory profiling: ");
+	if(gc_profiling)
+	    fprintf(R_ProfileOutfile, "GC profiling: ");
+	if(line_profiling)
+	    fprintf(R_ProfileOutfile, "line profiling: ");
+	fprintf(R_ProfileOutfile, "sample.interval=%d\n", interval);
+    }
+    R_Native_Profiling = native;
+    R_Profiling_Format = format;
+    R_Profiling_Interval = interval;
+    R_Profiling_Start = currentTime();
 
     R_Mem_Profiling=mem_profiling;
     if (mem_profiling)
@@ -443,7 +1174,7 @@ SEXP do_Rprof(SEXP args)
     SEXP filename;
     int append_mode, mem_profiling, gc_profiling, line_profiling;
     double dinterval;
-    int numfiles, bufsize;
+    int numfiles, bufsize, native, format;
 
 #ifdef BC_PROFILING
     if (bc_profiling) {
@@ -451,6 +1182,10 @@ SEXP do_Rprof(SEXP args)
 	return R_NilValue;
     }
 #endif
+    if (bc_count_timing) {
+	warning("cannot use R profiling while timing byte code execution");
+	return R_NilValue;
+    }
     if (!isString(filename = CAR(args)) || (LENGTH(filename)) != 1)
 	error(_("invalid '%s' argument"), "filename");
 					      args = CDR(args);
@@ -462,14 +1197,19 @@ SEXP do_Rprof(SEXP args)
     numfiles = asInteger(CAR(args));	      args = CDR(args);
     if (numfiles < 0)
 	error(_("invalid '%s' argument"), "numfiles");
-    bufsize = asInteger(CAR(args));
+    bufsize = asInteger(CAR(args));	      args = CDR(args);
     if (bufsize < 0)
 	error(_("invalid '%s' argument"), "bufsize");
+    native = asLogical(CAR(args));	      args = CDR(args);
+    format = asInteger(CAR(args));
+    if (format < PROF_FORMAT_RPROF || format > PROF_FORMAT_PPROF)
+	error(_("invalid '%s' argument"), "format");
 
     filename = STRING_ELT(filename, 0);
     if (LENGTH(filename))
 	R_InitProfiling(filename, append_mode, dinterval, mem_profiling,
-			gc_profiling, line_profiling, numfiles, bufsize);
+			gc_profiling, line_profiling, numfiles, bufsize,
+			native == TRUE, format);
     else
 	R_EndProfiling();
     return R_NilValue;
@@ -532,6 +1272,106 @@ static SEXP forcePromise(SEXP e)
     return PRVALUE(e);
 }
 
+#ifdef SWITCH_TO_REFCNT
+/* Releasing References on Closure Exit.  The frame of a closure's
+   environment keeps the references to the argument values alive after
+   the call returns, so that with reference counting alone a value
+   passed to a closure would have to be copied on its next
+   modification.  If the environment is not referenced from anywhere
+   once the closure has returned, other than by promises, closures and
+   the environment itself in its frame, its bindings are cleared.
+   Promises referenced only by the frame, or only by the argument list
+   of the call, also drop their values and environments.
+
+   This is only safe if every holder of a reference to the environment
+   counts it.  The setters in memory.c (SETCAR, SET_VECTOR_ELT,
+   SET_ATTRIB and those for environments, closures, promises and
+   external pointers) do, as do CONS, mkPROMISE, NewEnvironment and
+   R_MakeExternalPtr for its tag and protected value; weak references
+   and the precious list are built with these.  Holders that do not
+   count are lists made by CONS_NR, the byte code node stack, the
+   protect stack and contexts.  These belong to calls still active, and
+   a callee's environment is only cleaned up when its own call returns;
+   the argument list of that call is handled by unpromiseArgs.  C code
+   that stores a closure environment by writing a field directly with
+   the USE_RINTERNALS macros bypasses counting and is not supported. */
+
+static R_INLINE int countCycleRefs(SEXP rho, SEXP val)
+{
+    int crefs = 0;
+    for (SEXP b = FRAME(rho); b != R_NilValue && REFCNT(b) == 1; b = CDR(b)) {
+	SEXP v = CAR(b);
+	if (v == val)
+	    continue;
+	switch (TYPEOF(v)) {
+	case PROMSXP:
+	    if (REFCNT(v) == 1 && PRENV(v) == rho) crefs++;
+	    break;
+	case CLOSXP:
+	    if (REFCNT(v) == 1 && CLOENV(v) == rho) crefs++;
+	    break;
+	case ENVSXP:
+	    if (v == rho) crefs++;
+	    break;
+	default:
+	    break;
+	}
+    }
+    return crefs;
+}
+
+static R_INLINE void cleanupPromise(SEXP v)
+{
+    if (TYPEOF(v) == PROMSXP && TRACKREFS(v)) {
+	SET_PRVALUE(v, R_UnboundValue);
+	SET_PRENV(v, R_NilValue);
+    }
+}
+
+static void R_CleanupEnvir(SEXP rho, SEXP val)
+{
+    int refcnt;
+
+    if (val == rho || HASHTAB(rho) != R_NilValue)
+	return;
+    refcnt = REFCNT(rho);
+    if (refcnt == REFCNTMAX || refcnt != countCycleRefs(rho, val))
+	return;
+
+    for (SEXP b = FRAME(rho); b != R_NilValue && REFCNT(b) == 1; b = CDR(b)) {
+	SEXP v = CAR(b);
+	if (v != val && REFCNT(v) == 1) {
+	    if (TYPEOF(v) == DOTSXP) {
+		for (SEXP d = v; d != R_NilValue && REFCNT(d) == 1; d = CDR(d)) {
+		    if (REFCNT(CAR(d)) == 1)
+			cleanupPromise(CAR(d));
+		    SETCAR(d, R_NilValue);
+		}
+	    }
+	    else
+		cleanupPromise(v);
+	}
+	SETCAR(b, R_NilValue);
+    }
+    SET_ENCLOS(rho, R_EmptyEnv);
+}
+
+/* Drop the values of the promises in the argument list of a closure
+   call that are no longer referenced from anywhere else.  Lists built
+   by CONS_NR do not count their references. */
+static void unpromiseArgs(SEXP pargs)
+{
+    for (; pargs != R_NilValue; pargs = CDR(pargs)) {
+	SEXP v = CAR(pargs);
+	if (TYPEOF(v) == PROMSXP && REFCNT(v) == (TRACKREFS(pargs) ? 1 : 0))
+	    cleanupPromise(v);
+    }
+}
+#else
+# define R_CleanupEnvir(rho, val) do {} while (0)
+# define unpromiseArgs(pargs) do {} while (0)
+#endif
+
 /* Return value of "e" evaluated in "rho". */
 
 /* some places, e.g. deparse2buff, call this with a promise and rho = NULL */
@@ -743,8 +1583,9 @@ SEXP eval(SEXP e, SEXP rho)
 	    vmaxset(vmax);
 	}
 	else if (TYPEOF(op) == CLOSXP) {
-	    PROTECT(tmp = promiseArgs(CDR(e), rho));
-	    tmp = applyClosure(e, op, tmp, rho, R_NilValue);
+	    SEXP pargs = PROTECT(promiseArgs(CDR(e), rho));
+	    tmp = applyClosure(e, op, pargs, rho, R_NilValue);
+	    unpromiseArgs(pargs);
 	    UNPROTECT(1);
 	}
 	else
@@ -910,10 +1751,13 @@ static SEXP R_IfSymbol = NULL;
 static SEXP R_ForSymbol = NULL;
 static SEXP R_WhileSymbol = NULL;
 static SEXP R_RepeatSymbol = NULL;
+static SEXP R_ReturnSymbol = NULL;
 
 #define JIT_CACHE_SIZE 1024
 static SEXP JIT_cache = NULL;
 static R_exprhash_t JIT_cache_hashes[JIT_CACHE_SIZE];
+static char *JIT_disk_dir = NULL; /* persistent cache, see R_cmpfun_disk */
+static int R_bcVersion; /* defined with the byte code machinery below */
 
 /**** allow MIN_JIT_SCORE, or both, to be changed by environment variables? */
 static int MIN_JIT_SCORE = 50;
@@ -979,8 +1823,13 @@ void attribute_hidden R_init_jit_enabled(void)
     R_ForSymbol = install("for");
     R_WhileSymbol = install("while");
     R_RepeatSymbol = install("repeat");
+    R_ReturnSymbol = install("return");
 
     R_PreserveObject(JIT_cache = allocVector(VECSXP, JIT_CACHE_SIZE));
+
+    char *dir = getenv("R_JIT_CACHE_DIR");
+    if (dir != NULL && dir[0] != '\0' && R_FileExists(R_ExpandFileName(dir)))
+	JIT_disk_dir = strdup(R_ExpandFileName(dir));
 }
 
 static int JIT_score(SEXP e)
@@ -1011,7 +1860,8 @@ static int JIT_score(SEXP e)
 #define STRATEGY_ALL_SMALL_MAYBE 2
 #define STRATEGY_NO_SCORE 3
 #define STRATEGY_NO_CACHE 4
-/* max strategy index is hardcoded in R_CheckJIT */
+#define STRATEGY_HOT 5
+/* max strategy index is hardcoded in R_initJITStrategy */
 
 /*
   NO_CACHE
@@ -1033,35 +1883,83 @@ static int JIT_score(SEXP e)
           2nd time seen if top-level, never otherwise
       functions with high score compiled
           1st time seen if top-level, 2nd time seen otherwise
+
+  HOT [DEFAULT]
+      functions compiled once called JIT_CALL_THRESHOLD times, or once
+          their loops have run JIT_LOOP_THRESHOLD iterations in total;
+	  a while or repeat loop crossing the loop threshold is compiled
+	  and continued in byte code, and so is the remainder of a for
+	  loop over a vector
 */
 
 static int jit_strategy = -1;
 
-static R_INLINE Rboolean R_CheckJIT(SEXP fun)
+/* Hotness counters of closures run by the AST interpreter, in a
+   direct-mapped table keyed by the address of the body. Counts of
+   bodies evicted by a collision are lost, and the body of an entry
+   is not protected: a new body allocated at the same address
+   inherits the counts, which at worst compiles it a little early. */
+static int JIT_CALL_THRESHOLD = 2;
+static int JIT_LOOP_THRESHOLD = 100;
+#define JIT_HOT_SIZE 1024
+static struct {
+    SEXP body;
+    int calls;
+    int backedges;
+} JIT_hot[JIT_HOT_SIZE];
+
+static R_INLINE int JIT_hot_index(SEXP body)
+{
+    uintptr_t h = ((uintptr_t) body) >> 3;
+    int i = (int) ((h ^ (h >> 10)) & (JIT_HOT_SIZE - 1));
+    if (JIT_hot[i].body != body) {
+	JIT_hot[i].body = body;
+	JIT_hot[i].calls = 0;
+	JIT_hot[i].backedges = 0;
+    }
+    return i;
+}
+
+static void R_initJITStrategy(void)
 {
     /* to help with testing */
-    if (jit_strategy < 0) {
-	int dflt = R_jit_enabled == 1 ?
-	    STRATEGY_NO_SMALL : STRATEGY_TOP_SMALL_MAYBE;
-	int val = dflt;
-	char *valstr = getenv("R_JIT_STRATEGY");
-	if (valstr != NULL)
-	    val = atoi(valstr);
-	if (val < 0 || val > 4)
-	    jit_strategy = dflt;
-	else
-	    jit_strategy = val;
+    int dflt = STRATEGY_HOT;
+    int val = dflt;
+    char *valstr = getenv("R_JIT_STRATEGY");
+    if (valstr != NULL)
+	val = atoi(valstr);
+    if (val < 0 || val > 5)
+	jit_strategy = dflt;
+    else
+	jit_strategy = val;
 
-	valstr = getenv("R_MIN_JIT_SCORE");
-	if (valstr != NULL)
-	    MIN_JIT_SCORE = atoi(valstr);
-    }
+    valstr = getenv("R_MIN_JIT_SCORE");
+    if (valstr != NULL)
+	MIN_JIT_SCORE = atoi(valstr);
+    valstr = getenv("R_JIT_CALL_THRESHOLD");
+    if (valstr != NULL && atoi(valstr) > 0)
+	JIT_CALL_THRESHOLD = atoi(valstr);
+    valstr = getenv("R_JIT_LOOP_THRESHOLD");
+    if (valstr != NULL && atoi(valstr) > 0)
+	JIT_LOOP_THRESHOLD = atoi(valstr);
+}
+
+static R_INLINE Rboolean R_CheckJIT(SEXP fun)
+{
+    if (jit_strategy < 0)
+	R_initJITStrategy();
 
     SEXP body = BODY(fun);
 
     if (R_jit_enabled > 0 && TYPEOF(body) != BCODESXP &&
 	! R_disable_bytecode && ! NOJIT(fun)) {
 
+	if (jit_strategy == STRATEGY_HOT) {
+	    int i = JIT_hot_index(body);
+	    return ++JIT_hot[i].calls >= JIT_CALL_THRESHOLD ||
+		JIT_hot[i].backedges >= JIT_LOOP_THRESHOLD;
+	}
+
 	if (MAYBEJIT(fun)) {
 	    /* function marked as MAYBEJIT the first time now seen
 	       twice, so go ahead and compile */
@@ -1308,6 +2206,322 @@ SEXP attribute_hidden R_cmpfun1(SEXP fun)
     return val;
 }
 
+/* Persistent JIT cache. If the environment variable R_JIT_CACHE_DIR
+   names a directory, code compiled by the JIT for closures and top
+   level loops is saved there and later processes load it instead of
+   compiling again. Files are named by a hash of the expression that,
+   unlike hashexpr, does not depend on addresses, mixed with the R and
+   byte code versions and the optimization level. An entry records
+   these together with the expression, the top level environment and
+   the local variables the compiler saw, and is only used if they all
+   match; as for the in-memory cache, the local variables may be a
+   superset of the current ones. Code with source references is not
+   cached since these refer to the source file of the session. */
+
+#define JIT_DISK_KEY 0
+#define JIT_DISK_EXPR 1
+#define JIT_DISK_TOP 2
+#define JIT_DISK_LOCALS 3
+#define JIT_DISK_CODE 4
+#define JIT_DISK_LENGTH 5
+
+static R_exprhash_t hashexpr_stable(SEXP e, R_exprhash_t h, Rboolean *ok)
+{
+    int type = TYPEOF(e);
+    h = hash((unsigned char *) &type, sizeof(type), h);
+    switch (type) {
+    case NILSXP:
+	return h;
+    case SYMSXP:
+	return hash((unsigned char *) CHAR(PRINTNAME(e)),
+		    LENGTH(PRINTNAME(e)), h);
+    case LANGSXP:
+    case LISTSXP:
+	for (; e != R_NilValue && *ok; e = CDR(e))
+	    h = hashexpr_stable(CAR(e), h, ok);
+	return h;
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case RAWSXP:
+	return hash((unsigned char *) DATAPTR(e),
+		    XLENGTH(e) * (type == REALSXP ? sizeof(double) :
+				  type == CPLXSXP ? sizeof(Rcomplex) :
+				  type == RAWSXP ? 1 : sizeof(int)), h);
+    case STRSXP:
+	for (R_xlen_t i = 0; i < XLENGTH(e); i++) {
+	    SEXP c = STRING_ELT(e, i);
+	    h = hash((unsigned char *) CHAR(c), LENGTH(c), h);
+	}
+	return h;
+    default:
+	/* closures, environments, and the like do not persist */
+	*ok = FALSE;
+	return h;
+    }
+}
+
+static SEXP jit_disk_key(void)
+{
+    int old_visible = R_Visible;
+    char buf[128];
+    SEXP fcall, call, opt;
+
+    PROTECT(fcall = lang3(R_TripleColonSymbol, install("compiler"),
+			  install("getCompilerOption")));
+    PROTECT(call = lang2(fcall, mkString("optimize")));
+    opt = eval(call, R_GlobalEnv);
+    snprintf(buf, sizeof(buf), "R %s.%s r%d bc%d opt%d", R_MAJOR, R_MINOR,
+	     R_SVN_REVISION, R_bcVersion, asInteger(opt));
+    UNPROTECT(2);
+    R_Visible = old_visible;
+    return mkString(buf);
+}
+
+static SEXP jit_disk_top(SEXP top)
+{
+    if (top == R_GlobalEnv)
+	return mkString("");
+    else if (R_IsNamespaceEnv(top)) {
+	SEXP spec = R_NamespaceEnvSpec(top);
+	if (TYPEOF(spec) == STRSXP && LENGTH(spec) >= 2) {
+	    char buf[512];
+	    snprintf(buf, sizeof(buf), "%s %s",
+		     CHAR(STRING_ELT(spec, 0)), CHAR(STRING_ELT(spec, 1)));
+	    return mkString(buf);
+	}
+    }
+    return R_NilValue;
+}
+
+static int jit_disk_add_frame(SEXP frame, SEXP names, int n)
+{
+    for (; frame != R_NilValue; frame = CDR(frame)) {
+	if (names != R_NilValue)
+	    SET_STRING_ELT(names, n, PRINTNAME(TAG(frame)));
+	n++;
+    }
+    return n;
+}
+
+/* The names of the local variables the compiler sees for a closure,
+   as in make_cached_cmpenv, or NULL if they cannot be determined. */
+static SEXP jit_disk_locals(SEXP fun, SEXP top)
+{
+    SEXP names = R_NilValue;
+    for (int pass = 0; pass < 2; pass++) {
+	int n = jit_disk_add_frame(FORMALS(fun), names, 0);
+	for (SEXP env = CLOENV(fun); env != top; env = ENCLOS(env)) {
+	    if (IS_STANDARD_UNHASHED_FRAME(env))
+		n = jit_disk_add_frame(FRAME(env), names, n);
+	    else if (IS_STANDARD_HASHED_FRAME(env)) {
+		SEXP h = HASHTAB(env);
+		for (int i = 0; i < length(h); i++)
+		    n = jit_disk_add_frame(VECTOR_ELT(h, i), names, n);
+	    }
+	    else {
+		if (pass)
+		    UNPROTECT(1); /* names */
+		return R_NilValue;
+	    }
+	}
+	if (pass == 0)
+	    PROTECT(names = allocVector(STRSXP, n));
+    }
+    UNPROTECT(1); /* names */
+    return names;
+}
+
+/* Whether a symbol in 'e' that has a base binding is also bound in an
+   environment between 'top' and base.  The compiler inlines base
+   functions only when they are not shadowed, so code compiled with or
+   without such a binding must not be reused in a session where this
+   differs; such functions are not cached. */
+static Rboolean jit_disk_shadowed(SEXP e, SEXP top)
+{
+    switch (TYPEOF(e)) {
+    case SYMSXP:
+	if (e != R_MissingArg && SYMVALUE(e) != R_UnboundValue)
+	    for (SEXP env = top;
+		 env != R_EmptyEnv && env != R_BaseEnv &&
+		     env != R_BaseNamespace;
+		 env = ENCLOS(env))
+		if (findVarInFrame3(env, e, FALSE) != R_UnboundValue)
+		    return TRUE;
+	return FALSE;
+    case LANGSXP:
+    case LISTSXP:
+	for (; e != R_NilValue; e = CDR(e))
+	    if (jit_disk_shadowed(CAR(e), top))
+		return TRUE;
+	return FALSE;
+    default:
+	return FALSE;
+    }
+}
+
+static Rboolean jit_disk_locals_match(SEXP cached, SEXP current)
+{
+    int nc = LENGTH(cached);
+    for (int i = 0; i < LENGTH(current); i++) {
+	SEXP name = STRING_ELT(current, i);
+	int j;
+	for (j = 0; j < nc; j++)
+	    if (STRING_ELT(cached, j) == name)
+		break;
+	if (j == nc)
+	    return FALSE;
+    }
+    return TRUE;
+}
+
+static void jit_disk_path(char *buf, size_t size, SEXP expr, SEXP key,
+			  Rboolean *ok)
+{
+    R_exprhash_t h = hashexpr_stable(expr, 5381, ok);
+    h = hashexpr_stable(key, h, ok);
+    snprintf(buf, size, "%s/%016lx.Rjc", JIT_disk_dir, (unsigned long) h);
+}
+
+typedef struct {
+    const char *path;
+    FILE *fp;
+    SEXP val;
+} jit_disk_io_t;
+
+static SEXP jit_disk_read_body(void *data)
+{
+    jit_disk_io_t *io = data;
+    struct R_inpstream_st in;
+    R_InitFileInPStream(&in, io->fp, R_pstream_any_format, NULL, R_NilValue);
+    return R_Unserialize(&in);
+}
+
+static SEXP jit_disk_write_body(void *data)
+{
+    jit_disk_io_t *io = data;
+    struct R_outpstream_st out;
+    R_InitFileOutPStream(&out, io->fp, R_pstream_xdr_format, 0,
+			 NULL, R_NilValue);
+    R_Serialize(io->val, &out);
+    return R_TrueValue;
+}
+
+static SEXP jit_disk_error(SEXP cond, void *data)
+{
+    return R_NilValue;
+}
+
+static void jit_disk_close(void *data)
+{
+    jit_disk_io_t *io = data;
+    fclose(io->fp);
+}
+
+static SEXP jit_disk_read(const char *path)
+{
+    jit_disk_io_t io = { path, R_fopen(path, "rb"), R_NilValue };
+    if (io.fp == NULL)
+	return R_NilValue;
+    SEXP val = R_tryCatch(jit_disk_read_body, &io,
+			  PROTECT(mkString("error")), jit_disk_error, NULL,
+			  jit_disk_close, &io);
+    UNPROTECT(1);
+    if (TYPEOF(val) != VECSXP || LENGTH(val) != JIT_DISK_LENGTH)
+	return R_NilValue;
+    return val;
+}
+
+/* The entry is written to a temporary file and renamed so concurrent
+   processes never see partial entries. */
+static void jit_disk_write(const char *path, SEXP val)
+{
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int) getpid());
+    jit_disk_io_t io = { tmp, R_fopen(tmp, "wb"), val };
+    if (io.fp == NULL)
+	return;
+    SEXP ok = R_tryCatch(jit_disk_write_body, &io,
+			 PROTECT(mkString("error")), jit_disk_error, NULL,
+			 jit_disk_close, &io);
+    UNPROTECT(1);
+    if (ok != R_TrueValue || rename(tmp, path) != 0)
+	remove(tmp);
+}
+
+static SEXP jit_disk_entry(SEXP key, SEXP expr, SEXP top, SEXP locals,
+			   SEXP code)
+{
+    SEXP val = allocVector(VECSXP, JIT_DISK_LENGTH);
+    SET_VECTOR_ELT(val, JIT_DISK_KEY, key);
+    SET_VECTOR_ELT(val, JIT_DISK_EXPR, expr);
+    SET_VECTOR_ELT(val, JIT_DISK_TOP, top);
+    SET_VECTOR_ELT(val, JIT_DISK_LOCALS, locals);
+    SET_VECTOR_ELT(val, JIT_DISK_CODE, code);
+    return val;
+}
+
+static Rboolean jit_disk_entry_match(SEXP entry, SEXP key, SEXP expr,
+				     SEXP top, SEXP locals)
+{
+    return TYPEOF(VECTOR_ELT(entry, JIT_DISK_CODE)) == BCODESXP &&
+	R_BCVersionOK(VECTOR_ELT(entry, JIT_DISK_CODE)) &&
+	R_compute_identical(VECTOR_ELT(entry, JIT_DISK_KEY), key, 16) &&
+	R_compute_identical(VECTOR_ELT(entry, JIT_DISK_TOP), top, 16) &&
+	TYPEOF(VECTOR_ELT(entry, JIT_DISK_LOCALS)) == STRSXP &&
+	jit_disk_locals_match(VECTOR_ELT(entry, JIT_DISK_LOCALS), locals) &&
+	R_compute_identical(VECTOR_ELT(entry, JIT_DISK_EXPR), expr, 16);
+}
+
+/* Returns the compiled closure for 'fun' from the disk cache, or
+   compiles 'fun' and saves the result. */
+static SEXP R_cmpfun_disk(SEXP fun)
+{
+    SEXP body = BODY(fun);
+    SEXP top = topenv(R_NilValue, CLOENV(fun));
+    SEXP key, topname, locals, entry, val;
+    Rboolean ok = TRUE;
+    char path[PATH_MAX];
+
+    if (getAttrib(fun, R_SrcrefSymbol) != R_NilValue ||
+	getAttrib(body, R_SrcrefSymbol) != R_NilValue ||
+	jit_disk_shadowed(body, top))
+	return R_cmpfun1(fun);
+    PROTECT(topname = jit_disk_top(top));
+    PROTECT(locals = jit_disk_locals(fun, top));
+    if (topname == R_NilValue || locals == R_NilValue) {
+	UNPROTECT(2);
+	return R_cmpfun1(fun);
+    }
+    PROTECT(key = jit_disk_key());
+    jit_disk_path(path, sizeof(path), body, key, &ok);
+    if (! ok) {
+	UNPROTECT(3);
+	return R_cmpfun1(fun);
+    }
+
+    PROTECT(entry = jit_disk_read(path));
+    if (entry != R_NilValue &&
+	jit_disk_entry_match(entry, key, body, topname, locals)) {
+	val = mkCLOSXP(FORMALS(fun), VECTOR_ELT(entry, JIT_DISK_CODE),
+		       CLOENV(fun));
+	DUPLICATE_ATTRIB(val, fun);
+	UNPROTECT(4);
+	return val;
+    }
+
+    PROTECT(val = R_cmpfun1(fun));
+    if (TYPEOF(BODY(val)) == BCODESXP) {
+	entry = jit_disk_entry(key, body, topname, locals, BODY(val));
+	PROTECT(entry);
+	jit_disk_write(path, entry);
+	UNPROTECT(1); /* entry */
+    }
+    UNPROTECT(5);
+    return val;
+}
+
 SEXP attribute_hidden R_cmpfun(SEXP fun)
 {
     R_exprhash_t hash = 0;
@@ -1356,7 +2570,7 @@ SEXP attribute_hidden R_cmpfun(SEXP fun)
 	PRINT_JIT_INFO;
     }
 
-    SEXP val = R_cmpfun1(fun);
+    SEXP val = JIT_disk_dir != NULL ? R_cmpfun_disk(fun) : R_cmpfun1(fun);
 
     if (TYPEOF(BODY(val)) != BCODESXP)
 	SET_NOJIT(fun);
@@ -1386,24 +2600,189 @@ static SEXP R_compileExpr(SEXP expr, SEXP rho)
     return val;
 }
 
+/* Compiles a top level loop using the disk cache. */
+static SEXP R_compileExpr_disk(SEXP expr, SEXP rho)
+{
+    SEXP key, topname, entry, code;
+    Rboolean ok = TRUE;
+    char path[PATH_MAX];
+
+    if (rho != R_GlobalEnv || R_getCurrentSrcref() != R_NilValue ||
+	jit_disk_shadowed(expr, rho))
+	return R_compileExpr(expr, rho);
+    PROTECT(topname = mkString(""));
+    PROTECT(key = jit_disk_key());
+    jit_disk_path(path, sizeof(path), expr, key, &ok);
+    if (! ok) {
+	UNPROTECT(2);
+	return R_compileExpr(expr, rho);
+    }
+
+    PROTECT(entry = jit_disk_read(path));
+    if (entry != R_NilValue &&
+	jit_disk_entry_match(entry, key, expr, topname, R_NilValue)) {
+	code = VECTOR_ELT(entry, JIT_DISK_CODE);
+	UNPROTECT(3);
+	return code;
+    }
+
+    PROTECT(code = R_compileExpr(expr, rho));
+    if (TYPEOF(code) == BCODESXP) {
+	entry = jit_disk_entry(key, expr, topname,
+			       allocVector(STRSXP, 0), code);
+	PROTECT(entry);
+	jit_disk_write(path, entry);
+	UNPROTECT(1); /* entry */
+    }
+    UNPROTECT(4);
+    return code;
+}
+
 static Rboolean R_compileAndExecute(SEXP call, SEXP rho)
 {
     int old_enabled = R_jit_enabled;
     SEXP code;
     Rboolean ans = FALSE;
 
-    R_jit_enabled = 0;
-    PROTECT(call);
-    PROTECT(rho);
-    PROTECT(code = R_compileExpr(call, rho));
-    R_jit_enabled = old_enabled;
+    R_jit_enabled = 0;
+    PROTECT(call);
+    PROTECT(rho);
+    PROTECT(code = JIT_disk_dir != NULL ? R_compileExpr_disk(call, rho) :
+	    R_compileExpr(call, rho));
+    R_jit_enabled = old_enabled;
+
+    if (TYPEOF(code) == BCODESXP) {
+	bcEval(code, rho, TRUE);
+	ans = TRUE;
+    }
+
+    UNPROTECT(3);
+    return ans;
+}
+
+/* Returns the closure whose frame is 'rho' if a loop evaluated in
+   'rho' by the AST interpreter should count towards the closure's
+   hotness, and R_NilValue otherwise. Must be called before the
+   loop's context is established. */
+static SEXP R_jitLoopClosure(SEXP rho)
+{
+    if (jit_strategy < 0)
+	R_initJITStrategy();
+    if (jit_strategy != STRATEGY_HOT || R_jit_enabled <= 0 ||
+	R_disable_bytecode || RDEBUG(rho))
+	return R_NilValue;
+
+    RCNTXT *cptr = R_GlobalContext;
+    while (cptr->callflag == CTXT_LOOP && cptr->cloenv == rho)
+	cptr = cptr->nextcontext;
+    if ((cptr->callflag & CTXT_FUNCTION) && cptr->cloenv == rho &&
+	TYPEOF(cptr->callfun) == CLOSXP && ! NOJIT(cptr->callfun) &&
+	TYPEOF(BODY(cptr->callfun)) != BCODESXP)
+	return cptr->callfun;
+    else
+	return R_NilValue;
+}
+
+/* Counts a loop back-edge of closure 'fun'; returns TRUE when this
+   makes the closure hot. */
+static R_INLINE Rboolean R_jitBackedge(SEXP fun)
+{
+    int i = JIT_hot_index(BODY(fun));
+    return ++JIT_hot[i].backedges == JIT_LOOP_THRESHOLD;
+}
+
+static Rboolean JIT_hasReturn(SEXP e)
+{
+    if (TYPEOF(e) == LANGSXP) {
+	if (CAR(e) == R_ReturnSymbol)
+	    return TRUE;
+	for (; e != R_NilValue; e = CDR(e))
+	    if (JIT_hasReturn(CAR(e)))
+		return TRUE;
+    }
+    return FALSE;
+}
+
+/* Compiles the loop 'call' and runs it in 'rho', continuing a loop
+   that became hot in the AST interpreter. Loop code compiled on its
+   own would treat return() as leaving the loop, so loops containing
+   return() are left to the interpreter. */
+static Rboolean R_jitContinueLoop(SEXP call, SEXP rho)
+{
+    if (! isUnmodifiedSpecSym(CAR(call), rho) || JIT_hasReturn(call))
+	return FALSE;
+    return R_compileAndExecute(call, rho);
+}
+
+/* Continues a hot for() loop over 'val' from element 'i' on by
+   running a compiled loop over the remaining elements. */
+static Rboolean R_jitContinueFor(SEXP call, SEXP sym, SEXP val, R_xlen_t i,
+				 SEXP body, SEXP rho)
+{
+    R_xlen_t n = XLENGTH(val);
+    SEXP rest, loop;
+    Rboolean ans;
 
-    if (TYPEOF(code) == BCODESXP) {
-	bcEval(code, rho, TRUE);
-	ans = TRUE;
+    switch (TYPEOF(val)) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case STRSXP:
+    case RAWSXP:
+    case VECSXP:
+	break;
+    default:
+	return FALSE;
     }
+    if (i >= n || ! isUnmodifiedSpecSym(CAR(call), rho) ||
+	JIT_hasReturn(body))
+	return FALSE;
+#ifdef LONG_VECTOR_SUPPORT
+    /* compiled for() loops only handle short sequences */
+    if (n - i > R_SHORT_LEN_MAX)
+	return FALSE;
+#endif
 
-    UNPROTECT(3);
+    /* continue with the rest of a compact sequence without expanding
+       it, and leave other representations without data in memory to
+       the AST interpreter */
+    if (ALTREP(val) && (rest = R_compact_seq_tail(val, i)) != R_NilValue)
+	PROTECT(rest);
+    else if (ALTREP(val) && DATAPTR_OR_NULL(val) == NULL)
+	return FALSE;
+    else {
+	PROTECT(rest = allocVector(TYPEOF(val), n - i));
+	switch (TYPEOF(val)) {
+	case STRSXP:
+	    for (R_xlen_t j = i; j < n; j++)
+		SET_STRING_ELT(rest, j - i, STRING_ELT(val, j));
+	    break;
+	case VECSXP:
+	    for (R_xlen_t j = i; j < n; j++)
+		SET_VECTOR_ELT(rest, j - i, VECTOR_ELT(val, j));
+	    break;
+	case LGLSXP:
+	    memcpy(LOGICAL(rest), LOGICAL(val) + i, (n - i) * sizeof(int));
+	    break;
+	case INTSXP:
+	    memcpy(INTEGER(rest), INTEGER(val) + i, (n - i) * sizeof(int));
+	    break;
+	case REALSXP:
+	    memcpy(REAL(rest), REAL(val) + i, (n - i) * sizeof(double));
+	    break;
+	case CPLXSXP:
+	    memcpy(COMPLEX(rest), COMPLEX(val) + i,
+		   (n - i) * sizeof(Rcomplex));
+	    break;
+	case RAWSXP:
+	    memcpy(RAW(rest), RAW(val) + i, (n - i) * sizeof(Rbyte));
+	    break;
+	}
+    }
+    PROTECT(loop = lang4(CAR(call), sym, rest, body));
+    ans = R_compileAndExecute(loop, rho);
+    UNPROTECT(2);
     return ans;
 }
 
@@ -1505,9 +2884,14 @@ SEXP applyClosure(SEXP call, SEXP op, SEXP arglist, SEXP rho, SEXP suppliedvars)
     PROTECT(newrho = NewEnvironment(formals, actuals, savedrho));
 
     /* Turn on reference counting for the binding cells so local
-       assignments arguments increment REFCNT values */
-    for (a = actuals; a != R_NilValue; a = CDR(a))
+       assignments arguments increment REFCNT values.  The cells were
+       created by CONS_NR, so the references they already hold are
+       counted now. */
+    for (a = actuals; a != R_NilValue; a = CDR(a)) {
 	ENABLE_REFCNT(a);
+	INCREMENT_REFCNT(CAR(a));
+	INCREMENT_REFCNT(CDR(a));
+    }
 
     /*  Use the default code for unbound formals.  FIXME: It looks like
 	this code should preceed the building of the environment so that
@@ -1620,9 +3004,36 @@ static R_INLINE SEXP R_execClosure(SEXP call, SEXP newrho, SEXP sysparent,
 	Rprintf("exiting from: ");
 	PrintCall(call, rho);
     }
+
+    R_CleanupEnvir(newrho, cntxt.returnValue);
+
     return cntxt.returnValue;
 }
 
+/* Call builtin 'op' with the evaluated arguments 'args' */
+SEXP attribute_hidden R_applyBuiltin(SEXP call, SEXP op, SEXP args, SEXP rho)
+{
+    SEXP val;
+    int flag = PRIMPRINT(op);
+    if (flag < 2) R_Visible = flag != 1;
+    /* We used to insert a context only if profiling,
+       but helps for tracebacks on .C etc. */
+    if (R_Profiling || (PPINFO(op).kind == PP_FOREIGN)) {
+	RCNTXT cntxt;
+	SEXP oldref = R_Srcref;
+	begincontext(&cntxt, CTXT_BUILTIN, call,
+		     R_BaseEnv, R_BaseEnv, R_NilValue, R_NilValue);
+	R_Srcref = NULL;
+	val = PRIMFUN(op) (call, op, args, rho);
+	R_Srcref = oldref;
+	endcontext(&cntxt);
+    } else {
+	val = PRIMFUN(op) (call, op, args, rho);
+    }
+    if (flag < 2) R_Visible = flag != 1;
+    return val;
+}
+
 SEXP R_forceAndCall(SEXP e, int n, SEXP rho)
 {
     SEXP fun, tmp;
@@ -1641,24 +3052,8 @@ SEXP R_forceAndCall(SEXP e, int n, SEXP rho)
 	UNPROTECT(1);
     }
     else if (TYPEOF(fun) == BUILTINSXP) {
-	int flag = PRIMPRINT(fun);
 	PROTECT(tmp = evalList(CDR(e), rho, e, 0));
-	if (flag < 2) R_Visible = flag != 1;
-	/* We used to insert a context only if profiling,
-	   but helps for tracebacks on .C etc. */
-	if (R_Profiling || (PPINFO(fun).kind == PP_FOREIGN)) {
-	    RCNTXT cntxt;
-	    SEXP oldref = R_Srcref;
-	    begincontext(&cntxt, CTXT_BUILTIN, e,
-			 R_BaseEnv, R_BaseEnv, R_NilValue, R_NilValue);
-	    R_Srcref = NULL;
-	    tmp = PRIMFUN(fun) (e, fun, tmp, rho);
-	    R_Srcref = oldref;
-	    endcontext(&cntxt);
-	} else {
-	    tmp = PRIMFUN(fun) (e, fun, tmp, rho);
-	}
-	if (flag < 2) R_Visible = flag != 1;
+	tmp = R_applyBuiltin(e, fun, tmp, rho);
 	UNPROTECT(1);
     }
     else if (TYPEOF(fun) == CLOSXP) {
@@ -1943,6 +3338,7 @@ static R_INLINE Rboolean SET_BINDING_VALUE(SEXP loc, SEXP value) {
     if (loc != R_NilValue &&
 	! BINDING_IS_LOCKED(loc) && ! IS_ACTIVE_BINDING(loc)) {
 	if (CAR(loc) != value) {
+	    R_BINDING_CHANGED(TAG(loc));
 	    SETCAR(loc, value);
 	    if (MISSING(loc))
 		SET_MISSING(loc, 0);
@@ -1961,7 +3357,7 @@ SEXP attribute_hidden do_for(SEXP call, SEXP op, SEXP args, SEXP rho)
        include n and bgn, but gcc -O2 -Wclobbered warns about these so
        to be safe we declare them volatile as well. */
     volatile int i = 0, n, bgn;
-    volatile SEXP v, val, cell;
+    volatile SEXP v, val, cell, jitfun;
     int dbg, val_type;
     SEXP sym, body;
     RCNTXT cntxt;
@@ -2011,6 +3407,8 @@ SEXP attribute_hidden do_for(SEXP call, SEXP op, SEXP args, SEXP rho)
 
     PROTECT_WITH_INDEX(v = R_NilValue, &vpi);
 
+    jitfun = val_type == LISTSXP ? R_NilValue : R_jitLoopClosure(rho);
+
     begincontext(&cntxt, CTXT_LOOP, R_NilValue, rho, R_BaseEnv, R_NilValue,
 		 R_NilValue);
     switch (SETJMP(cntxt.cjmpbuf)) {
@@ -2046,11 +3444,11 @@ SEXP attribute_hidden do_for(SEXP call, SEXP op, SEXP args, SEXP rho)
 		break;
 	    case INTSXP:
 		ALLOC_LOOP_VAR(v, val_type, vpi);
-		INTEGER(v)[0] = INTEGER(val)[i];
+		INTEGER(v)[0] = INTEGER_ELT(val, i);
 		break;
 	    case REALSXP:
 		ALLOC_LOOP_VAR(v, val_type, vpi);
-		REAL(v)[0] = REAL(val)[i];
+		REAL(v)[0] = REAL_ELT(val, i);
 		break;
 	    case CPLXSXP:
 		ALLOC_LOOP_VAR(v, val_type, vpi);
@@ -2078,7 +3476,9 @@ SEXP attribute_hidden do_for(SEXP call, SEXP op, SEXP args, SEXP rho)
 	eval(body, rho);
 
     for_next:
-	; /* needed for strict ISO C compliance, according to gcc 2.95.2 */
+	if (jitfun != R_NilValue && R_jitBackedge(jitfun) &&
+	    R_jitContinueFor(call, sym, val, i + 1, body, rho))
+	    break;
     }
  for_break:
     endcontext(&cntxt);
@@ -2093,7 +3493,7 @@ SEXP attribute_hidden do_while(SEXP call, SEXP op, SEXP args, SEXP rho)
 {
     int dbg;
     volatile int bgn;
-    volatile SEXP body;
+    volatile SEXP body, jitfun;
     RCNTXT cntxt;
 
     checkArity(op, args);
@@ -2107,6 +3507,7 @@ SEXP attribute_hidden do_while(SEXP call, SEXP op, SEXP args, SEXP rho)
 
     body = CADR(args);
     bgn = BodyHasBraces(body);
+    jitfun = R_jitLoopClosure(rho);
 
     begincontext(&cntxt, CTXT_LOOP, R_NilValue, rho, R_BaseEnv, R_NilValue,
 		 R_NilValue);
@@ -2124,6 +3525,9 @@ SEXP attribute_hidden do_while(SEXP call, SEXP op, SEXP args, SEXP rho)
 		PrintValue(CAR(args));
 		do_browser(call, op, R_NilValue, rho);
 	    }
+	    if (jitfun != R_NilValue && R_jitBackedge(jitfun) &&
+		R_jitContinueLoop(call, rho))
+		break;
 	}
     }
     endcontext(&cntxt);
@@ -2135,7 +3539,7 @@ SEXP attribute_hidden do_while(SEXP call, SEXP op, SEXP args, SEXP rho)
 SEXP attribute_hidden do_repeat(SEXP call, SEXP op, SEXP args, SEXP rho)
 {
     int dbg;
-    volatile SEXP body;
+    volatile SEXP body, jitfun;
     RCNTXT cntxt;
 
     checkArity(op, args);
@@ -2148,12 +3552,16 @@ SEXP attribute_hidden do_repeat(SEXP call, SEXP op, SEXP args, SEXP rho)
 	return R_NilValue;
 
     body = CAR(args);
+    jitfun = R_jitLoopClosure(rho);
 
     begincontext(&cntxt, CTXT_LOOP, R_NilValue, rho, R_BaseEnv, R_NilValue,
 		 R_NilValue);
     if (SETJMP(cntxt.cjmpbuf) != CTXT_BREAK) {
 	for (;;) {
 	    eval(body, rho);
+	    if (jitfun != R_NilValue && R_jitBackedge(jitfun) &&
+		R_jitContinueLoop(call, rho))
+		break;
 	}
     }
     endcontext(&cntxt);
@@ -3453,7 +4861,7 @@ int DispatchGroup(const char* group, SEXP call, SEXP op, SEXP args, SEXP rho,
 }
 
 /* start of bytecode section */
-static int R_bcVersion = 10;
+static int R_bcVersion = 12;
 static int R_bcMinVersion = 9;
 
 static SEXP R_AddSym = NULL;
@@ -3660,6 +5068,18 @@ enum {
   SEQALONG_OP,
   SEQLEN_OP,
   BASEGUARD_OP,
+  SETVAR_POP_OP,
+  LDCONST_ADD_OP,
+  LDCONST_SUB_OP,
+  LDCONST_MUL_OP,
+  LDCONST_DIV_OP,
+  LDCONST_EQ_OP,
+  LDCONST_NE_OP,
+  LDCONST_LT_OP,
+  LDCONST_LE_OP,
+  LDCONST_GE_OP,
+  LDCONST_GT_OP,
+  FRAMESLOTS_OP,
   OPCOUNT
 };
 
@@ -3675,20 +5095,6 @@ SEXP do_c_dflt(SEXP, SEXP, SEXP, SEXP);
 SEXP do_subset2_dflt(SEXP, SEXP, SEXP, SEXP);
 SEXP do_subassign2_dflt(SEXP, SEXP, SEXP, SEXP);
 
-static SEXP seq_int(int n1, int n2)
-{
-    int n = n1 <= n2 ? n2 - n1 + 1 : n1 - n2 + 1;
-    SEXP ans = allocVector(INTSXP, n);
-    int *data = INTEGER(ans);
-    if (n1 <= n2)
-	for (int i = 0; i < n; i++)
-	    data[i] = n1 + i;
-    else
-	for (int i = 0; i < n; i++)
-	    data[i] = n1 - i;
-    return ans;
-}
-
 #ifdef TYPED_STACK
 # define COMPACT_INTSEQ
 # ifdef COMPACT_INTSEQ
@@ -3729,7 +5135,7 @@ static R_INLINE SEXP GETSTACK_PTR_TAG(R_bcstack_t *s)
     case INTSEQSXP:
 	{
 	    int *seqinfo = INTEGER(s->u.sxpval);
-	    value = seq_int(seqinfo[0], seqinfo[1]);
+	    value = R_compact_intrange(seqinfo[0], seqinfo[1]);
 	}
 	break;
 #endif
@@ -3803,7 +5209,7 @@ static R_INLINE SEXP GETSTACK_PTR_TAG(R_bcstack_t *s)
     } while (0)
 #else
 #define SETSTACK_INTSEQ(idx, rn1, rn2) \
-    SETSTACK(idx, seq_int((int) rn1, (int) rn2))
+    SETSTACK(idx, R_compact_intrange((int) rn1, (int) rn2))
 #endif
 
 #define GETSTACK_SXPVAL(i) GETSTACK_SXPVAL_PTR(R_BCNodeStackTop + (i))
@@ -3881,18 +5287,18 @@ static R_INLINE int bcStackScalarEx(R_bcstack_t *s, scalar_value_t *v,
 #ifndef NO_SAVE_ALLOC
 	if (pv && NO_REFERENCES(x)) *pv = x;
 #endif
-	v->dval = REAL(x)[0];
+	v->dval = SCALAR_DVAL(x);
 	return REALSXP;
     }
     else if (IS_SIMPLE_SCALAR(x, INTSXP)) {
 #ifndef NO_SAVE_ALLOC
 	if (pv && NO_REFERENCES(x)) *pv = x;
 #endif
-	v->ival = INTEGER(x)[0];
+	v->ival = SCALAR_IVAL(x);
 	return INTSXP;
     }
     else if (IS_SIMPLE_SCALAR(x, LGLSXP)) {
-	v->ival = LOGICAL(x)[0];
+	v->ival = SCALAR_LVAL(x);
 	return LGLSXP;
     }
     else return 0;
@@ -3905,10 +5311,22 @@ static R_INLINE int bcStackScalarEx(R_bcstack_t *s, scalar_value_t *v,
 #define INTEGER_TO_REAL(x) ((x) == NA_INTEGER ? NA_REAL : (x))
 #define LOGICAL_TO_REAL(x) ((x) == NA_LOGICAL ? NA_REAL : (x))
 
+/* bcStackScalarNumEx() is like bcStackScalarEx() but returns a
+   logical scalar as an integer one, as arithmetic and comparison
+   operators treat it. This relies on NA_LOGICAL == NA_INTEGER. */
+static R_INLINE int bcStackScalarNumEx(R_bcstack_t *s, scalar_value_t *v,
+				       SEXP *pv)
+{
+    int type = bcStackScalarEx(s, v, pv);
+    return type == LGLSXP ? INTSXP : type;
+}
+
+#define bcStackScalarNum(s, v) bcStackScalarNumEx(s, v, NULL)
+
 static R_INLINE int bcStackScalarRealEx(R_bcstack_t *s, scalar_value_t *px,
 					SEXP *pv)
 {
-    int typex = bcStackScalarEx(s, px, pv);
+    int typex = bcStackScalarNumEx(s, px, pv);
     if (typex == INTSXP) {
 	typex = REALSXP;
 	px->dval = INTEGER_TO_REAL(px->ival);
@@ -3927,8 +5345,8 @@ static R_INLINE int bcStackScalarRealEx(R_bcstack_t *s, scalar_value_t *px,
 # define FastRelop2(op,opval,opsym) do { \
     scalar_value_t vx; \
     scalar_value_t vy; \
-    int typex = bcStackScalar(R_BCNodeStackTop - 2, &vx); \
-    int typey = bcStackScalar(R_BCNodeStackTop - 1, &vy); \
+    int typex = bcStackScalarNum(R_BCNodeStackTop - 2, &vx); \
+    int typey = bcStackScalarNum(R_BCNodeStackTop - 1, &vy); \
     if (typex == REALSXP && ! ISNAN(vx.dval)) { \
 	if (typey == REALSXP && ! ISNAN(vy.dval)) \
 	    DO_FAST_RELOP2(op, vx.dval, vy.dval); \
@@ -3945,6 +5363,46 @@ static R_INLINE int bcStackScalarRealEx(R_bcstack_t *s, scalar_value_t *px,
     Relop2(opval, opsym); \
 } while (0)
 
+/* The logical value of a scalar as used by '!', '&' and '|' */
+#define SCALAR_LOGICAL_VALUE(type, v) \
+    ((type) == REALSXP ? (ISNAN((v).dval) ? NA_LOGICAL : (v).dval != 0) : \
+     (type) == INTSXP ? INTEGER_TO_LOGICAL((v).ival) : (v).ival)
+
+#define FastNot(rho) do { \
+    scalar_value_t vx; \
+    int typex = bcStackScalar(R_BCNodeStackTop - 1, &vx); \
+    if (typex) { \
+	int x = SCALAR_LOGICAL_VALUE(typex, vx); \
+	SKIP_OP(); \
+	SETSTACK_LOGICAL(-1, x == NA_LOGICAL ? NA_LOGICAL : ! x); \
+	NEXT(); \
+    } \
+    Builtin1(do_logic, R_NotSym, rho); \
+} while (0)
+
+#define FastLogic2(isand, opsym, rho) do { \
+    scalar_value_t vx; \
+    scalar_value_t vy; \
+    int typex = bcStackScalar(R_BCNodeStackTop - 2, &vx); \
+    int typey = bcStackScalar(R_BCNodeStackTop - 1, &vy); \
+    if (typex && typey) { \
+	int x = SCALAR_LOGICAL_VALUE(typex, vx); \
+	int y = SCALAR_LOGICAL_VALUE(typey, vy); \
+	int ans; \
+	if (isand) \
+	    ans = (x == FALSE || y == FALSE) ? FALSE : \
+		(x == NA_LOGICAL || y == NA_LOGICAL) ? NA_LOGICAL : TRUE; \
+	else \
+	    ans = (x == TRUE || y == TRUE) ? TRUE : \
+		(x == NA_LOGICAL || y == NA_LOGICAL) ? NA_LOGICAL : FALSE; \
+	SKIP_OP(); \
+	SETSTACK_LOGICAL(-2, ans); \
+	R_BCNodeStackTop--; \
+	NEXT(); \
+    } \
+    Builtin2(do_logic, opsym, rho); \
+} while (0)
+
 static R_INLINE SEXP getPrimitive(SEXP symbol, SEXPTYPE type)
 {
     SEXP value = SYMVALUE(symbol);
@@ -4067,7 +5525,7 @@ static SEXP cmp_arith2(SEXP call, int opval, SEXP opsym, SEXP x, SEXP y,
 #define FastMath1(fun, sym) do {					\
 	scalar_value_t vx;						\
 	SEXP sa = NULL;							\
-	int typex = bcStackScalarEx(R_BCNodeStackTop - 1, &vx, &sa);	\
+	int typex = bcStackScalarNumEx(R_BCNodeStackTop - 1, &vx, &sa); \
 	if (typex == REALSXP) {						\
 	    double dval = fun(vx.dval);					\
 	    if (CMP_ISNAN(dval)) {					\
@@ -4131,7 +5589,7 @@ static SEXP cmp_arith2(SEXP call, int opval, SEXP opsym, SEXP x, SEXP y,
 #define FastUnary(op, opsym) do {					\
 	scalar_value_t vx;						\
 	SEXP sa = NULL;							\
-	int typex = bcStackScalarEx(R_BCNodeStackTop - 1, &vx, &sa);	\
+	int typex = bcStackScalarNumEx(R_BCNodeStackTop - 1, &vx, &sa); \
 	if (typex == REALSXP) {						\
 	    SKIP_OP();							\
 	    SETSTACK_REAL_EX(-1, op vx.dval, sa);			\
@@ -4150,8 +5608,8 @@ static SEXP cmp_arith2(SEXP call, int opval, SEXP opsym, SEXP x, SEXP y,
     scalar_value_t vy; \
     SEXP sa = NULL; \
     SEXP sb = NULL; \
-    int typex = bcStackScalarEx(R_BCNodeStackTop - 2, &vx, &sa);	\
-    int typey = bcStackScalarEx(R_BCNodeStackTop - 1, &vy, &sb);	\
+    int typex = bcStackScalarNumEx(R_BCNodeStackTop - 2, &vx, &sa);	\
+    int typey = bcStackScalarNumEx(R_BCNodeStackTop - 1, &vy, &sb);	\
     if (typex == REALSXP) { \
 	if (typey == REALSXP) \
 	    DO_FAST_BINOP(op, vx.dval, vy.dval, sa ? sa : sb);	\
@@ -4171,9 +5629,9 @@ static SEXP cmp_arith2(SEXP call, int opval, SEXP opsym, SEXP x, SEXP y,
     Arith2(opval, opsym); \
 } while (0)
 
-#define R_ADD(x, y) ((x) + (y))
+#define R_ADD(x, y) NAN_FIRST((double) (x), (x) + (y))
 #define R_SUB(x, y) ((x) - (y))
-#define R_MUL(x, y) ((x) * (y))
+#define R_MUL(x, y) NAN_FIRST((double) (x), (x) * (y))
 #define R_DIV(x, y) ((x) / (y))
 
 #include "arithmetic.h"
@@ -4547,13 +6005,23 @@ typedef union { void *v; int i; } BCODE;
    in bcEval stack frames and thus increasing stack usage
    dramatically */
 volatile
-static struct { void *addr; int argc; char *instname; } opinfo[OPCOUNT];
-
+static struct {
+    void *addr;
+    void *countaddr;
+    int argc;
+    char *instname;
+} opinfo[OPCOUNT];
+
+/* Each instruction also has a counting entry point that records its
+   execution and falls through to the instruction itself; byte code
+   objects are re-threaded to use these while counting is enabled. */
 #define OP(name,n) \
   case name##_OP: opinfo[name##_OP].addr = (__extension__ &&op_##name); \
+    opinfo[name##_OP].countaddr = (__extension__ &&opcount_##name); \
     opinfo[name##_OP].argc = (n); \
     opinfo[name##_OP].instname = #name; \
     goto loop; \
+    opcount_##name: BC_COUNT_OP(name##_OP); \
     op_##name
 
 #define BEGIN_MACHINE  NEXT(); init: { loop: switch(which++)
@@ -4571,9 +6039,11 @@ typedef int BCODE;
 #define OP(name,argc) case name##_OP
 
 #ifdef BC_PROFILING
-#define BEGIN_MACHINE  loop: currentpc = pc; current_opcode = *pc; switch(*pc++)
+#define BEGIN_MACHINE  loop: currentpc = pc; current_opcode = *pc; \
+    if (bc_counting) BC_COUNT_OP(*pc); switch(*pc++)
 #else
-#define BEGIN_MACHINE  loop: currentpc = pc; switch(*pc++)
+#define BEGIN_MACHINE  loop: currentpc = pc; \
+    if (bc_counting) BC_COUNT_OP(*pc); switch(*pc++)
 #endif
 #define LASTOP  default: error(_("bad opcode"))
 #define INITIALIZE_MACHINE()
@@ -4760,6 +6230,76 @@ static R_INLINE SEXP getvar(SEXP symbol, SEXP rho,
     return value;
 }
 
+/* Function lookup cache for GETFUN.
+
+   The first time a byte code object executes GETFUN it gets a cache
+   parallel to its constant pool.  For each function symbol the cache
+   records the function found, the 'scope' the search was cached from
+   and the value of R_FunCacheEpoch at the time.  The scope is the
+   first hashed or base environment on the chain; the unhashed
+   function frames below it are searched for the symbol on each use,
+   and the cache is not used if one of them has a binding for it.
+   What is found from the scope on can only change if a binding of a
+   symbol marked by SET_FUN_CACHED_SYMBOL changes, or if the search
+   path or an enclosure changes; both bump R_FunCacheEpoch.  Symbols
+   that have had active bindings and chains that include user
+   databases are not cached.  The cache is kept in the TAG field of
+   the byte code object, which is not serialized or copied. */
+
+enum { FC_FUN, FC_SCOPE, FC_STAMP, FC_LENGTH };
+
+static SEXP getFunCache(SEXP body)
+{
+    SEXP cache = BCODE_FUNCACHE(body);
+    if (cache == R_NilValue) {
+	int n = LENGTH(BCODE_CONSTS(body));
+	PROTECT(cache = allocVector(VECSXP, FC_LENGTH));
+	SET_VECTOR_ELT(cache, FC_FUN, allocVector(VECSXP, n));
+	SET_VECTOR_ELT(cache, FC_SCOPE, allocVector(VECSXP, n));
+	SET_VECTOR_ELT(cache, FC_STAMP, allocVector(INTSXP, n));
+	SET_TAG(body, cache);
+	UNPROTECT(1); /* cache */
+    }
+    return cache;
+}
+
+static R_INLINE SEXP FIND_FUN_CACHED(SEXP symbol, SEXP rho, SEXP body,
+				     int sidx)
+{
+    SEXP scope = rho;
+    while (scope != R_EmptyEnv && scope != R_BaseEnv &&
+	   scope != R_BaseNamespace && HASHTAB(scope) == R_NilValue) {
+	for (SEXP frame = FRAME(scope); frame != R_NilValue;
+	     frame = CDR(frame))
+	    if (TAG(frame) == symbol)
+		return findFun(symbol, rho);
+	scope = ENCLOS(scope);
+    }
+
+    SEXP cache = getFunCache(body);
+    if (VECTOR_ELT(VECTOR_ELT(cache, FC_SCOPE), sidx) == scope &&
+	(unsigned int) INTEGER(VECTOR_ELT(cache, FC_STAMP))[sidx] ==
+	R_FunCacheEpoch)
+	return VECTOR_ELT(VECTOR_ELT(cache, FC_FUN), sidx);
+
+    unsigned int epoch = R_FunCacheEpoch;
+    SET_FUN_CACHED_SYMBOL(symbol);
+    SEXP value = PROTECT(findFun(symbol, rho));
+    if (epoch == R_FunCacheEpoch && ! HAD_ACTIVE_BINDING(symbol)) {
+	SEXP e;
+	for (e = scope; e != R_EmptyEnv; e = ENCLOS(e))
+	    if (OBJECT(e) && inherits(e, "UserDefinedDatabase"))
+		break;
+	if (e == R_EmptyEnv) {
+	    SET_VECTOR_ELT(VECTOR_ELT(cache, FC_FUN), sidx, value);
+	    SET_VECTOR_ELT(VECTOR_ELT(cache, FC_SCOPE), sidx, scope);
+	    INTEGER(VECTOR_ELT(cache, FC_STAMP))[sidx] = (int) epoch;
+	}
+    }
+    UNPROTECT(1); /* value */
+    return value;
+}
+
 #define INLINE_GETVAR
 #ifdef INLINE_GETVAR
 /* Try to handle the most common case as efficiently as possible.  If
@@ -4792,6 +6332,9 @@ static R_INLINE SEXP getvar(SEXP symbol, SEXP rho,
 	if (cell != R_NilValue && ! IS_ACTIVE_BINDING(cell)) { \
 	    value = CAR(cell); \
 	    if (TYPEOF(value) != SYMSXP) {	\
+		/* as in getvar(), forcing a promise may make the	\
+		   value invisible */					\
+		R_Visible = TRUE;					\
 		if (TYPEOF(value) == PROMSXP) {		\
 		    SEXP pv = PRVALUE(value);		\
 		    if (pv == R_UnboundValue) {		\
@@ -4802,7 +6345,6 @@ static R_INLINE SEXP getvar(SEXP symbol, SEXP rho,
 		}							\
 		else if (NAMED(value) == 0)				\
 		    SET_NAMED(value, 1);				\
-		R_Visible = TRUE;					\
 		BCNPUSH(value);						\
 		NEXT();							\
 	    }								\
@@ -4823,6 +6365,100 @@ static R_INLINE SEXP getvar(SEXP symbol, SEXP rho,
 } while (0)
 #endif
 
+#define DO_LDCONST() do { \
+    R_Visible = TRUE; \
+    SEXP value = VECTOR_ELT(constants, GETOP()); \
+    if (R_check_constants < 0) \
+	value = duplicate(value); \
+    MARK_NOT_MUTABLE(value); \
+    BCNPUSH(value); \
+} while (0)
+
+#ifdef TYPED_STACK
+/* If the binding value is not shared and is a simple scalar of the
+   same type as the immediate value on the stack, then the stack value
+   can be copied into the binding value. Reading the locked bit is OK
+   even if cell is R_NilValue. If cell is R_NilValue or an active
+   binding, or if the value is R_UnboundValue, then TYPEOF(CAR(cell))
+   will not match the immediate value tag. */
+#define DO_SETVAR_IMMEDIATE(loc, pop) do { \
+    R_bcstack_t *s = R_BCNodeStackTop - 1; \
+    if (s->tag && ! BINDING_IS_LOCKED(loc)) { \
+	SEXP x = CAR(loc);  /* fast, but assumes binding is a CONS */ \
+	if (NOT_SHARED(x) && IS_SIMPLE_SCALAR(x, s->tag)) { \
+	    switch (s->tag) { \
+	    case REALSXP: REAL(x)[0] = s->u.dval; break; \
+	    case INTSXP: INTEGER(x)[0] = s->u.ival; break; \
+	    case LGLSXP: LOGICAL(x)[0] = s->u.ival; break; \
+	    } \
+	    if (pop) BCNPOP_IGNORE_VALUE(); \
+	    NEXT(); \
+	} \
+    } \
+} while (0)
+#else
+#define DO_SETVAR_IMMEDIATE(loc, pop) do { } while (0)
+#endif
+
+/* SETVAR_POP is SETVAR followed by POP, the usual sequence for an
+   assignment whose value is not used. */
+#define DO_SETVAR(pop) do { \
+    int sidx = GETOP(); \
+    SEXP loc; \
+    if (smallcache) \
+	loc = GET_SMALLCACHE_BINDING_CELL(vcache, sidx); \
+    else { \
+	SEXP symbol = VECTOR_ELT(constants, sidx); \
+	loc = GET_BINDING_CELL_CACHE(symbol, rho, vcache, sidx); \
+    } \
+    DO_SETVAR_IMMEDIATE(loc, pop); \
+    SEXP value = GETSTACK(-1); \
+    INCREMENT_NAMED(value); \
+    if (! SET_BINDING_VALUE(loc, value)) { \
+	SEXP symbol = VECTOR_ELT(constants, sidx); \
+	PROTECT(value); \
+	defineVar(symbol, value, rho); \
+	UNPROTECT(1); \
+	CACHE_NEW_BINDING(symbol, sidx); \
+    } \
+    if (pop) BCNPOP_IGNORE_VALUE(); \
+    NEXT(); \
+} while (0)
+
+/* A new binding in a function frame is at the front of the frame;
+   enter it in the binding cache so that later uses of the local
+   variable do not have to search the frame for it. */
+#define CACHE_NEW_BINDING(symbol, sidx) do { \
+    if (vcache != NULL && HASHTAB(rho) == R_NilValue && \
+	rho != R_BaseEnv && rho != R_BaseNamespace && \
+	TAG(FRAME(rho)) == (symbol)) \
+	SET_CACHED_BINDING(vcache, sidx, FRAME(rho)); \
+} while (0)
+
+/* FRAMESLOTS is the first instruction of a compiled function body.
+   Its operand is an integer vector giving, for each formal argument
+   in order, the constant pool index of its symbol (-1 for '...').
+   applyClosure creates the argument bindings in the same order, so
+   they can be entered in the binding cache with a single pass over
+   the frame; arguments are then accessed through their cache slots
+   from the first use.  Bindings that are not where they are expected
+   (as when the body is evaluated in some other environment) are
+   left to be found by the usual search. */
+#define DO_FRAMESLOTS() do { \
+    SEXP slots = VECTOR_ELT(constants, GETOP()); \
+    if (vcache != NULL && HASHTAB(rho) == R_NilValue && \
+	rho != R_BaseEnv && rho != R_BaseNamespace) { \
+	int *sl = INTEGER(slots), nsl = LENGTH(slots); \
+	SEXP cell = FRAME(rho); \
+	for (int i = 0; i < nsl && cell != R_NilValue; \
+	     i++, cell = CDR(cell)) { \
+	    int k = sl[i]; \
+	    if (k >= 0 && TAG(cell) == VECTOR_ELT(constants, k)) \
+		SET_CACHED_BINDING(vcache, k, cell); \
+	} \
+    } \
+} while (0)
+
 /* call frame accessors */
 #define CALL_FRAME_FUN() GETSTACK(-3)
 #define CALL_FRAME_ARGS() GETSTACK(-2)
@@ -5050,6 +6686,164 @@ static int current_opcode = NO_CURRENT_OPCODE;
 static int opcode_counts[OPCOUNT];
 #endif
 
+/* Byte code execution counting. While counting is enabled the
+   threaded code of each byte code object is switched on entry to
+   bcEval to the counting entry points of its instructions (in
+   non-threaded builds BEGIN_MACHINE checks the flag instead). Each
+   activation of a closure body pushes a frame allocated on the C
+   stack; the chain of frames is saved in contexts and unwound on
+   non-local exits, so the instructions executed can be attributed to
+   the closure executing them and to its callers. Times are estimated
+   by sampling the current opcode and frame chain with the profiling
+   timer. */
+typedef struct R_bccountframe {
+    struct R_bccountframe *prev;
+    int rec;			/* index of the closure's record */
+    int generation;		/* bc_count_generation at entry */
+    R_size_t start;		/* bc_count_instrs at entry */
+    R_size_t child;		/* instructions executed by callees */
+} R_bccountframe_t;
+
+typedef struct {
+    double calls;
+    double instrs;		/* including callees; once per recursion */
+    double selfinstrs;
+    int samples;
+    int selfsamples;
+    int sampled;		/* last sample counted in 'samples' */
+    int active;			/* number of activations on the stack */
+} R_bccountrec_t;
+
+#define NO_COUNT_OPCODE -1
+static volatile int bc_count_opcode = NO_COUNT_OPCODE;
+static R_size_t bc_count_instrs = 0;
+static R_size_t bc_count_ops[OPCOUNT];
+static int bc_count_opsamples[OPCOUNT];
+static int bc_count_generation = 0;
+static int bc_count_nsamples = 0;
+static double bc_count_interval = 0;
+
+/* closure records, hashed on the address of the body; the bodies and
+   calls are kept in bc_count_objs so the addresses stay valid */
+static R_bccountrec_t *bc_count_recs = NULL;
+static int bc_count_nrecs = 0;
+static int *bc_count_hash = NULL;
+static int bc_count_hashsize = 0;
+static SEXP bc_count_objs = NULL;
+
+#define BC_COUNT_OP(op) do { \
+  bc_count_ops[op]++; \
+  bc_count_instrs++; \
+  bc_count_opcode = (op); \
+} while (0)
+
+#define BC_COUNT_HASH(body, size) \
+  ((int) ((((uintptr_t) (body)) >> 3) * 2654435761u) & ((size) - 1))
+
+static void bcCountGrow(void)
+{
+    int i, size = bc_count_hashsize ? 2 * bc_count_hashsize : 256;
+    int *hash = (int *) malloc(size * sizeof(int));
+    R_bccountrec_t *recs = (R_bccountrec_t *)
+	malloc((size / 2) * sizeof(R_bccountrec_t));
+    if (hash == NULL || recs == NULL) {
+	free(hash);
+	free(recs);
+	error(_("cannot allocate byte code counting table"));
+    }
+    SEXP objs = allocVector(VECSXP, size);
+    for (i = 0; i < 2 * bc_count_nrecs; i++)
+	SET_VECTOR_ELT(objs, i, VECTOR_ELT(bc_count_objs, i));
+    R_PreserveObject(objs);
+    if (bc_count_objs != NULL)
+	R_ReleaseObject(bc_count_objs);
+    bc_count_objs = objs;
+
+    for (i = 0; i < size; i++)
+	hash[i] = -1;
+    for (i = 0; i < bc_count_nrecs; i++) {
+	int h = BC_COUNT_HASH(VECTOR_ELT(objs, 2 * i), size);
+	while (hash[h] >= 0)
+	    h = (h + 1) & (size - 1);
+	hash[h] = i;
+    }
+    if (bc_count_nrecs > 0)
+	memcpy(recs, bc_count_recs, bc_count_nrecs * sizeof(R_bccountrec_t));
+
+    /* the profiling timer handler may read bc_count_recs at any point,
+       so switch to the new table before freeing the old one */
+    R_bccountrec_t *oldrecs = bc_count_recs;
+    int *oldhash = bc_count_hash;
+    bc_count_recs = recs;
+    bc_count_hash = hash;
+    bc_count_hashsize = size;
+    free(oldrecs);
+    free(oldhash);
+}
+
+static int bcCountRecord(SEXP body, SEXP call)
+{
+    if (2 * (bc_count_nrecs + 1) > bc_count_hashsize)
+	bcCountGrow();
+    int h = BC_COUNT_HASH(body, bc_count_hashsize);
+    int i;
+    while ((i = bc_count_hash[h]) >= 0) {
+	if (VECTOR_ELT(bc_count_objs, 2 * i) == body)
+	    return i;
+	h = (h + 1) & (bc_count_hashsize - 1);
+    }
+    i = bc_count_nrecs;
+    SET_VECTOR_ELT(bc_count_objs, 2 * i, body);
+    SET_VECTOR_ELT(bc_count_objs, 2 * i + 1, call);
+    memset(bc_count_recs + i, 0, sizeof(R_bccountrec_t));
+    bc_count_recs[i].sampled = -1;
+    bc_count_nrecs++;
+    bc_count_hash[h] = i;
+    return i;
+}
+
+static void bcCountEnter(R_bccountframe_t *frame, SEXP body, SEXP call)
+{
+    int rec = bcCountRecord(body, call);
+    bc_count_recs[rec].calls++;
+    bc_count_recs[rec].active++;
+    frame->prev = R_BCCountFrame;
+    frame->rec = rec;
+    frame->generation = bc_count_generation;
+    frame->start = bc_count_instrs;
+    frame->child = 0;
+    R_BCCountFrame = frame;
+}
+
+static void bcCountExit(R_bccountframe_t *frame)
+{
+    R_BCCountFrame = frame->prev;
+    if (frame->generation == bc_count_generation) {
+	R_bccountrec_t *r = bc_count_recs + frame->rec;
+	R_size_t n = bc_count_instrs - frame->start;
+	r->selfinstrs += n - frame->child;
+	if (--r->active == 0)
+	    r->instrs += n;
+	if (frame->prev != NULL &&
+	    frame->prev->generation == bc_count_generation)
+	    frame->prev->child += n;
+    }
+}
+
+/* called from R_restore_globals to close the frames of byte code
+   activations being jumped over */
+void attribute_hidden R_BCCountUnwind(void *target)
+{
+    while (R_BCCountFrame != NULL && R_BCCountFrame != target)
+	bcCountExit((R_bccountframe_t *) R_BCCountFrame);
+}
+
+#ifdef THREADED_CODE
+static void bcCountThread(SEXP body);
+#define BC_COUNT_THREADED_MASK 1
+#define BC_COUNT_THREADED(body) (LEVELS(body) & BC_COUNT_THREADED_MASK)
+#endif
+
 #define BC_COUNT_DELTA 1000
 
 #ifndef IMMEDIATE_FINALIZERS
@@ -5092,12 +6886,12 @@ static R_INLINE R_xlen_t bcStackIndex(R_bcstack_t *s)
 #endif
     SEXP idx = GETSTACK_SXPVAL_PTR(s);
     if (IS_SCALAR(idx, INTSXP)) {
-	if (INTEGER(idx)[0] != NA_INTEGER)
-	    return INTEGER(idx)[0];
+	if (SCALAR_IVAL(idx) != NA_INTEGER)
+	    return SCALAR_IVAL(idx);
 	else return -1;
     }
     else if (IS_SCALAR(idx, REALSXP)) {
-	double val = REAL(idx)[0];
+	double val = SCALAR_DVAL(idx);
 	if (! ISNAN(val) && val <= R_XLEN_T_MAX && val > 0)
 	    return (R_xlen_t) val;
 	else return -1;
@@ -5116,11 +6910,11 @@ static R_INLINE SEXP mkVector1(SEXP s)
 	switch (TYPEOF(vec)) {					\
 	case REALSXP:						\
 	    if (XLENGTH(vec) <= i) break;			\
-	    SETSTACK_REAL_PTR(sv, REAL(vec)[i]);		\
+	    SETSTACK_REAL_PTR(sv, REAL_ELT(vec, i));		\
 	    return;						\
 	case INTSXP:						\
 	    if (XLENGTH(vec) <= i) break;			\
-	    SETSTACK_INTEGER_PTR(sv, INTEGER(vec)[i]);		\
+	    SETSTACK_INTEGER_PTR(sv, INTEGER_ELT(vec, i));	\
 	    return;						\
 	case LGLSXP:						\
 	    if (XLENGTH(vec) <= i) break;			\
@@ -5530,15 +7324,29 @@ static R_INLINE void SUBASSIGN_N_PTR(R_bcstack_t *sx, int rank,
 	R_BCNodeStackTop -= rank + 1;					\
     } while (0)
 
-#define FIXUP_SCALAR_LOGICAL(callidx, arg, op) do { \
-	SEXP val = GETSTACK(-1); \
-	if (TYPEOF(val) != LGLSXP || XLENGTH(val) != 1) { \
-	    if (!isNumber(val))	\
-		errorcall(VECTOR_ELT(constants, callidx), \
-			  _("invalid %s type in 'x %s y'"), arg, op);	\
-	    SETSTACK(-1, ScalarLogical(asLogical(val))); \
-	} \
-    } while(0)
+/* Replace the value on the top of the stack by its logical value as
+   an operand of '&&' or '||', and return that value. Simple scalars
+   are handled without boxing. */
+static R_INLINE int FIXUP_SCALAR_LOGICAL(SEXP constants, int callidx,
+					 const char *arg, const char *op)
+{
+    scalar_value_t v;
+    int type = bcStackScalar(R_BCNodeStackTop - 1, &v);
+    int ans;
+    if (type)
+	ans = SCALAR_LOGICAL_VALUE(type, v);
+    else {
+	SEXP val = GETSTACK(-1);
+	if (TYPEOF(val) == LGLSXP && XLENGTH(val) == 1)
+	    return LOGICAL(val)[0];
+	if (!isNumber(val))
+	    errorcall(VECTOR_ELT(constants, callidx),
+		      _("invalid %s type in 'x %s y'"), arg, op);
+	ans = asLogical(val);
+    }
+    SETSTACK_LOGICAL(-1, ans);
+    return ans;
+}
 
 static void signalMissingArgError(SEXP args, SEXP call)
 {
@@ -5651,8 +7459,8 @@ static R_INLINE Rboolean GETSTACK_LOGICAL_NO_NA_PTR(R_bcstack_t *s, int callidx,
 	return s->u.ival;
 #endif
     SEXP value = GETSTACK_PTR(s);
-    if (IS_SCALAR(value, LGLSXP) && LOGICAL(value)[0] != NA_LOGICAL)
-	return LOGICAL(value)[0];
+    if (IS_SCALAR(value, LGLSXP) && SCALAR_LVAL(value) != NA_LOGICAL)
+	return SCALAR_LVAL(value);
     else {
 	SEXP call = VECTOR_ELT(constants, callidx);
 	return asLogicalNoNA(value, call);
@@ -5887,6 +7695,9 @@ static SEXP bcEval(SEXP body, SEXP rho, Rboolean useCache)
 #ifdef BC_PROFILING
   int old_current_opcode = current_opcode;
 #endif
+  int old_count_opcode = bc_count_opcode;
+  R_bccountframe_t countframe;
+  Rboolean counted = FALSE;
 #ifdef THREADED_CODE
   int which = 0;
 #endif
@@ -5922,6 +7733,21 @@ static SEXP bcEval(SEXP body, SEXP rho, Rboolean useCache)
       }
   }
 
+#ifdef THREADED_CODE
+  if (BC_COUNT_THREADED(body) != bc_counting)
+      bcCountThread(body);
+#endif
+  if (bc_counting) {
+      /* only closure bodies get a frame; promises and loop bodies
+	 count towards the closure evaluating them */
+      RCNTXT *cptr = R_GlobalContext;
+      if ((cptr->callflag & CTXT_FUNCTION) && cptr->cloenv == rho &&
+	  TYPEOF(cptr->callfun) == CLOSXP && BODY(cptr->callfun) == body) {
+	  bcCountEnter(&countframe, body, cptr->call);
+	  counted = TRUE;
+      }
+  }
+
   R_Srcref = R_InBCInterpreter;
   R_BCIntActive = 1;
   R_BCbody = body;
@@ -6121,11 +7947,11 @@ static SEXP bcEval(SEXP body, SEXP rho, Rboolean useCache)
 	    }
 	    else
 #endif
-	    INTEGER(value)[0] = INTEGER(seq)[i];
+	    INTEGER(value)[0] = INTEGER_ELT(seq, i);
 	    break;
 	  case REALSXP:
 	    GET_VEC_LOOP_VALUE(value, -1);
-	    REAL(value)[0] = REAL(seq)[i];
+	    REAL(value)[0] = REAL_ELT(seq, i);
 	    break;
 	  case CPLXSXP:
 	    GET_VEC_LOOP_VALUE(value, -1);
@@ -6173,67 +7999,19 @@ static SEXP bcEval(SEXP body, SEXP rho, Rboolean useCache)
     OP(SETLOOPVAL, 0):
       BCNPOP_IGNORE_VALUE(); SETSTACK(-1, R_NilValue); NEXT();
     OP(INVISIBLE,0): R_Visible = FALSE; NEXT();
-    OP(LDCONST, 1):
-      {
-	R_Visible = TRUE;
-	SEXP value = VECTOR_ELT(constants, GETOP());
-	if (R_check_constants < 0)
-	    value = duplicate(value);
-	MARK_NOT_MUTABLE(value);
-	BCNPUSH(value);
-	NEXT();
-      }
+    OP(LDCONST, 1): DO_LDCONST(); NEXT();
     OP(LDNULL, 0): R_Visible = TRUE; BCNPUSH(R_NilValue); NEXT();
     OP(LDTRUE, 0): R_Visible = TRUE; BCNPUSH(R_TrueValue); NEXT();
     OP(LDFALSE, 0): R_Visible = TRUE; BCNPUSH(R_FalseValue); NEXT();
     OP(GETVAR, 1): DO_GETVAR(FALSE, FALSE);
     OP(DDVAL, 1): DO_GETVAR(TRUE, FALSE);
-    OP(SETVAR, 1):
-      {
-	int sidx = GETOP();
-	SEXP loc;
-	if (smallcache)
-	    loc = GET_SMALLCACHE_BINDING_CELL(vcache, sidx);
-	else {
-	    SEXP symbol = VECTOR_ELT(constants, sidx);
-	    loc = GET_BINDING_CELL_CACHE(symbol, rho, vcache, sidx);
-	}
-#ifdef TYPED_STACK
-	R_bcstack_t *s = R_BCNodeStackTop - 1;
-	/* reading the locked bit is OK even if cell is R_NilValue */
-	if (s->tag && ! BINDING_IS_LOCKED(loc)) {
-	    /* if cell is R_NilValue or an active binding, or if the value
-	       is R_UnboundValue, then TYPEOF(CAR(cell)) will not match the
-	       immediate value tag. */
-	    SEXP x = CAR(loc);  /* fast, but assumes binding is a CONS */
-	    if (NOT_SHARED(x) && IS_SIMPLE_SCALAR(x, s->tag)) {
-		/* if the binding value is not shared and is a simple
-		   scaler of the same type as the immediate value,
-		   then we can copy the stack value into the binding
-		   value */
-		switch (s->tag) {
-		case REALSXP: REAL(x)[0] = s->u.dval; NEXT();
-		case INTSXP: INTEGER(x)[0] = s->u.ival; NEXT();
-		case LGLSXP: LOGICAL(x)[0] = s->u.ival; NEXT();
-		}
-	    }
-	}
-#endif
-	SEXP value = GETSTACK(-1);
-	INCREMENT_NAMED(value);
-	if (! SET_BINDING_VALUE(loc, value)) {
-	    SEXP symbol = VECTOR_ELT(constants, sidx);
-	    PROTECT(value);
-	    defineVar(symbol, value, rho);
-	    UNPROTECT(1);
-	}
-	NEXT();
-      }
+    OP(SETVAR, 1): DO_SETVAR(FALSE);
     OP(GETFUN, 1):
       {
 	/* get the function */
-	SEXP symbol = VECTOR_ELT(constants, GETOP());
-	SEXP value = findFun(symbol, rho);
+	int sidx = GETOP();
+	SEXP symbol = VECTOR_ELT(constants, sidx);
+	SEXP value = FIND_FUN_CACHED(symbol, rho, body, sidx);
 	INIT_CALL_FRAME(value);
 	if(RTRACE(value)) {
 	  Rprintf("trace: ");
@@ -6398,6 +8176,7 @@ static SEXP bcEval(SEXP body, SEXP rho, Rboolean useCache)
 	  break;
 	case CLOSXP:
 	  value = applyClosure(call, fun, args, rho, R_NilValue);
+	  unpromiseArgs(args);
 	  break;
 	default: error(_("bad function"));
 	}
@@ -6484,9 +8263,9 @@ static SEXP bcEval(SEXP body, SEXP rho, Rboolean useCache)
     OP(LE, 1): FastRelop2(<=, LEOP, R_LeSym);
     OP(GE, 1): FastRelop2(>=, GEOP, R_GeSym);
     OP(GT, 1): FastRelop2(>, GTOP, R_GtSym);
-    OP(AND, 1): Builtin2(do_logic, R_AndSym, rho);
-    OP(OR, 1): Builtin2(do_logic, R_OrSym, rho);
-    OP(NOT, 1): Builtin1(do_logic, R_NotSym, rho);
+    OP(AND, 1): FastLogic2(TRUE, R_AndSym, rho);
+    OP(OR, 1): FastLogic2(FALSE, R_OrSym, rho);
+    OP(NOT, 1): FastNot(rho);
     OP(DOTSERR, 0): error(_("'...' used in an incorrect context"));
     OP(STARTASSIGN, 1):
       {
@@ -6618,44 +8397,40 @@ static SEXP bcEval(SEXP body, SEXP rho, Rboolean useCache)
     OP(AND1ST, 2): {
 	int callidx = GETOP();
 	int label = GETOP();
-	FIXUP_SCALAR_LOGICAL(callidx, "'x'", "&&");
-	SEXP value = GETSTACK(-1);
-	if (LOGICAL(value)[0] == FALSE)
+	int value = FIXUP_SCALAR_LOGICAL(constants, callidx, "'x'", "&&");
+	if (value == FALSE)
 	    pc = codebase + label;
 	NEXT();
     }
     OP(AND2ND, 1): {
 	int callidx = GETOP();
-	FIXUP_SCALAR_LOGICAL(callidx, "'y'", "&&");
-	SEXP value = GETSTACK(-1);
+	int value = FIXUP_SCALAR_LOGICAL(constants, callidx, "'y'", "&&");
 	/* The first argument is TRUE or NA. If the second argument is
 	   not TRUE then its value is the result. If the second
 	   argument is TRUE, then the first argument's value is the
 	   result. */
-	if (LOGICAL(value)[0] != TRUE)
-	    SETSTACK(-2, value);
+	if (value != TRUE)
+	    R_BCNodeStackTop[-2] = R_BCNodeStackTop[-1];
 	R_BCNodeStackTop -= 1;
 	NEXT();
     }
     OP(OR1ST, 2):  {
 	int callidx = GETOP();
 	int label = GETOP();
-	FIXUP_SCALAR_LOGICAL(callidx, "'x'", "||");
-	SEXP value = GETSTACK(-1);
-	if (LOGICAL(value)[0] != NA_LOGICAL && LOGICAL(value)[0]) /* is true */
+	int value = FIXUP_SCALAR_LOGICAL(constants, callidx, "'x'", "||");
+	if (value != NA_LOGICAL && value) /* is true */
 	    pc = codebase + label;
 	NEXT();
     }
     OP(OR2ND, 1):  {
 	int callidx = GETOP();
-	FIXUP_SCALAR_LOGICAL(callidx, "'y'", "||");
-	SEXP value = GETSTACK(-1);
+	int value = FIXUP_SCALAR_LOGICAL(constants, callidx, "'y'", "||");
 	/* The first argument is FALSE or NA. If the second argument is
 	   not FALSE then its value is the result. If the second
 	   argument is FALSE, then the first argument's value is the
 	   result. */
-	if (LOGICAL(value)[0] != FALSE)
-	    SETSTACK(-2, value);
+	if (value != FALSE)
+	    R_BCNodeStackTop[-2] = R_BCNodeStackTop[-1];
 	R_BCNodeStackTop -= 1;
 	NEXT();
     }
@@ -6914,6 +8689,21 @@ static SEXP bcEval(SEXP body, SEXP rho, Rboolean useCache)
     OP(SEQALONG, 1): DO_SEQ_ALONG(); NEXT();
     OP(SEQLEN, 1): DO_SEQ_LEN(); NEXT();
     OP(BASEGUARD, 2): DO_BASEGUARD(); NEXT();
+    /* Superinstructions: the LDCONST_<op> instructions push the
+       constant and then continue as <op>, which reads the call index
+       operand. */
+    OP(SETVAR_POP, 1): DO_SETVAR(TRUE);
+    OP(LDCONST_ADD, 2): DO_LDCONST(); FastBinary(R_ADD, PLUSOP, R_AddSym);
+    OP(LDCONST_SUB, 2): DO_LDCONST(); FastBinary(R_SUB, MINUSOP, R_SubSym);
+    OP(LDCONST_MUL, 2): DO_LDCONST(); FastBinary(R_MUL, TIMESOP, R_MulSym);
+    OP(LDCONST_DIV, 2): DO_LDCONST(); FastBinary(R_DIV, DIVOP, R_DivSym);
+    OP(LDCONST_EQ, 2): DO_LDCONST(); FastRelop2(==, EQOP, R_EqSym);
+    OP(LDCONST_NE, 2): DO_LDCONST(); FastRelop2(!=, NEOP, R_NeSym);
+    OP(LDCONST_LT, 2): DO_LDCONST(); FastRelop2(<, LTOP, R_LtSym);
+    OP(LDCONST_LE, 2): DO_LDCONST(); FastRelop2(<=, LEOP, R_LeSym);
+    OP(LDCONST_GE, 2): DO_LDCONST(); FastRelop2(>=, GEOP, R_GeSym);
+    OP(LDCONST_GT, 2): DO_LDCONST(); FastRelop2(>, GTOP, R_GtSym);
+    OP(FRAMESLOTS, 1): DO_FRAMESLOTS(); NEXT();
     LASTOP;
   }
 
@@ -6929,6 +8719,9 @@ static SEXP bcEval(SEXP body, SEXP rho, Rboolean useCache)
 #ifdef BC_PROFILING
   current_opcode = old_current_opcode;
 #endif
+  if (counted)
+      bcCountExit(&countframe);
+  bc_count_opcode = old_count_opcode;
   return retvalue;
 }
 
@@ -6986,12 +8779,34 @@ static int findOp(void *addr)
     int i;
 
     for (i = 0; i < OPCOUNT; i++)
-	if (opinfo[i].addr == addr)
+	if (opinfo[i].addr == addr || opinfo[i].countaddr == addr)
 	    return i;
     error(_("cannot find index for threaded code address"));
     return 0; /* not reached */
 }
 
+/* Switch the instructions of a byte code object to or from their
+   counting entry points to match bc_counting. This is done in place;
+   activations of the code already running see the change at their
+   next instruction, which is harmless. */
+static void bcCountThread(SEXP body)
+{
+    SEXP code = BCODE_CODE(body);
+    int m = (sizeof(BCODE) + sizeof(int) - 1) / sizeof(int);
+    int n = LENGTH(code) / m;
+    BCODE *pc = (BCODE *) INTEGER(code);
+
+    for (int i = 1; i < n;) {
+	int op = findOp(pc[i].v);
+	pc[i].v = bc_counting ? opinfo[op].countaddr : opinfo[op].addr;
+	i += opinfo[op].argc + 1;
+    }
+    if (bc_counting)
+	SETLEVELS(body, LEVELS(body) | BC_COUNT_THREADED_MASK);
+    else
+	SETLEVELS(body, LEVELS(body) & ~BC_COUNT_THREADED_MASK);
+}
+
 SEXP R_bcDecode(SEXP code) {
     int n, i, j, *ipc;
     BCODE *pc;
@@ -7064,16 +8879,17 @@ void attribute_hidden R_registerBC(SEXP bcBytes, SEXP bcode)
     int loadableConsts = 0;
 
     /* add only constants loaded by certain instructions  */
+#define LOADS_CONST(op) ((op) == LDCONST_OP || (op) == PUSHCONSTARG_OP || \
+			 (op) == CALLSPECIAL_OP || \
+			 ((op) >= LDCONST_ADD_OP && (op) <= LDCONST_GT_OP))
     for(i = 0; i < n; i += opinfo[ipc[i]].argc + 1)
-        if (ipc[i] == LDCONST_OP || ipc[i] == PUSHCONSTARG_OP ||
-		ipc[i] == CALLSPECIAL_OP)
+        if (LOADS_CONST(ipc[i]))
             loadableConsts++;
 
     SEXP constsRecord = PROTECT(allocVector(VECSXP, loadableConsts * 2 + 3));
     int crIdx = 3;
     for(i = 0; i < n; i += opinfo[ipc[i]].argc + 1)
-        if (ipc[i] == LDCONST_OP || ipc[i] == PUSHCONSTARG_OP ||
-		ipc[i] == CALLSPECIAL_OP) {
+        if (LOADS_CONST(ipc[i])) {
             SEXP corig = VECTOR_ELT(consts, ipc[i + 1]);
             SET_VECTOR_ELT(constsRecord, crIdx++, corig);
             SET_VECTOR_ELT(constsRecord, crIdx++, duplicate(corig));
@@ -7280,15 +9096,12 @@ static SEXP disassemble(SEXP bc)
   int i;
   SEXP code = BCODE_CODE(bc);
   SEXP consts = BCODE_CONSTS(bc);
-  SEXP expr = BCODE_EXPR(bc);
   int nc = LENGTH(consts);
 
-  PROTECT(ans = allocVector(VECSXP, expr != R_NilValue ? 4 : 3));
+  PROTECT(ans = allocVector(VECSXP, 3));
   SET_VECTOR_ELT(ans, 0, install(".Code"));
   SET_VECTOR_ELT(ans, 1, R_bcDecode(code));
   SET_VECTOR_ELT(ans, 2, allocVector(VECSXP, nc));
-  if (expr != R_NilValue)
-      SET_VECTOR_ELT(ans, 3, duplicate(expr));
 
   dconsts = VECTOR_ELT(ans, 2);
   for (i = 0; i < nc; i++) {
@@ -7583,6 +9396,166 @@ SEXP NORET do_bcprofstop(SEXP call, SEXP op, SEXP args, SEXP env) {
 }
 #endif
 
+#if defined(R_PROFILING) && !defined(Win32)
+# define BC_COUNT_TIMING
+static void bcCountSample(int sig)
+{
+    int op = bc_count_opcode;
+    if (op >= 0 && op < OPCOUNT)
+	bc_count_opsamples[op]++;
+    int sample = bc_count_nsamples++;
+    R_bccountframe_t *frame = R_BCCountFrame;
+    if (frame != NULL && frame->generation == bc_count_generation)
+	bc_count_recs[frame->rec].selfsamples++;
+    for (; frame != NULL; frame = frame->prev)
+	if (frame->generation == bc_count_generation) {
+	    R_bccountrec_t *r = bc_count_recs + frame->rec;
+	    if (r->sampled != sample) {
+		r->sampled = sample;
+		r->samples++;
+	    }
+	}
+    signal(SIGPROF, bcCountSample);
+}
+
+static void bcCountSampleNull(int sig)
+{
+    signal(SIGPROF, bcCountSampleNull);
+}
+
+static void bcCountSetTimer(double interval)
+{
+    struct itimerval itv;
+    int usec = (int) (1e6 * interval + 0.5);
+
+    itv.it_interval.tv_sec = usec / 1000000;
+    itv.it_interval.tv_usec = usec % 1000000;
+    itv.it_value = itv.it_interval;
+    if (setitimer(ITIMER_PROF, &itv, NULL) == -1)
+	error(_("setting profile timer failed"));
+}
+#endif
+
+SEXP attribute_hidden do_bccountstart(SEXP call, SEXP op, SEXP args, SEXP env)
+{
+    double interval;
+
+    checkArity(op, args);
+    interval = asReal(CAR(args));
+    if (ISNAN(interval) || interval < 0)
+	error(_("invalid '%s' argument"), "interval");
+    if (bc_counting)
+	error(_("already counting byte code execution"));
+#ifdef BC_COUNT_TIMING
+    if (interval > 0 && R_Profiling) {
+	warning(_("profile timer in use; byte code execution will not be timed"));
+	interval = 0;
+    }
+# ifdef BC_PROFILING
+    if (interval > 0 && bc_profiling) {
+	warning(_("profile timer in use; byte code execution will not be timed"));
+	interval = 0;
+    }
+# endif
+#else
+    interval = 0;
+#endif
+
+    /* frames of activations still on the stack belong to the earlier
+       generation and are ignored by the new counts */
+    bc_count_generation++;
+    bc_count_nrecs = 0;
+    for (int i = 0; i < bc_count_hashsize; i++)
+	bc_count_hash[i] = -1;
+    if (bc_count_objs != NULL)
+	for (int i = 0; i < LENGTH(bc_count_objs); i++)
+	    SET_VECTOR_ELT(bc_count_objs, i, R_NilValue);
+    for (int i = 0; i < OPCOUNT; i++) {
+	bc_count_ops[i] = 0;
+	bc_count_opsamples[i] = 0;
+    }
+    bc_count_instrs = 0;
+    bc_count_nsamples = 0;
+    bc_count_opcode = NO_COUNT_OPCODE;
+    bc_count_interval = interval;
+
+#ifdef BC_COUNT_TIMING
+    if (interval > 0) {
+	signal(SIGPROF, bcCountSample);
+	bcCountSetTimer(interval);
+	bc_count_timing = TRUE;
+    }
+#endif
+    bc_counting = TRUE;
+
+    return R_NilValue;
+}
+
+SEXP attribute_hidden do_bccountstop(SEXP call, SEXP op, SEXP args, SEXP env)
+{
+    Rboolean was = bc_counting;
+
+    checkArity(op, args);
+#ifdef BC_COUNT_TIMING
+    if (bc_count_timing) {
+	bcCountSetTimer(0);
+	signal(SIGPROF, bcCountSampleNull);
+	bc_count_timing = FALSE;
+    }
+#endif
+    bc_counting = FALSE;
+
+    return ScalarLogical(was);
+}
+
+SEXP attribute_hidden do_bccounts(SEXP call, SEXP op, SEXP args, SEXP env)
+{
+    SEXP ans, names, funs, fnames, calls, x;
+    int i, n = bc_count_nrecs;
+    const char *anames[] = { "functions", "opcodes", "opcode.samples",
+			     "instructions", "samples", "interval" };
+    const char *cnames[] = { "call", "calls", "instructions",
+			     "self.instructions", "samples", "self.samples" };
+
+    checkArity(op, args);
+
+    PROTECT(funs = allocVector(VECSXP, 6));
+    PROTECT(fnames = allocVector(STRSXP, 6));
+    for (i = 0; i < 6; i++)
+	SET_STRING_ELT(fnames, i, mkChar(cnames[i]));
+    setAttrib(funs, R_NamesSymbol, fnames);
+    calls = allocVector(VECSXP, n);
+    SET_VECTOR_ELT(funs, 0, calls);
+    for (i = 0; i < n; i++)
+	SET_VECTOR_ELT(calls, i, VECTOR_ELT(bc_count_objs, 2 * i + 1));
+    SET_VECTOR_ELT(funs, 1, x = allocVector(REALSXP, n));
+    for (i = 0; i < n; i++) REAL(x)[i] = bc_count_recs[i].calls;
+    SET_VECTOR_ELT(funs, 2, x = allocVector(REALSXP, n));
+    for (i = 0; i < n; i++) REAL(x)[i] = bc_count_recs[i].instrs;
+    SET_VECTOR_ELT(funs, 3, x = allocVector(REALSXP, n));
+    for (i = 0; i < n; i++) REAL(x)[i] = bc_count_recs[i].selfinstrs;
+    SET_VECTOR_ELT(funs, 4, x = allocVector(INTSXP, n));
+    for (i = 0; i < n; i++) INTEGER(x)[i] = bc_count_recs[i].samples;
+    SET_VECTOR_ELT(funs, 5, x = allocVector(INTSXP, n));
+    for (i = 0; i < n; i++) INTEGER(x)[i] = bc_count_recs[i].selfsamples;
+
+    PROTECT(ans = allocVector(VECSXP, 6));
+    PROTECT(names = allocVector(STRSXP, 6));
+    for (i = 0; i < 6; i++)
+	SET_STRING_ELT(names, i, mkChar(anames[i]));
+    setAttrib(ans, R_NamesSymbol, names);
+    SET_VECTOR_ELT(ans, 0, funs);
+    SET_VECTOR_ELT(ans, 1, x = allocVector(REALSXP, OPCOUNT));
+    for (i = 0; i < OPCOUNT; i++) REAL(x)[i] = (double) bc_count_ops[i];
+    SET_VECTOR_ELT(ans, 2, x = allocVector(INTSXP, OPCOUNT));
+    for (i = 0; i < OPCOUNT; i++) INTEGER(x)[i] = bc_count_opsamples[i];
+    SET_VECTOR_ELT(ans, 3, ScalarReal((double) bc_count_instrs));
+    SET_VECTOR_ELT(ans, 4, ScalarInteger(bc_count_nsamples));
+    SET_VECTOR_ELT(ans, 5, ScalarReal(bc_count_interval));
+    UNPROTECT(4);
+    return ans;
+}
+
 /* end of byte code section */
 
 SEXP attribute_hidden do_setnumthreads(SEXP call, SEXP op, SEXP args, SEXP rho)
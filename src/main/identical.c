@@ -284,7 +284,6 @@ R_compute_identical(SEXP x, SEXP y, int flags)
 	return(x == y ? TRUE : FALSE);
     case BCODESXP:
 	return R_compute_identical(BCODE_CODE(x), BCODE_CODE(y), flags) &&
-	       R_compute_identical(BCODE_EXPR(x), BCODE_EXPR(y), flags) &&
 	       R_compute_identical(BCODE_CONSTS(x), BCODE_CONSTS(y), flags);
     case EXTPTRSXP:
 	return (EXTPTR_PTR(x) == EXTPTR_PTR(y) ? TRUE : FALSE);
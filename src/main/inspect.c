@@ -96,7 +96,7 @@ static void inspect_tree(int pre, SEXP v, int deep, int pvec) {
     if (NAMED(v)) { if (a) Rprintf(","); Rprintf("NAM(%d)",NAMED(v)); a = 1; }
 #endif
     if (REFCNT(v)) { if (a) Rprintf(","); Rprintf("REF(%d)",REFCNT(v)); a = 1; }
-    if (RDEBUG(v)) { if (a) Rprintf(","); Rprintf("DBG"); a = 1; }
+    if (RDEBUG(v) && !isVector(v)) { if (a) Rprintf(","); Rprintf("DBG"); a = 1; }
     if (RTRACE(v)) { if (a) Rprintf(","); Rprintf("TR"); a = 1; }
     if (RSTEP(v)) { if (a) Rprintf(","); Rprintf("STP"); a = 1; }
     if (IS_S4_OBJECT(v)) { if (a) Rprintf(","); Rprintf("S4"); a = 1; }
@@ -115,6 +115,18 @@ static void inspect_tree(int pre, SEXP v, int deep, int pvec) {
     case VECSXP: case STRSXP: case LGLSXP: case INTSXP: case RAWSXP:
     case REALSXP: case CPLXSXP: case EXPRSXP:
 	Rprintf("(len=%ld, tl=%ld)", XLENGTH(v), XTRUELENGTH(v));
+	if (ALTREP(v)) {
+	    /* show the class rather than the elements, which may not
+	       have been computed */
+	    Rprintf(" %s", R_altrep_class_name(v));
+	    ALTREP_INSPECT(v);
+	    Rprintf("\n");
+	    if (ATTRIB(v) != R_NilValue) {
+		pp(pre); Rprintf("ATTRIB:\n");
+		inspect_tree(pre+2, ATTRIB(v), deep, pvec);
+	    }
+	    return;
+	}
     }
     if (TYPEOF(v) == ENVSXP) /* NOTE: this is not a trivial OP since it involves looking up things
 				in the environment, so for a low-level debugging we may want to
@@ -26,8 +26,10 @@
 #include <Internal.h>
 #include <R_ext/Itermacros.h>
 
+#include "arithmetic.h"
+
 /* interval at which to check interrupts, a guess */
-// #define NINTERRUPT 10000000
+#define NINTERRUPT 10000000
 
 
 static SEXP lunary(SEXP, SEXP, SEXP);
@@ -54,7 +56,7 @@ SEXP attribute_hidden do_logic(SEXP call, SEXP op, SEXP args, SEXP env)
     if (CDR(args) == R_NilValue) { // one argument  <==>  !(arg1)
 	if (!attr1 && IS_SCALAR(arg1, LGLSXP)) {
 	    /* directly handle '!' operator for simple logical scalars. */
-	    int v = LOGICAL(arg1)[0];
+	    int v = SCALAR_LVAL(arg1);
 	    return ScalarLogical(v == NA_LOGICAL ? v : ! v);
 	}
 	return lunary(call, op, arg1);
@@ -297,10 +299,36 @@ SEXP attribute_hidden do_logic2(SEXP call, SEXP op, SEXP args, SEXP env)
     return ScalarLogical(ans);
 }
 
+/* Branch-free kernels, so that the loops can be vectorized */
+#define AND_KERNEL(X, Y) do {						\
+	int __x__ = X;							\
+	int __y__ = Y;							\
+	int __f__ = (__x__ == 0) | (__y__ == 0);			\
+	int __na__ = (__x__ == NA_LOGICAL) | (__y__ == NA_LOGICAL);	\
+	pa[i] = __f__ ? 0 : (__na__ ? NA_LOGICAL : 1);			\
+    } while (0)
+
+#define OR_KERNEL(X, Y) do {						\
+	int __x__ = X;							\
+	int __y__ = Y;							\
+	int __t__ = ((__x__ != NA_LOGICAL) & (__x__ != 0)) |		\
+	    ((__y__ != NA_LOGICAL) & (__y__ != 0));			\
+	int __f__ = (__x__ == 0) & (__y__ == 0);			\
+	pa[i] = __t__ ? 1 : (__f__ ? 0 : NA_LOGICAL);			\
+    } while (0)
+
+#define LOGIC_LOOP(KERNEL) do {						\
+	if (SIMD_ARITH_OK(n1, n2))					\
+	    SIMD_ARITH(SIMD_LOOP, int, px1, NO_CONV, int, px2, NO_CONV,	\
+		       KERNEL);						\
+	else								\
+	    MOD_ITERATE2(n, n1, n2, i, i1, i2,				\
+			 KERNEL(px1[i1], px2[i2]););			\
+    } while (0)
+
 static SEXP binaryLogic(int code, SEXP s1, SEXP s2)
 {
     R_xlen_t i, n, n1, n2, i1, i2;
-    int x1, x2;
     SEXP ans;
 
     n1 = XLENGTH(s1);
@@ -310,34 +338,25 @@ static SEXP binaryLogic(int code, SEXP s1, SEXP s2)
 	ans = allocVector(LGLSXP, 0);
 	return ans;
     }
-    ans = allocVector(LGLSXP, n);
-
+    /* Reuse an operand which is an unreferenced temporary without
+       attributes, such as the result of a comparison in x > a & y < b */
+    if (n == n1 && NO_REFERENCES(s1) && ATTRIB(s1) == R_NilValue &&
+	!ALTREP(s1))
+	ans = s1;
+    else if (n == n2 && NO_REFERENCES(s2) && ATTRIB(s2) == R_NilValue &&
+	     !ALTREP(s2))
+	ans = s2;
+    else
+	ans = allocVector(LGLSXP, n);
+
+    const int *px1 = LOGICAL_RO(s1), *px2 = LOGICAL_RO(s2);
+    int *pa = LOGICAL(ans);
     switch (code) {
     case 1:		/* & : AND */
-	MOD_ITERATE2(n, n1, n2, i, i1, i2, {
-//	    if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-	    x1 = LOGICAL(s1)[i1];
-	    x2 = LOGICAL(s2)[i2];
-	    if (x1 == 0 || x2 == 0)
-		LOGICAL(ans)[i] = 0;
-	    else if (x1 == NA_LOGICAL || x2 == NA_LOGICAL)
-		LOGICAL(ans)[i] = NA_LOGICAL;
-	    else
-		LOGICAL(ans)[i] = 1;
-	});
+	LOGIC_LOOP(AND_KERNEL);
 	break;
     case 2:		/* | : OR */
-	MOD_ITERATE2(n, n1, n2, i, i1, i2, {
-//	    if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-	    x1 = LOGICAL(s1)[i1];
-	    x2 = LOGICAL(s2)[i2];
-	    if ((x1 != NA_LOGICAL && x1) || (x2 != NA_LOGICAL && x2))
-		LOGICAL(ans)[i] = 1;
-	    else if (x1 == 0 && x2 == 0)
-		LOGICAL(ans)[i] = 0;
-	    else
-		LOGICAL(ans)[i] = NA_LOGICAL;
-	});
+	LOGIC_LOOP(OR_KERNEL);
 	break;
     case 3:
 	error(_("Unary operator `!' called with two arguments"));
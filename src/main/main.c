@@ -820,6 +820,7 @@ void setup_Rmainloop(void)
     InitStringHash(); /* must be before InitNames */
     InitBaseEnv();
     InitNames(); /* must be after InitBaseEnv to use R_EmptyEnv */
+    InitAltrep(); /* must be after InitNames to use install */
     InitGlobalEnv();
     InitDynload();
     InitOptions();
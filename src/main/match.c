@@ -180,15 +180,117 @@ SEXP attribute_hidden matchArgExact(SEXP tag, SEXP * list)
 #define SET_ARGUSED(x,v) SETLEVELS(x,v)
 
 
+/* Cache of argument matching results.
+
+   The outcome of matching depends only on the tags of the formals and
+   on the tags (or their absence) of the supplied arguments, and most
+   call sites supply the same tag pattern every time.  Successful
+   matches are therefore recorded in a small direct-mapped table,
+   indexed by the call and the formals, holding both tag sequences and
+   the formal each supplied argument went to.  Entries are validated
+   against the tag sequences on lookup, so a stale or colliding entry
+   can never give a wrong answer; symbols are never collected, so the
+   raw pointers held in the table remain valid. */
+
+#define MATCH_CACHE_SIZE 256
+#define MATCH_CACHE_MAXARGS 16
+#define MATCH_TO_DOTS -1
+
+typedef struct {
+    int nformals, nsupplied;
+    Rboolean partial;   /* some argument was matched partially */
+    SEXP ftags[MATCH_CACHE_MAXARGS];
+    SEXP stags[MATCH_CACHE_MAXARGS];
+    signed char target[MATCH_CACHE_MAXARGS]; /* formal index or MATCH_TO_DOTS */
+    char used[MATCH_CACHE_MAXARGS];          /* ARGUSED of the supplied arg */
+} R_match_cache_entry_t;
+
+static R_match_cache_entry_t R_MatchCache[MATCH_CACHE_SIZE];
+
+static R_INLINE R_match_cache_entry_t *matchCacheEntry(SEXP formals, SEXP call)
+{
+    uintptr_t key = ((uintptr_t) call >> 3) ^ ((uintptr_t) formals >> 4);
+    return R_MatchCache +
+	((key * (uintptr_t) 2654435769U) >> 8) % MATCH_CACHE_SIZE;
+}
+
+/* Returns the matched actuals if the cache has an entry for this tag
+   pattern, and NULL otherwise. */
+static SEXP matchArgsFromCache(R_match_cache_entry_t *e, SEXP formals,
+			       SEXP supplied)
+{
+    int i, nf, ns, ndots = 0;
+    signed char target[MATCH_CACHE_MAXARGS];
+    SEXP f, a, b, actuals, dots;
+
+    nf = e->nformals;
+    ns = e->nsupplied;
+    if (nf == 0 && ns == 0) return NULL; /* unused entry */
+    for (f = formals, i = 0; f != R_NilValue; f = CDR(f), i++)
+	if (i == nf || TAG(f) != e->ftags[i]) return NULL;
+    if (i != nf) return NULL;
+    for (b = supplied, i = 0; b != R_NilValue; b = CDR(b), i++)
+	if (i == ns || TAG(b) != e->stags[i]) return NULL;
+    if (i != ns) return NULL;
+    if (e->partial && R_warn_partial_match_args) return NULL;
+
+    /* Copy what is needed before allocating: a finalizer run by the
+       allocation could call matchArgs and reuse the entry. */
+    for (b = supplied, i = 0; i < ns; b = CDR(b), i++) {
+	target[i] = e->target[i];
+	SET_ARGUSED(b, e->used[i]);
+	if (target[i] == MATCH_TO_DOTS) ndots++;
+    }
+
+    actuals = R_NilValue;
+    for (i = 0; i < nf; i++) {
+	actuals = CONS_NR(R_MissingArg, actuals);
+	SET_MISSING(actuals, 1);
+    }
+    PROTECT(actuals);
+
+    dots = R_NilValue;
+    if (ndots) {
+	dots = allocList(ndots);
+	SET_TYPEOF(dots, DOTSXP);
+    }
+    for (b = supplied, i = 0, f = dots; i < ns; b = CDR(b), i++) {
+	if (target[i] == MATCH_TO_DOTS) {
+	    SETCAR(f, CAR(b));
+	    SET_TAG(f, TAG(b));
+	    f = CDR(f);
+	}
+	else {
+	    a = nthcdr(actuals, target[i]);
+	    SETCAR(a, CAR(b));
+	    if (CAR(b) != R_MissingArg) SET_MISSING(a, 0);
+	}
+    }
+    for (f = formals, a = actuals; f != R_NilValue; f = CDR(f), a = CDR(a))
+	if (TAG(f) == R_DotsSymbol) {
+	    SET_MISSING(a, 0);
+	    if (dots != R_NilValue) SETCAR(a, dots);
+	    break;
+	}
+    UNPROTECT(1);
+    return actuals;
+}
+
 /* We need to leave 'supplied' unchanged in case we call UseMethod */
 /* MULTIPLE_MATCHES was added by RI in Jan 2005 but never activated:
    code in R-2-8-branch */
 
 SEXP attribute_hidden matchArgs(SEXP formals, SEXP supplied, SEXP call)
 {
-    Rboolean seendots;
+    Rboolean seendots, partial = FALSE;
     int i, arg_i = 0;
     SEXP f, a, b, dots, actuals;
+    R_match_cache_entry_t *e = matchCacheEntry(formals, call);
+    signed char target[MATCH_CACHE_MAXARGS];
+
+    actuals = matchArgsFromCache(e, formals, supplied);
+    if (actuals != NULL)
+	return actuals;
 
     actuals = R_NilValue;
     for (f = formals ; f != R_NilValue ; f = CDR(f), arg_i++) {
@@ -241,6 +343,7 @@ SEXP attribute_hidden matchArgs(SEXP formals, SEXP supplied, SEXP call)
 		      if(CAR(b) != R_MissingArg) SET_MISSING(a, 0);
 		      SET_ARGUSED(b, 2);
 		      fargused[arg_i] = 2;
+		      if (i <= MATCH_CACHE_MAXARGS) target[i - 1] = arg_i;
 		  }
 	      }
 	    }
@@ -286,6 +389,8 @@ SEXP attribute_hidden matchArgs(SEXP formals, SEXP supplied, SEXP call)
 			if (CAR(b) != R_MissingArg) SET_MISSING(a, 0);
 			SET_ARGUSED(b, 1);
 			fargused[arg_i] = 1;
+			partial = TRUE;
+			if (i <= MATCH_CACHE_MAXARGS) target[i - 1] = arg_i;
 		    }
 		}
 	    }
@@ -306,6 +411,8 @@ SEXP attribute_hidden matchArgs(SEXP formals, SEXP supplied, SEXP call)
     a = actuals;
     b = supplied;
     seendots = FALSE;
+    arg_i = 0;
+    i = 0;
 
     while (f != R_NilValue && b != R_NilValue && !seendots) {
 	if (TAG(f) == R_DotsSymbol) {
@@ -313,11 +420,13 @@ SEXP attribute_hidden matchArgs(SEXP formals, SEXP supplied, SEXP call)
 	    seendots = TRUE;
 	    f = CDR(f);
 	    a = CDR(a);
+	    arg_i++;
 	} else if (CAR(a) != R_MissingArg) {
 	    /* Already matched by tag */
 	    /* skip to next formal */
 	    f = CDR(f);
 	    a = CDR(a);
+	    arg_i++;
 	} else if (ARGUSED(b) || TAG(b) != R_NilValue) {
 	    /* This value used or tagged , skip to next value */
 	    /* The second test above is needed because we */
@@ -325,14 +434,18 @@ SEXP attribute_hidden matchArgs(SEXP formals, SEXP supplied, SEXP call)
 	    /* matches. */
 	    /* The formal being considered remains the same */
 	    b = CDR(b);
+	    i++;
 	} else {
 	    /* We have a positional match */
 	    SETCAR(a, CAR(b));
 	    if(CAR(b) != R_MissingArg) SET_MISSING(a, 0);
 	    SET_ARGUSED(b, 1);
+	    if (i < MATCH_CACHE_MAXARGS) target[i] = arg_i;
 	    b = CDR(b);
 	    f = CDR(f);
 	    a = CDR(a);
+	    arg_i++;
+	    i++;
 	}
     }
 
@@ -394,6 +507,23 @@ SEXP attribute_hidden matchArgs(SEXP formals, SEXP supplied, SEXP call)
 		      strchr(CHAR(asChar(deparse1line(unusedForError, 0))), '('));
 	}
     }
+
+    /* Record the match for the next call with this tag pattern */
+    int nf = length(formals), ns = length(supplied);
+    if (nf <= MATCH_CACHE_MAXARGS && ns <= MATCH_CACHE_MAXARGS &&
+	nf + ns > 0) {
+	e->nformals = nf;
+	e->nsupplied = ns;
+	e->partial = partial;
+	for (f = formals, i = 0; f != R_NilValue; f = CDR(f), i++)
+	    e->ftags[i] = TAG(f);
+	for (b = supplied, i = 0; b != R_NilValue; b = CDR(b), i++) {
+	    e->stags[i] = TAG(b);
+	    e->used[i] = (char) ARGUSED(b);
+	    if (!ARGUSED(b)) target[i] = MATCH_TO_DOTS;
+	    e->target[i] = target[i];
+	}
+    }
     UNPROTECT(1);
     return(actuals);
 }
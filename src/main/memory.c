@@ -110,6 +110,18 @@ extern void *Rm_realloc(void * p, size_t n);
 static int gc_reporting = 0;
 static int gc_count = 0;
 
+/* Totals for the time spent in collections, and in the phases of a
+   collection, while gc.time() timing is enabled */
+#define NUM_GC_PHASES 3
+static double gctimes[5], gcstarttimes[5];
+static double gcphasetimes[NUM_GC_PHASES], gcphasestart;
+static Rboolean gctime_enabled = FALSE;
+
+/* Number of collections recorded by gctrace(), and bytes promoted
+   since the last recorded collection while tracing */
+static int gc_trace_size = 0;
+static double gc_promoted_bytes = 0;
+
 /* These are used in profiling to separate out time in GC */
 int R_gc_running() { return R_in_gc; }
 
@@ -342,6 +354,22 @@ static double R_VGrowIncrFrac = 0.2, R_VShrinkIncrFrac = 0.2;
 static int R_VGrowIncrMin = 80000, R_VShrinkIncrMin = 0;
 #endif
 
+/* Pause Time Targets.  If the environment variable
+   R_GC_TARGET_PAUSE_MS is set, the heap sizes are instead adjusted
+   after every collection so that collections take about that long.
+   The pause of a collection is taken to be proportional to the number
+   of nodes surviving it, and the number of nodes surviving a level 0
+   collection proportional to the number allocated since the previous
+   one.  The cost per surviving node and the survival rate of new nodes
+   are estimated from recent collections, and give the free node space
+   that would produce the target pause.  The free space changes by at
+   most a factor of two at each adjustment, and the heaps are kept
+   within the minimal and maximal sizes.  The vector heap is set to the
+   same occupancy as the node heap. */
+static double R_GCTargetPause = 0.0; /* seconds; 0 to disable */
+static double gc_pause_time = 0.0, gc_pause_survivors = 0.0;
+static double gc_new_allocated = 0.0, gc_new_survivors = 0.0;
+
 static void init_gc_grow_settings()
 {
     char *arg;
@@ -396,6 +424,12 @@ static void init_gc_grow_settings()
 	if (0.05 <= frac && frac <= 0.80)
 	    R_VGrowIncrFrac = frac;
     }
+    arg = getenv("R_GC_TARGET_PAUSE_MS");
+    if (arg != NULL) {
+	double ms = atof(arg);
+	if (ms > 0)
+	    R_GCTargetPause = ms / 1000.0;
+    }
 }
 
 /* Maximal Heap Limits.  These variables contain upper limits on the
@@ -439,7 +473,8 @@ void attribute_hidden R_SetPPSize(R_size_t size)
 /* Miscellaneous Globals. */
 
 static SEXP R_VStack = NULL;		/* R_alloc stack pointer */
-static SEXP R_PreciousList = NULL;      /* List of Persistent Objects */
+static SEXP R_PreciousList = NULL;      /* Table of Persistent Objects */
+static R_size_t R_PreciousCount = 0;    /* Number of Persistent Objects */
 static R_size_t R_LargeVallocSize = 0;
 static R_size_t R_SmallVallocSize = 0;
 static R_size_t orig_R_NSize;
@@ -554,6 +589,7 @@ static struct {
     SEXPREC OldToNewPeg[NUM_OLD_GENERATIONS];
 #endif
     int OldCount[NUM_OLD_GENERATIONS], AllocCount, PageCount;
+    int Allocated; /* nodes allocated since the last collection */
     PAGE_HEADER *pages;
 } R_GenHeap[NUM_NODE_CLASSES];
 
@@ -637,20 +673,26 @@ static R_size_t R_NodesInUse = 0;
   case BUILTINSXP: \
   case SPECIALSXP: \
   case CHARSXP: \
+  case WEAKREFSXP: \
+  case S4SXP: \
+    break; \
   case LGLSXP: \
   case INTSXP: \
   case REALSXP: \
   case CPLXSXP: \
-  case WEAKREFSXP: \
   case RAWSXP: \
-  case S4SXP: \
-    break; \
   case STRSXP: \
   case EXPRSXP: \
   case VECSXP: \
-    { \
+    if (ALTREP(__n__)) { \
+      dc__action__(TAG(__n__), dc__extra__); \
+      dc__action__(CAR(__n__), dc__extra__); \
+      dc__action__(CDR(__n__), dc__extra__); \
+    } \
+    else if (TYPEOF(__n__) == STRSXP || TYPEOF(__n__) == EXPRSXP || \
+	     TYPEOF(__n__) == VECSXP) { \
       R_xlen_t i; \
-      for (i = 0; i < XLENGTH(__n__); i++) \
+      for (i = 0; i < STDVEC_LENGTH(__n__); i++) \
 	dc__action__(VECTOR_ELT(__n__, i), dc__extra__); \
     } \
     break; \
@@ -713,15 +755,55 @@ static R_size_t R_NodesInUse = 0;
 #endif
 
 
+/* Allocation Buffers.  Nodes of the small node classes are taken
+   from the free list of the class if it is not empty.  Otherwise
+   they are carved out of the current page of the class's allocation
+   buffer by bumping a pointer; a new page only becomes the buffer's
+   page when the old one is used up.
+
+   Nodes allocated from a buffer are not linked into New space;
+   instead their links point to the node itself, so they can be
+   unsnapped like any other node when the collector forwards them.  At
+   the start of a collection the unused part of each buffer page is
+   added to New space as free nodes; the unreachable buffer-allocated
+   nodes are moved to New space by the sweep (see Lazy Sweeping
+   below). */
+
+static struct {
+    char *next, *end;
+    int node_size;
+} R_AllocBuffer[NUM_SMALL_NODE_CLASSES];
+
+static PAGE_HEADER *BufferPagesSwept[NUM_SMALL_NODE_CLASSES];
+
+static Rboolean SweepPages(int node_class);
+static void GetNewPage(int node_class);
+
+#define BUFFER_IS_EMPTY(c) (R_AllocBuffer[c].next == R_AllocBuffer[c].end)
+
+#define BUFFER_GET_NODE(c,s) do { \
+  SEXP bg__n__ = (SEXP) R_AllocBuffer[c].next; \
+  R_AllocBuffer[c].next += R_AllocBuffer[c].node_size; \
+  SET_NEXT_NODE(bg__n__, bg__n__); \
+  SET_PREV_NODE(bg__n__, bg__n__); \
+  (s) = bg__n__; \
+} while (0)
+
+
 /* Node Allocation. */
 
 #define CLASS_GET_FREE_NODE(c,s) do { \
   SEXP __n__ = R_GenHeap[c].Free; \
-  if (__n__ == R_GenHeap[c].New) { \
-    GetNewPage(c); \
+  if (__n__ == R_GenHeap[c].New && BUFFER_IS_EMPTY(c)) { \
+    if (! SweepPages(c)) \
+      GetNewPage(c); \
     __n__ = R_GenHeap[c].Free; \
   } \
-  R_GenHeap[c].Free = NEXT_NODE(__n__); \
+  if (__n__ == R_GenHeap[c].New) \
+    BUFFER_GET_NODE(c, __n__); \
+  else \
+    R_GenHeap[c].Free = NEXT_NODE(__n__); \
+  R_GenHeap[c].Allocated++; \
   R_NodesInUse++; \
   (s) = __n__; \
 } while (0)
@@ -732,17 +814,25 @@ static R_size_t R_NodesInUse = 0;
 /* versions that assume nodes are avaialble without adding a new page */
 #define CLASS_QUICK_GET_FREE_NODE(c,s) do {		\
 	SEXP __n__ = R_GenHeap[c].Free;			\
-	if (__n__ == R_GenHeap[c].New)			\
-	    error("need new page - should not happen");	\
-	R_GenHeap[c].Free = NEXT_NODE(__n__);		\
+	if (__n__ == R_GenHeap[c].New) {		\
+	    if (BUFFER_IS_EMPTY(c))			\
+		error("need new page - should not happen"); \
+	    BUFFER_GET_NODE(c, __n__);			\
+	}						\
+	else						\
+	    R_GenHeap[c].Free = NEXT_NODE(__n__);	\
+	R_GenHeap[c].Allocated++;			\
 	R_NodesInUse++;					\
 	(s) = __n__;					\
     } while (0)
 
 #define QUICK_GET_FREE_NODE(s) CLASS_QUICK_GET_FREE_NODE(0,s)
 
-/* QUICK versions can be used if (CLASS_)NEED_NEW_PAGE returns FALSE */
-#define CLASS_NEED_NEW_PAGE(c) (R_GenHeap[c].Free == R_GenHeap[c].New)
+/* QUICK versions can be used if (CLASS_)NEED_NEW_PAGE returns FALSE.
+   NEED_NEW_PAGE may return TRUE when sweeping would have found free
+   nodes. */
+#define CLASS_NEED_NEW_PAGE(c) \
+    (R_GenHeap[c].Free == R_GenHeap[c].New && BUFFER_IS_EMPTY(c))
 #define NEED_NEW_PAGE() CLASS_NEED_NEW_PAGE(0)
 
 
@@ -862,12 +952,14 @@ static void DEBUG_RELEASE_PRINT(int rel_pages, int maxrel_pages, int i)
 
 /* Page Allocation and Release. */
 
+/* Allocate a new page for a node class and make it the page of the
+   class's allocation buffer.  The nodes of the page are initialized
+   as they are allocated, or by FlushAllocBuffers. */
 static void GetNewPage(int node_class)
 {
-    SEXP s, base;
     char *data;
     PAGE_HEADER *page;
-    int node_size, page_count, i;  // FIXME: longer type?
+    int node_size, page_count;  // FIXME: longer type?
 
     node_size = NODE_SIZE(node_class);
     page_count = (R_PAGE_SIZE - sizeof(PAGE_HEADER)) / node_size;
@@ -885,25 +977,136 @@ static void GetNewPage(int node_class)
     page->next = R_GenHeap[node_class].pages;
     R_GenHeap[node_class].pages = page;
     R_GenHeap[node_class].PageCount++;
+    R_GenHeap[node_class].AllocCount += page_count;
 
     data = PAGE_DATA(page);
-    base = R_GenHeap[node_class].New;
-    for (i = 0; i < page_count; i++, data += node_size) {
-	s = (SEXP) data;
-	R_GenHeap[node_class].AllocCount++;
-	SNAP_NODE(s, base);
+    R_AllocBuffer[node_class].next = data;
+    R_AllocBuffer[node_class].end = data + page_count * node_size;
+    R_AllocBuffer[node_class].node_size = node_size;
+}
+
+/* Add the unused nodes of the allocation buffers to New space as free
+   nodes.  This has to be done before a collection looks at the pages. */
+static void FlushAllocBuffers(void)
+{
+    SEXP s;
+    int i;
+
+    for (i = 0; i < NUM_SMALL_NODE_CLASSES; i++) {
+	char *data = R_AllocBuffer[i].next;
+	char *end = R_AllocBuffer[i].end;
+	int node_size = R_AllocBuffer[i].node_size;
+
+	for (; data < end; data += node_size) {
+	    s = (SEXP) data;
+	    SNAP_NODE(s, R_GenHeap[i].New);
 #if  VALGRIND_LEVEL > 1
-	if (NodeClassSize[node_class] > 0)
-	    VALGRIND_MAKE_MEM_NOACCESS(DATAPTR(s), NodeClassSize[node_class]*sizeof(VECREC));
+	    if (NodeClassSize[i] > 0)
+		VALGRIND_MAKE_MEM_NOACCESS(DATAPTR(s), NodeClassSize[i]*sizeof(VECREC));
 #endif
-	s->sxpinfo = UnmarkedNodeTemplate.sxpinfo;
-	INIT_REFCNT(s);
-	SET_NODE_CLASS(s, node_class);
+	    s->sxpinfo = UnmarkedNodeTemplate.sxpinfo;
+	    INIT_REFCNT(s);
+	    SET_NODE_CLASS(s, i);
 #ifdef PROTECTCHECK
-	TYPEOF(s) = NEWSXP;
+	    TYPEOF(s) = NEWSXP;
 #endif
-	base = s;
-	R_GenHeap[node_class].Free = s;
+	}
+	R_AllocBuffer[i].next = R_AllocBuffer[i].end = NULL;
+    }
+}
+
+/* Lazy Sweeping.  After a collection the pages that may contain
+   unreachable nodes not yet in New space are swept incrementally:
+   when a class has no free nodes left the allocator calls SweepPages
+   to sweep pages of that class until some free nodes are found, and
+   only allocates a new page if there are no pages left to sweep.  Any
+   sweeping still pending when the next collection starts is finished
+   by FinishSweep.
+
+   After a full collection all pages are swept, and the free list is
+   rebuilt from scratch.  This sorts the free list, which improves
+   locality of reference by placing nodes on the same page together
+   and ordering nodes within pages.  Doing this at least occasionally
+   does seem essential; sorting on each full collection is probably
+   sufficient.  After other collections only pages added since the
+   previous collection need to be swept, for buffer-allocated nodes
+   that were not reached.  BufferPagesSwept records the first page
+   that does not need to be.
+
+   Nodes on pages waiting to be swept are unmarked and their links
+   may be stale, so nothing other than the sweep may look at them. */
+
+#define SORT_NODES
+
+static struct {
+    PAGE_HEADER *next, *end;
+} R_SweepPages[NUM_SMALL_NODE_CLASSES];
+
+static Rboolean R_SweepAll = FALSE;
+
+static void SweepPage(PAGE_HEADER *page, int node_class)
+{
+    SEXP s;
+    int node_size = NODE_SIZE(node_class);
+    int page_count = (R_PAGE_SIZE - sizeof(PAGE_HEADER)) / node_size;
+    char *data = PAGE_DATA(page);
+    int j;
+
+    for (j = 0; j < page_count; j++, data += node_size) {
+	s = (SEXP) data;
+	if (! NODE_IS_MARKED(s) && (R_SweepAll || NEXT_NODE(s) == s))
+	    SNAP_NODE(s, R_GenHeap[node_class].New);
+    }
+}
+
+/* Sweep pages of a node class until there are free nodes; returns
+   FALSE if all pages have been swept and there still are none. */
+static Rboolean SweepPages(int node_class)
+{
+    SEXP New = R_GenHeap[node_class].New;
+    SEXP last = PREV_NODE(New);
+
+    while (R_SweepPages[node_class].next != R_SweepPages[node_class].end) {
+	PAGE_HEADER *page = R_SweepPages[node_class].next;
+	R_SweepPages[node_class].next = page->next;
+	SweepPage(page, node_class);
+	if (NEXT_NODE(last) != New) {
+	    if (R_GenHeap[node_class].Free == New)
+		R_GenHeap[node_class].Free = NEXT_NODE(last);
+	    return TRUE;
+	}
+    }
+    return FALSE;
+}
+
+static void FinishSweep(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_SMALL_NODE_CLASSES; i++)
+	while (SweepPages(i));
+}
+
+static void StartSweep(Rboolean full)
+{
+    int i;
+
+#ifdef SORT_NODES
+    R_SweepAll = full;
+#else
+    R_SweepAll = FALSE;
+#endif
+    for (i = 0; i < NUM_SMALL_NODE_CLASSES; i++) {
+	if (R_SweepAll) {
+	    SET_NEXT_NODE(R_GenHeap[i].New, R_GenHeap[i].New);
+	    SET_PREV_NODE(R_GenHeap[i].New, R_GenHeap[i].New);
+	    R_SweepPages[i].end = NULL;
+	}
+	else
+	    R_SweepPages[i].end = BufferPagesSwept[i];
+	R_SweepPages[i].next = R_GenHeap[i].pages;
+	R_GenHeap[i].Free = NEXT_NODE(R_GenHeap[i].New);
+	BufferPagesSwept[i] = R_GenHeap[i].pages;
     }
 }
 
@@ -962,6 +1165,8 @@ static void TryToReleasePages(void)
 		    }
 		}
 		if (! in_use) {
+		    if (page == BufferPagesSwept[i])
+			BufferPagesSwept[i] = next;
 		    ReleasePage(page, i);
 		    if (last == NULL)
 			R_GenHeap[i].pages = next;
@@ -980,46 +1185,326 @@ static void TryToReleasePages(void)
     else release_count--;
 }
 
-/* compute size in VEC units so result will fit in LENGTH field for FREESXPs */
-static R_INLINE R_size_t getVecSizeInVEC(SEXP s)
+/* size in bytes of the data of a vector of length n */
+static R_INLINE R_size_t getVecBytes(SEXP s, R_xlen_t n)
 {
-    if (IS_GROWABLE(s))
-	SETLENGTH(s, XTRUELENGTH(s));
-
     R_size_t size;
-    switch (TYPEOF(s)) {	/* get size in bytes */
+    switch (TYPEOF(s)) {
     case CHARSXP:
-	size = XLENGTH(s) + 1;
+	size = n + 1;
 	break;
     case RAWSXP:
-	size = XLENGTH(s);
+	size = n;
 	break;
     case LGLSXP:
     case INTSXP:
-	size = XLENGTH(s) * sizeof(int);
+	size = n * sizeof(int);
 	break;
     case REALSXP:
-	size = XLENGTH(s) * sizeof(double);
+	size = n * sizeof(double);
 	break;
     case CPLXSXP:
-	size = XLENGTH(s) * sizeof(Rcomplex);
+	size = n * sizeof(Rcomplex);
 	break;
     case STRSXP:
     case EXPRSXP:
     case VECSXP:
-	size = XLENGTH(s) * sizeof(SEXP);
+	size = n * sizeof(SEXP);
 	break;
     default:
 	register_bad_sexp_type(s, __LINE__);
 	size = 0;
     }
-    return BYTE2VEC(size);
+    return size;
+}
+
+/* compute size in VEC units so result will fit in LENGTH field for FREESXPs */
+static R_INLINE R_size_t getVecSizeInVEC(SEXP s)
+{
+    if (IS_GROWABLE(s))
+	SETLENGTH(s, XTRUELENGTH(s));
+    return BYTE2VEC(getVecBytes(s, XLENGTH(s)));
+}
+
+/* size in bytes of a live node, for statistics */
+static R_size_t NodeBytes(SEXP s)
+{
+    int node_class = NODE_CLASS(s);
+    if (node_class < NUM_SMALL_NODE_CLASSES)
+	return NODE_SIZE(node_class);
+    else
+	return sizeof(SEXPREC_ALIGN) +
+	    getVecBytes(s, IS_GROWABLE(s) ? XTRUELENGTH(s) : XLENGTH(s));
 }
 
 static void custom_node_free(void *ptr);
 
+/* Memory-mapped large vectors.  Vectors of at least R_MmapVecMin bytes
+   (set by the environment variable R_MMAP_VEC_MIN; 0, the default,
+   disables this) are allocated by mmap_allocator, a built-in custom
+   allocator that maps anonymous memory.  Unlike other custom
+   allocations their size counts towards the vector heap.  Mappings
+   are aligned to huge pages and, where supported, the kernel is
+   advised to back them with transparent huge pages.
+
+   Up to MMAP_CACHE_SIZE freed mappings are kept for reuse by later
+   allocations that fit in them and are in the same size class, so a
+   small vector does not hold on to a large address range.  The
+   classes are powers of two in huge pages.  The pages of cached
+   mappings are discarded with MADV_DONTNEED, which returns the memory
+   to the system but keeps the address range.  The length of a mapping
+   and the size of the vector using it are recorded in a header at its
+   start. */
+
+#if defined(HAVE_MMAP) && ! defined(Win32)
+# define MMAP_LARGE_VECTORS
+#endif
+
+static R_size_t R_MmapVecMin = 0;
+static R_size_t R_MmapBytes = 0; /* used by vectors in mappings */
+
+#ifdef MMAP_LARGE_VECTORS
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define MMAP_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define MMAP_HEADER_SIZE sizeof(SEXPREC_ALIGN)
+#define MMAP_CACHE_SIZE 4
+
+typedef struct {
+    size_t len;  /* length of the mapping */
+    size_t size; /* bytes requested by the vector */
+} mmap_header_t;
+
+static struct {
+    void *base;
+    size_t len;
+} mmap_cache[MMAP_CACHE_SIZE];
+
+static int mmap_size_class(size_t len)
+{
+    int sizeclass = 0;
+    for (len /= MMAP_HUGE_PAGE_SIZE; len > 1; len >>= 1)
+	sizeclass++;
+    return sizeclass;
+}
+
+static void *mmap_alloc(R_allocator_t *allocator, size_t size)
+{
+    size_t len, best = MMAP_CACHE_SIZE;
+    mmap_header_t *header;
+    char *base;
+    int i, sizeclass;
+
+    len = (size + MMAP_HEADER_SIZE + MMAP_HUGE_PAGE_SIZE - 1) &
+	~((size_t) MMAP_HUGE_PAGE_SIZE - 1);
+    sizeclass = mmap_size_class(len);
+    for (i = 0; i < MMAP_CACHE_SIZE; i++)
+	if (mmap_cache[i].base != NULL && mmap_cache[i].len >= len &&
+	    mmap_size_class(mmap_cache[i].len) == sizeclass &&
+	    (best == MMAP_CACHE_SIZE ||
+	     mmap_cache[i].len < mmap_cache[best].len))
+	    best = i;
+    if (best < MMAP_CACHE_SIZE) {
+	base = mmap_cache[best].base;
+	len = mmap_cache[best].len;
+	mmap_cache[best].base = NULL;
+    }
+    else {
+	/* over-allocate so the mapping can be aligned to a huge page */
+	size_t maplen = len + MMAP_HUGE_PAGE_SIZE, head;
+	char *map = mmap(NULL, maplen, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+	    return NULL;
+	base = (char *) (((uintptr_t) map + MMAP_HUGE_PAGE_SIZE - 1) &
+			 ~((uintptr_t) MMAP_HUGE_PAGE_SIZE - 1));
+	head = base - map;
+	if (head > 0)
+	    munmap(map, head);
+	if (maplen - head > len)
+	    munmap(base + len, maplen - head - len);
+#ifdef MADV_HUGEPAGE
+	madvise(base, len, MADV_HUGEPAGE);
+#endif
+    }
+    header = (mmap_header_t *) base;
+    header->len = len;
+    header->size = size;
+    R_MmapBytes += size;
+    return base + MMAP_HEADER_SIZE;
+}
+
+static void mmap_free(R_allocator_t *allocator, void *ptr)
+{
+    char *base = (char *) ptr - MMAP_HEADER_SIZE;
+    mmap_header_t *header = (mmap_header_t *) base;
+    size_t len = header->len;
+    int i;
+
+    R_MmapBytes -= header->size;
+    for (i = 0; i < MMAP_CACHE_SIZE; i++)
+	if (mmap_cache[i].base == NULL) {
+	    madvise(base, len, MADV_DONTNEED);
+	    mmap_cache[i].base = base;
+	    mmap_cache[i].len = len;
+	    return;
+	}
+    munmap(base, len);
+}
+
+static R_allocator_t mmap_allocator = { mmap_alloc, mmap_free, NULL, NULL };
+
+/* mapped allocations count towards the vector heap */
+# define IS_HEAP_ALLOCATOR(a) ((a) == NULL || (a)->mem_alloc == mmap_alloc)
+#else
+# define IS_HEAP_ALLOCATOR(a) ((a) == NULL)
+#endif
+
+static void init_mmap_vec_min(void)
+{
+    char *arg = getenv("R_MMAP_VEC_MIN");
+    if (arg != NULL) {
+	int ierr;
+	R_size_t value = R_Decode2Long(arg, &ierr);
+	if (ierr == 0)
+	    R_MmapVecMin = value;
+    }
+}
+
+/* Background Release.  Freeing a large vector allocation usually
+   returns its memory to the system, which takes time proportional to
+   the size of the allocation.  Where threads are available, large
+   allocations obtained from malloc are not freed during the collection
+   but queued for a thread that frees them.  The queue is linked
+   through the first word of the allocations.  R_gc_full waits for the
+   queue to be emptied, so allocations retried after it see the memory
+   returned. */
+
+/* FIXME: This should be done wih a proper configure test, also making
+   sure that the pthreads library is linked in (see eval.c) */
+#if (defined(__APPLE__) || defined(_REENTRANT) || defined(HAVE_OPENMP)) && \
+     ! defined(HAVE_PTHREAD)
+# define HAVE_PTHREAD
+#endif
+#if defined(HAVE_PTHREAD) && ! defined(Win32) && ! defined(PROTECTCHECK)
+# define BACKGROUND_RELEASE
+#endif
+
+#ifdef BACKGROUND_RELEASE
+#include <pthread.h>
+
+/* smaller allocations are cheap enough to free in the collector */
+#define BG_RELEASE_MIN_BYTES (1 << 20)
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond; /* signalled when the queue or busy change */
+    void *queue;         /* allocations waiting to be freed */
+    Rboolean busy;       /* the thread is freeing allocations */
+    Rboolean started;
+} bg_release = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+		 NULL, FALSE, FALSE };
+
+static void free_release_list(void *p)
+{
+    while (p != NULL) {
+	void *next = *(void **) p;
+	free(p);
+	p = next;
+    }
+}
+
+static void *bg_release_thread(void *arg)
+{
+    pthread_mutex_lock(&bg_release.lock);
+    for (;;) {
+	while (bg_release.queue == NULL)
+	    pthread_cond_wait(&bg_release.cond, &bg_release.lock);
+	void *p = bg_release.queue;
+	bg_release.queue = NULL;
+	bg_release.busy = TRUE;
+	pthread_mutex_unlock(&bg_release.lock);
+	free_release_list(p);
+	pthread_mutex_lock(&bg_release.lock);
+	bg_release.busy = FALSE;
+	pthread_cond_broadcast(&bg_release.cond);
+    }
+    return NULL;
+}
+
+/* The thread does not exist in a forked child, and the condition
+   variable may still record it as waiting, so both synchronization
+   objects are re-initialized.  Allocations still queued are freed by
+   the child itself. */
+static void bg_release_prepare(void) { pthread_mutex_lock(&bg_release.lock); }
+static void bg_release_parent(void) { pthread_mutex_unlock(&bg_release.lock); }
+static void bg_release_child(void)
+{
+    bg_release.started = FALSE;
+    bg_release.busy = FALSE;
+    pthread_mutex_init(&bg_release.lock, NULL);
+    pthread_cond_init(&bg_release.cond, NULL);
+}
+
+static void start_bg_release(void)
+{
+    static Rboolean failed = FALSE;
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    if (bg_release.started || failed) return;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, bg_release_thread, NULL) == 0) {
+	static Rboolean registered = FALSE;
+	if (! registered) {
+	    pthread_atfork(bg_release_prepare, bg_release_parent,
+			   bg_release_child);
+	    registered = TRUE;
+	}
+	bg_release.started = TRUE;
+    }
+    else failed = TRUE;
+    pthread_attr_destroy(&attr);
+}
+
+/* queue the list of allocations from first to last for release */
+static void bg_release_list(void *first, void *last)
+{
+    start_bg_release();
+    if (! bg_release.started) {
+	free_release_list(first);
+	return;
+    }
+    pthread_mutex_lock(&bg_release.lock);
+    *(void **) last = bg_release.queue;
+    bg_release.queue = first;
+    pthread_cond_broadcast(&bg_release.cond);
+    pthread_mutex_unlock(&bg_release.lock);
+}
+
+static void WaitForBackgroundRelease(void)
+{
+    if (! bg_release.started) {
+	free_release_list(bg_release.queue);
+	bg_release.queue = NULL;
+	return;
+    }
+    pthread_mutex_lock(&bg_release.lock);
+    while (bg_release.queue != NULL || bg_release.busy)
+	pthread_cond_wait(&bg_release.cond, &bg_release.lock);
+    pthread_mutex_unlock(&bg_release.lock);
+}
+#endif
+
 static void ReleaseLargeFreeVectors()
 {
+#ifdef BACKGROUND_RELEASE
+    void *first = NULL, *last = NULL;
+#endif
     for (int node_class = CUSTOM_NODE_CLASS; node_class <= LARGE_NODE_CLASS; node_class++) {
 	SEXP s = NEXT_NODE(R_GenHeap[node_class].New);
 	while (s != R_GenHeap[node_class].New) {
@@ -1038,34 +1523,79 @@ static void ReleaseLargeFreeVectors()
 		UNSNAP_NODE(s);
 		R_GenHeap[node_class].AllocCount--;
 		if (node_class == LARGE_NODE_CLASS) {
+		    void *mem = s;
 		    R_LargeVallocSize -= size;
 #ifdef LONG_VECTOR_SUPPORT
 		    if (IS_LONG_VEC(s))
-			free(((char *) s) - sizeof(R_long_vec_hdr_t));
+			mem = ((char *) s) - sizeof(R_long_vec_hdr_t);
+#endif
+#ifdef BACKGROUND_RELEASE
+		    if (size * sizeof(VECREC) >= BG_RELEASE_MIN_BYTES) {
+			*(void **) mem = first;
+			first = mem;
+			if (last == NULL) last = mem;
+		    }
 		    else
-			free(s);
-#else
-		    free(s);
 #endif
+		    free(mem);
 		} else {
+		    void *mem = s;
 #ifdef LONG_VECTOR_SUPPORT
 		    if (IS_LONG_VEC(s))
-			custom_node_free(((char *) s) - sizeof(R_long_vec_hdr_t));
-		    else
-			custom_node_free(s);
-#else
-		    custom_node_free(s);
+			mem = ((char *) s) - sizeof(R_long_vec_hdr_t);
 #endif
+		    if (IS_HEAP_ALLOCATOR(((R_allocator_t *) mem) - 1))
+			R_LargeVallocSize -= size;
+		    custom_node_free(mem);
 		}
 	    }
 	    s = next;
 	}
     }
+#ifdef BACKGROUND_RELEASE
+    if (first != NULL)
+	bg_release_list(first, last);
+#endif
 }
 
 
 /* Heap Size Adjustment. */
 
+/* set the heap sizes for the target pause, if there is one and there
+   are estimates for it; returns TRUE if the sizes were set */
+static Rboolean AdjustHeapSizeForPause(R_size_t size_needed)
+{
+    R_size_t R_MinNFree = (R_size_t)(orig_R_NSize * R_MinFreeFrac);
+    R_size_t R_MinVFree = (R_size_t)(orig_R_VSize * R_MinFreeFrac);
+    R_size_t NNeeded = R_NodesInUse + R_MinNFree;
+    R_size_t VNeeded = R_SmallVallocSize + R_LargeVallocSize
+	+ size_needed + R_MinVFree;
+    double cost, survival, nfree, oldfree, nsize, vsize;
+
+    if (R_GCTargetPause <= 0 || gc_pause_survivors <= 0 ||
+	gc_new_allocated <= 0 || gc_new_survivors <= 0)
+	return FALSE;
+
+    cost = gc_pause_time / gc_pause_survivors;
+    survival = gc_new_survivors / gc_new_allocated;
+    nfree = R_GCTargetPause / (cost * survival);
+    oldfree = R_NSize > NNeeded ? R_NSize - NNeeded : R_MinNFree;
+    if (nfree > 2 * oldfree) nfree = 2 * oldfree;
+    if (nfree < 0.5 * oldfree) nfree = 0.5 * oldfree;
+    nsize = NNeeded + nfree;
+    if (nsize > R_MaxNSize) nsize = R_MaxNSize;
+    if (nsize < orig_R_NSize) nsize = orig_R_NSize;
+    R_NSize = (R_size_t) nsize;
+
+    vsize = VNeeded * (nsize / NNeeded);
+    if (vsize > R_MaxVSize) vsize = R_MaxVSize;
+    if (vsize < orig_R_VSize) vsize = orig_R_VSize;
+    R_VSize = (R_size_t) vsize;
+
+    DEBUG_ADJUST_HEAP_PRINT(NNeeded / nsize, VNeeded / vsize);
+    return TRUE;
+}
+
 static void AdjustHeapSize(R_size_t size_needed)
 {
     R_size_t R_MinNFree = (R_size_t)(orig_R_NSize * R_MinFreeFrac);
@@ -1076,6 +1606,9 @@ static void AdjustHeapSize(R_size_t size_needed)
     double node_occup = ((double) NNeeded) / R_NSize;
     double vect_occup =	((double) VNeeded) / R_VSize;
 
+    if (AdjustHeapSizeForPause(size_needed))
+	return;
+
     if (node_occup > R_NGrowFrac) {
 	R_size_t change = (R_size_t)(R_NGrowIncrMin + R_NGrowIncrFrac * R_NSize);
 	if (R_MaxNSize >= R_NSize + change)
@@ -1136,6 +1669,8 @@ static void AgeNodeAndChildren(SEXP s, int gen)
 	    REprintf("****snapping into wrong generation\n");
 	SNAP_NODE(s, R_GenHeap[NODE_CLASS(s)].Old[gen]);
 	R_GenHeap[NODE_CLASS(s)].OldCount[gen]++;
+	if (gc_trace_size > 0)
+	    gc_promoted_bytes += NodeBytes(s);
 	DO_CHILDREN(s, AGE_NODE, gen);
     }
 }
@@ -1169,44 +1704,6 @@ static void old_to_new(SEXP x, SEXP y)
   if (NODE_IS_OLDER(CHK(x), CHK(y))) old_to_new(x,y);  } while (0)
 
 
-/* Node Sorting.  SortNodes attempts to improve locality of reference
-   by rearranging the free list to place nodes on the same place page
-   together and order nodes within pages.  This involves a sweep of the
-   heap, so it should not be done too often, but doing it at least
-   occasionally does seem essential.  Sorting on each full colllection is
-   probably sufficient.
-*/
-
-#define SORT_NODES
-#ifdef SORT_NODES
-static void SortNodes(void)
-{
-    SEXP s;
-    int i;
-
-    for (i = 0; i < NUM_SMALL_NODE_CLASSES; i++) {
-	PAGE_HEADER *page;
-	int node_size = NODE_SIZE(i);
-	int page_count = (R_PAGE_SIZE - sizeof(PAGE_HEADER)) / node_size;
-
-	SET_NEXT_NODE(R_GenHeap[i].New, R_GenHeap[i].New);
-	SET_PREV_NODE(R_GenHeap[i].New, R_GenHeap[i].New);
-	for (page = R_GenHeap[i].pages; page != NULL; page = page->next) {
-	    int j;
-	    char *data = PAGE_DATA(page);
-
-	    for (j = 0; j < page_count; j++, data += node_size) {
-		s = (SEXP) data;
-		if (! NODE_IS_MARKED(s))
-		    SNAP_NODE(s, R_GenHeap[i].New);
-	    }
-	}
-	R_GenHeap[i].Free = NEXT_NODE(R_GenHeap[i].New);
-    }
-}
-#endif
-
-
 /* Finalization and Weak References */
 
 /* The design of this mechanism is very close to the one described in
@@ -1514,10 +2011,471 @@ SEXP attribute_hidden do_regFinaliz(SEXP call, SEXP op, SEXP args, SEXP rho)
 	forwarded_nodes = NEXT_NODE(forwarded_nodes); \
 	SNAP_NODE(s, R_GenHeap[NODE_CLASS(s)].Old[NODE_GENERATION(s)]); \
 	R_GenHeap[NODE_CLASS(s)].OldCount[NODE_GENERATION(s)]++; \
+	if (gc_trace_size > 0) gc_promoted_bytes += NodeBytes(s); \
 	FORWARD_CHILDREN(s); \
     } \
 } while (0)
 
+/* Phase Timing.  When gc.time() timing is enabled the elapsed time
+   of the marking, sweeping and heap adjustment phases of each
+   collection is accumulated in gcphasetimes. */
+
+#define GC_PHASE_MARK   0
+#define GC_PHASE_SWEEP  1
+#define GC_PHASE_ADJUST 2
+
+static const char *gc_phase_names[NUM_GC_PHASES] = {
+    "mark", "sweep", "adjust"
+};
+
+static double gc_event_phases[NUM_GC_PHASES];
+
+static void gc_phase_start(void)
+{
+    if (gctime_enabled || gc_trace_size > 0)
+	gcphasestart = currentTime();
+}
+
+static void gc_phase_end(int phase)
+{
+    if (gctime_enabled || gc_trace_size > 0) {
+	double now = currentTime();
+	if (gctime_enabled)
+	    gcphasetimes[phase] += now - gcphasestart;
+	gc_event_phases[phase] += now - gcphasestart;
+	gcphasestart = now;
+    }
+}
+
+
+/* GC Event Tracing.  When tracing is enabled by gctrace(size) a record
+   of each of the last 'size' collections is kept in a ring buffer,
+   and returned by gc.events().  The numbers of nodes freed in each
+   node class are computed from the nodes in use in the class before
+   the collection, the nodes in the old generations plus those
+   allocated since the previous collection, and the nodes in the old
+   generations afterwards.  The bytes promoted are those of the nodes
+   moved to the old generations by the collection, including the
+   survivors of the oldest generation in a full collection, and of
+   those aged by AgeNodeAndChildren since the previous collection. */
+
+typedef struct {
+    int gc, level;
+    double start;
+    double phases[NUM_GC_PHASES];
+    double freed[NUM_NODE_CLASSES];
+    double vfreed;   /* Vcells */
+    double promoted; /* bytes */
+    double ncells, vcells, nsize, vsize;
+} gc_event_t;
+
+static gc_event_t *gc_events = NULL;
+static int gc_events_next = 0, gc_events_count = 0;
+
+static double gc_event_inuse[NUM_NODE_CLASSES];
+static double gc_event_oldinuse[NUM_OLD_GENERATIONS];
+static double gc_event_vinuse, gc_event_start;
+
+
+static void gc_event_begin(void)
+{
+    int i, gen;
+
+    for (gen = 0; gen < NUM_OLD_GENERATIONS; gen++)
+	gc_event_oldinuse[gen] = 0;
+    for (i = 0; i < NUM_NODE_CLASSES; i++) {
+	double inuse = R_GenHeap[i].Allocated;
+	for (gen = 0; gen < NUM_OLD_GENERATIONS; gen++) {
+	    inuse += R_GenHeap[i].OldCount[gen];
+	    gc_event_oldinuse[gen] += R_GenHeap[i].OldCount[gen];
+	}
+	gc_event_inuse[i] = inuse;
+	R_GenHeap[i].Allocated = 0;
+    }
+    if (gc_trace_size > 0 || R_GCTargetPause > 0)
+	gc_event_start = currentTime();
+    if (gc_trace_size > 0) {
+	gc_event_vinuse = R_SmallVallocSize + R_LargeVallocSize;
+	for (i = 0; i < NUM_GC_PHASES; i++)
+	    gc_event_phases[i] = 0;
+    }
+}
+
+/* update the estimates used for pause time targets with the pause
+   and the numbers of nodes collected and surviving, up to the heap
+   adjustment */
+static void gc_pause_update(int gens_collected)
+{
+    double before = 0, after = 0, collected, survivors, pause;
+    int i, gen;
+
+    if (R_GCTargetPause <= 0)
+	return;
+    pause = currentTime() - gc_event_start;
+    for (i = 0; i < NUM_NODE_CLASSES; i++) {
+	before += gc_event_inuse[i];
+	for (gen = 0; gen < NUM_OLD_GENERATIONS; gen++)
+	    after += R_GenHeap[i].OldCount[gen];
+    }
+    collected = before;
+    for (gen = gens_collected; gen < NUM_OLD_GENERATIONS; gen++)
+	collected -= gc_event_oldinuse[gen];
+    survivors = collected - (before - after);
+    if (survivors < 1) survivors = 1;
+
+    /* decay older measurements by half at each collection */
+    gc_pause_time = 0.5 * gc_pause_time + pause;
+    gc_pause_survivors = 0.5 * gc_pause_survivors + survivors;
+    if (gens_collected == 0) {
+	gc_new_allocated = 0.5 * gc_new_allocated + collected;
+	gc_new_survivors = 0.5 * gc_new_survivors + survivors;
+    }
+}
+
+static void gc_event_end(int level)
+{
+    gc_event_t *e;
+    int i, gen;
+
+    if (gc_trace_size == 0)
+	return;
+    e = gc_events + gc_events_next;
+    gc_events_next = (gc_events_next + 1) % gc_trace_size;
+    if (gc_events_count < gc_trace_size)
+	gc_events_count++;
+
+    e->gc = gc_count;
+    e->level = level;
+    e->start = gc_event_start;
+    for (i = 0; i < NUM_GC_PHASES; i++)
+	e->phases[i] = gc_event_phases[i];
+    for (i = 0; i < NUM_NODE_CLASSES; i++) {
+	double inuse = 0;
+	for (gen = 0; gen < NUM_OLD_GENERATIONS; gen++)
+	    inuse += R_GenHeap[i].OldCount[gen];
+	e->freed[i] = gc_event_inuse[i] - inuse;
+    }
+    e->vfreed = gc_event_vinuse - (R_SmallVallocSize + R_LargeVallocSize);
+    e->promoted = gc_promoted_bytes;
+    gc_promoted_bytes = 0;
+    e->ncells = R_NodesInUse;
+    e->vcells = R_SmallVallocSize + R_LargeVallocSize;
+    e->nsize = R_NSize;
+    e->vsize = R_VSize;
+}
+
+
+/* Parallel Marking.  If R is built with OpenMP support and the
+   environment variable R_GC_NTHREADS is set to a value greater than
+   one, the main marking loop of full collections is run by that many
+   threads.
+
+   The roots are forwarded by the main thread as usual.  The workers
+   then trace the graph, claiming nodes by setting their mark bits
+   with an atomic operation, and keep the nodes still to be scanned on
+   private mark stacks.  A worker whose stack grows large moves a
+   chunk of it to a shared pool; workers that run out of work take
+   chunks from the pool, and marking is complete when the pool is
+   empty and all workers are idle.
+
+   Workers cannot maintain the node lists, so they only set mark
+   bits.  In a full collection all nodes are in New space before
+   marking starts, and a serial pass afterwards moves the marked nodes
+   to the old generations as PROCESS_NODES would have done; the
+   remaining phases are then run serially.  The result is the same as
+   for the serial marker.
+
+   If a mark stack cannot be grown the node is left marked but
+   unscanned; the children of all nodes in the old generations are
+   then forwarded serially after the parallel phase.  Parallel marking
+   is not used with PROTECTCHECK, which relies on the serial marker,
+   or on Windows, where malloc is replaced by an allocator that is not
+   thread-safe. */
+
+#if defined(_OPENMP) && defined(HAVE_PTHREAD) && ! defined(PROTECTCHECK) && \
+    ! defined(Win32)
+# define PARALLEL_MARK
+#endif
+
+static int R_GCNThreads = 1;
+
+#ifdef PARALLEL_MARK
+#include <omp.h>
+#include <pthread.h>
+
+/* Parallel marking is only worth the thread startup and the extra
+   sweep over the heap for heaps of at least this many nodes. */
+#define PAR_MARK_MIN_NODES 100000
+#define MARK_CHUNK_SIZE 512
+
+typedef struct mark_chunk {
+    struct mark_chunk *next;
+    SEXP nodes[MARK_CHUNK_SIZE];
+} mark_chunk_t;
+
+typedef struct {
+    SEXP *nodes;
+    R_size_t top, size;
+} mark_stack_t;
+
+static struct {
+    mark_chunk_t *chunks;
+    int nchunks;
+    int idle;
+    pthread_mutex_t lock;
+    pthread_cond_t cond; /* signalled when a chunk is added or all are idle */
+} mark_pool = { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER,
+		PTHREAD_COND_INITIALIZER };
+
+static Rboolean mark_stack_overflow;
+static unsigned int mark_bit_mask;
+
+static void init_parallel_mark(void)
+{
+    SEXPREC tmp;
+
+    if (sizeof(struct sxpinfo_struct) != sizeof(unsigned int)) {
+	/* atomic marking assumes a single word of flags */
+	R_GCNThreads = 1;
+	return;
+    }
+    /* more threads than processors would only take turns running */
+    if (R_GCNThreads > omp_get_num_procs())
+	R_GCNThreads = omp_get_num_procs();
+    memset(&tmp.sxpinfo, 0, sizeof(tmp.sxpinfo));
+    MARK_NODE(&tmp);
+    memcpy(&mark_bit_mask, &tmp.sxpinfo, sizeof(unsigned int));
+}
+
+/* Set the mark bit of s; returns TRUE if this thread marked it. */
+static R_INLINE Rboolean par_mark_node(SEXP s)
+{
+    unsigned int *flags = (unsigned int *) &(s->sxpinfo), old;
+
+#pragma omp atomic read
+    old = *flags;
+    if (old & mark_bit_mask)
+	return FALSE;
+#pragma omp atomic capture
+    { old = *flags; *flags |= mark_bit_mask; }
+    return (old & mark_bit_mask) == 0;
+}
+
+static void mark_stack_push(mark_stack_t *stack, SEXP s)
+{
+    if (stack->top == stack->size) {
+	R_size_t size = 2 * stack->size;
+	SEXP *nodes = realloc(stack->nodes, size * sizeof(SEXP));
+	if (nodes == NULL) {
+#pragma omp atomic write
+	    mark_stack_overflow = TRUE;
+	    return;
+	}
+	stack->nodes = nodes;
+	stack->size = size;
+    }
+    stack->nodes[stack->top++] = s;
+}
+
+/* move the top chunk of the stack to the shared pool */
+static void mark_stack_share(mark_stack_t *stack)
+{
+    mark_chunk_t *chunk = malloc(sizeof(mark_chunk_t));
+    if (chunk == NULL)
+	return;
+    stack->top -= MARK_CHUNK_SIZE;
+    memcpy(chunk->nodes, stack->nodes + stack->top,
+	   MARK_CHUNK_SIZE * sizeof(SEXP));
+    pthread_mutex_lock(&mark_pool.lock);
+    chunk->next = mark_pool.chunks;
+    mark_pool.chunks = chunk;
+    mark_pool.nchunks++;
+    pthread_cond_signal(&mark_pool.cond);
+    pthread_mutex_unlock(&mark_pool.lock);
+}
+
+/* Refill an empty stack from the shared pool, sleeping until either a
+   chunk becomes available or all workers are idle.  Returns FALSE
+   when marking is complete. */
+static Rboolean mark_stack_refill(mark_stack_t *stack, int nthreads)
+{
+    pthread_mutex_lock(&mark_pool.lock);
+    mark_pool.idle++;
+    for (;;) {
+	mark_chunk_t *chunk = mark_pool.chunks;
+	if (chunk != NULL) {
+	    mark_pool.chunks = chunk->next;
+	    mark_pool.nchunks--;
+	    mark_pool.idle--;
+	    pthread_mutex_unlock(&mark_pool.lock);
+	    /* stacks start with room for more than one chunk */
+	    memcpy(stack->nodes, chunk->nodes,
+		   MARK_CHUNK_SIZE * sizeof(SEXP));
+	    stack->top = MARK_CHUNK_SIZE;
+	    free(chunk);
+	    return TRUE;
+	}
+	if (mark_pool.idle == nthreads) {
+	    /* wake the other idle workers so they can finish too */
+	    pthread_cond_broadcast(&mark_pool.cond);
+	    pthread_mutex_unlock(&mark_pool.lock);
+	    return FALSE;
+	}
+	pthread_cond_wait(&mark_pool.cond, &mark_pool.lock);
+    }
+}
+
+#define PAR_FORWARD_NODE(s, stack) do { \
+  SEXP pf__n__ = (s); \
+  if (pf__n__ && par_mark_node(pf__n__)) \
+    mark_stack_push(stack, pf__n__); \
+} while (0)
+
+static void par_mark_worker(mark_stack_t *stack, int nthreads)
+{
+    do {
+	while (stack->top > 0) {
+	    SEXP s = stack->nodes[--stack->top];
+	    DO_CHILDREN(s, PAR_FORWARD_NODE, stack);
+	    if (stack->top >= 2 * MARK_CHUNK_SIZE) {
+		int nchunks;
+#pragma omp atomic read
+		nchunks = mark_pool.nchunks;
+		if (nchunks < nthreads)
+		    mark_stack_share(stack);
+	    }
+	}
+    } while (mark_stack_refill(stack, nthreads));
+}
+
+/* move marked nodes from New space to their old generations */
+static void MoveMarkedNodesToOld(void)
+{
+    SEXP s;
+    int i;
+
+    for (i = 0; i < NUM_SMALL_NODE_CLASSES; i++) {
+	PAGE_HEADER *page;
+	int node_size = NODE_SIZE(i);
+	int page_count = (R_PAGE_SIZE - sizeof(PAGE_HEADER)) / node_size;
+
+	for (page = R_GenHeap[i].pages; page != NULL; page = page->next) {
+	    int j;
+	    char *data = PAGE_DATA(page);
+
+	    for (j = 0; j < page_count; j++, data += node_size) {
+		s = (SEXP) data;
+		if (NODE_IS_MARKED(s)) {
+		    UNSNAP_NODE(s);
+		    SNAP_NODE(s, R_GenHeap[i].Old[NODE_GENERATION(s)]);
+		    R_GenHeap[i].OldCount[NODE_GENERATION(s)]++;
+		    if (gc_trace_size > 0) gc_promoted_bytes += node_size;
+		}
+	    }
+	}
+    }
+    for (i = CUSTOM_NODE_CLASS; i <= LARGE_NODE_CLASS; i++) {
+	s = NEXT_NODE(R_GenHeap[i].New);
+	while (s != R_GenHeap[i].New) {
+	    SEXP next = NEXT_NODE(s);
+	    if (NODE_IS_MARKED(s)) {
+		UNSNAP_NODE(s);
+		SNAP_NODE(s, R_GenHeap[i].Old[NODE_GENERATION(s)]);
+		R_GenHeap[i].OldCount[NODE_GENERATION(s)]++;
+		if (gc_trace_size > 0) gc_promoted_bytes += NodeBytes(s);
+	    }
+	    s = next;
+	}
+    }
+}
+
+/* Mark everything reachable from the forwarded roots using
+   R_GCNThreads threads.  This may only be used in full collections,
+   before anything has been moved to the old generations.  Returns
+   FALSE, with nothing done, if the mark stacks cannot be allocated. */
+static Rboolean ParallelProcessNodes(SEXP forwarded_nodes)
+{
+    int i, nthreads = R_GCNThreads;
+    mark_stack_t *stacks;
+    SEXP s;
+
+    stacks = calloc(nthreads, sizeof(mark_stack_t));
+    if (stacks == NULL)
+	return FALSE;
+    for (i = 0; i < nthreads; i++) {
+	stacks[i].size = 4 * MARK_CHUNK_SIZE;
+	stacks[i].nodes = malloc(stacks[i].size * sizeof(SEXP));
+	if (stacks[i].nodes == NULL) {
+	    while (i-- > 0)
+		free(stacks[i].nodes);
+	    free(stacks);
+	    return FALSE;
+	}
+    }
+
+    /* Return the forwarded roots to New space, where the pass after
+       marking will find them, and deal them out to the workers. */
+    mark_stack_overflow = FALSE;
+    for (i = 0; forwarded_nodes != NULL; i = (i + 1) % nthreads) {
+	s = forwarded_nodes;
+	forwarded_nodes = NEXT_NODE(forwarded_nodes);
+	SNAP_NODE(s, R_GenHeap[NODE_CLASS(s)].New);
+	mark_stack_push(stacks + i, s);
+    }
+
+    mark_pool.chunks = NULL;
+    mark_pool.nchunks = 0;
+    mark_pool.idle = 0;
+#pragma omp parallel num_threads(nthreads) default(none) \
+    shared(stacks, nthreads)
+    {
+	int id = omp_get_thread_num();
+	/* the runtime may provide fewer threads than requested */
+	int nworkers = omp_get_num_threads();
+	if (id == 0)
+	    for (int k = nworkers; k < nthreads; k++)
+		while (stacks[k].top > 0)
+		    mark_stack_push(stacks, stacks[k].nodes[--stacks[k].top]);
+#pragma omp barrier
+	par_mark_worker(stacks + id, nworkers);
+    }
+
+    for (i = 0; i < nthreads; i++)
+	free(stacks[i].nodes);
+    free(stacks);
+
+    MoveMarkedNodesToOld();
+
+    if (mark_stack_overflow) {
+	int gen;
+	forwarded_nodes = NULL;
+	for (gen = 0; gen < NUM_OLD_GENERATIONS; gen++)
+	    for (i = 0; i < NUM_NODE_CLASSES; i++)
+		for (s = NEXT_NODE(R_GenHeap[i].Old[gen]);
+		     s != R_GenHeap[i].Old[gen];
+		     s = NEXT_NODE(s))
+		    FORWARD_CHILDREN(s);
+	PROCESS_NODES();
+    }
+    return TRUE;
+}
+#endif /* PARALLEL_MARK */
+
+static void init_gc_nthreads(void)
+{
+    char *arg = getenv("R_GC_NTHREADS");
+    if (arg != NULL) {
+	int n = atoi(arg);
+	if (n > 0)
+	    R_GCNThreads = n;
+    }
+#ifdef PARALLEL_MARK
+    init_parallel_mark();
+#else
+    R_GCNThreads = 1;
+#endif
+}
+
 static void RunGenCollect(R_size_t size_needed)
 {
     int i, gen, gens_collected;
@@ -1526,6 +2484,11 @@ static void RunGenCollect(R_size_t size_needed)
     SEXP forwarded_nodes;
 
     bad_sexp_type_seen = 0;
+    gc_event_begin();
+    gc_phase_start();
+
+    FinishSweep();
+    FlushAllocBuffers();
 
     /* determine number of generations to collect */
     while (num_old_gens_to_collect < NUM_OLD_GENERATIONS) {
@@ -1677,6 +2640,13 @@ static void RunGenCollect(R_size_t size_needed)
     FORWARD_NODE(R_CachedScalarInteger);
 
     /* main processing loop */
+#ifdef PARALLEL_MARK
+    if (R_GCNThreads > 1 && gens_collected == NUM_OLD_GENERATIONS &&
+	R_NodesInUse >= PAR_MARK_MIN_NODES &&
+	ParallelProcessNodes(forwarded_nodes))
+	forwarded_nodes = NULL;
+    else
+#endif
     PROCESS_NODES();
 
     /* identify weakly reachable nodes */
@@ -1743,6 +2713,14 @@ static void RunGenCollect(R_size_t size_needed)
     FORWARD_NODE(R_StringHash);
     PROCESS_NODES();
 
+    gc_phase_end(GC_PHASE_MARK);
+
+#ifdef PROTECTCHECK
+    /* all free nodes have to be in New space to be marked as free */
+    StartSweep(FALSE);
+    FinishSweep();
+#endif
+
 #ifdef PROTECTCHECK
     for(i=0; i< NUM_SMALL_NODE_CLASSES;i++){
 	s = NEXT_NODE(R_GenHeap[i].New);
@@ -1829,6 +2807,9 @@ static void RunGenCollect(R_size_t size_needed)
     }
     else num_old_gens_to_collect = 0;
 
+    gc_phase_end(GC_PHASE_SWEEP);
+    gc_pause_update(gens_collected);
+
     gen_gc_counts[gens_collected]++;
 
     if (gens_collected == NUM_OLD_GENERATIONS) {
@@ -1837,15 +2818,24 @@ static void RunGenCollect(R_size_t size_needed)
 	TryToReleasePages();
 	DEBUG_CHECK_NODE_COUNTS("after heap adjustment");
     }
-    else if (gens_collected > 0) {
-	TryToReleasePages();
-	DEBUG_CHECK_NODE_COUNTS("after heap adjustment");
+    else {
+	/* heap sizes for pause targets are adjusted at every collection */
+	if (R_GCTargetPause > 0)
+	    AdjustHeapSizeForPause(size_needed);
+	if (gens_collected > 0) {
+	    TryToReleasePages();
+	    DEBUG_CHECK_NODE_COUNTS("after heap adjustment");
+	}
     }
-#ifdef SORT_NODES
-    if (gens_collected == NUM_OLD_GENERATIONS)
-	SortNodes();
+
+    StartSweep(gens_collected == NUM_OLD_GENERATIONS);
+#ifdef PROTECTCHECK
+    FinishSweep();
 #endif
 
+    gc_phase_end(GC_PHASE_ADJUST);
+    gc_event_end(gens_collected);
+
     if (R_check_constants > 2 ||
 	    (R_check_constants > 1 && gens_collected == NUM_OLD_GENERATIONS))
 	R_checkConstants(TRUE);
@@ -2035,6 +3025,8 @@ void attribute_hidden InitMemory()
 
     init_gctorture();
     init_gc_grow_settings();
+    init_gc_nthreads();
+    init_mmap_vec_min();
 
     gc_reporting = R_Verbose;
     R_StandardPPStackSize = R_PPStackSize;
@@ -2377,6 +3369,8 @@ SEXP NewEnvironment(SEXP namelist, SEXP valuelist, SEXP rho)
     ENCLOS(newrho) = CHK(rho);
     HASHTAB(newrho) = R_NilValue;
     ATTRIB(newrho) = R_NilValue;
+    INCREMENT_REFCNT(valuelist);
+    INCREMENT_REFCNT(rho);
 
     v = CHK(valuelist);
     n = CHK(namelist);
@@ -2423,6 +3417,8 @@ SEXP attribute_hidden mkPROMISE(SEXP expr, SEXP rho)
     PRVALUE(s) = R_UnboundValue;
     PRSEEN(s) = 0;
     ATTRIB(s) = R_NilValue;
+    INCREMENT_REFCNT(expr);
+    INCREMENT_REFCNT(rho);
     return s;
 }
 
@@ -2613,6 +3609,12 @@ SEXP allocVector3(SEXPTYPE type, R_xlen_t length, R_allocator_t *allocator)
 	      type2char(type), length);
     }
 
+#ifdef MMAP_LARGE_VECTORS
+    if (allocator == NULL && R_MmapVecMin > 0 &&
+	size >= R_MmapVecMin / sizeof(VECREC))
+	allocator = &mmap_allocator;
+#endif
+
     if (allocator) {
 	node_class = CUSTOM_NODE_CLASS;
 	alloc_size = size;
@@ -2722,8 +3724,9 @@ SEXP allocVector3(SEXPTYPE type, R_xlen_t length, R_allocator_t *allocator)
 	    s->sxpinfo = UnmarkedNodeTemplate.sxpinfo;
 	    INIT_REFCNT(s);
 	    SET_NODE_CLASS(s, node_class);
-	    if (!allocator) R_LargeVallocSize += size;
+	    if (IS_HEAP_ALLOCATOR(allocator)) R_LargeVallocSize += size;
 	    R_GenHeap[node_class].AllocCount++;
+	    R_GenHeap[node_class].Allocated++;
 	    R_NodesInUse++;
 	    SNAP_NODE(s, R_GenHeap[node_class].New);
 	}
@@ -2865,15 +3868,15 @@ static void R_gc_full(R_size_t size_needed)
 {
     num_old_gens_to_collect = NUM_OLD_GENERATIONS;
     R_gc_internal(size_needed);
+#ifdef BACKGROUND_RELEASE
+    WaitForBackgroundRelease();
+#endif
 }
 
-static double gctimes[5], gcstarttimes[5];
-static Rboolean gctime_enabled = FALSE;
-
 /* this is primitive */
 SEXP attribute_hidden do_gctime(SEXP call, SEXP op, SEXP args, SEXP env)
 {
-    SEXP ans;
+    SEXP ans, phases, nms;
 
     if (args == R_NilValue)
 	gctime_enabled = TRUE;
@@ -2881,12 +3884,110 @@ SEXP attribute_hidden do_gctime(SEXP call, SEXP op, SEXP args, SEXP env)
 	check1arg(args, call, "on");
 	gctime_enabled = asLogical(CAR(args));
     }
-    ans = allocVector(REALSXP, 5);
+    PROTECT(ans = allocVector(REALSXP, 5));
     REAL(ans)[0] = gctimes[0];
     REAL(ans)[1] = gctimes[1];
     REAL(ans)[2] = gctimes[2];
     REAL(ans)[3] = gctimes[3];
     REAL(ans)[4] = gctimes[4];
+
+    /* elapsed time of the collection phases */
+    PROTECT(phases = allocVector(REALSXP, NUM_GC_PHASES));
+    PROTECT(nms = allocVector(STRSXP, NUM_GC_PHASES));
+    for (int k = 0; k < NUM_GC_PHASES; k++) {
+	REAL(phases)[k] = gcphasetimes[k];
+	SET_STRING_ELT(nms, k, mkChar(gc_phase_names[k]));
+    }
+    setAttrib(phases, R_NamesSymbol, nms);
+    setAttrib(ans, install("phases"), phases);
+    UNPROTECT(3);
+    return ans;
+}
+
+SEXP attribute_hidden do_gctrace(SEXP call, SEXP op, SEXP args, SEXP env)
+{
+    int old = gc_trace_size, size;
+
+    checkArity(op, args);
+    size = asInteger(CAR(args));
+    if (size == NA_INTEGER || size < 0)
+	error(_("invalid '%s' argument"), "size");
+    if (size != gc_trace_size) {
+	gc_event_t *events = NULL;
+	if (size > 0) {
+	    events = (gc_event_t *) malloc(size * sizeof(gc_event_t));
+	    if (events == NULL)
+		error(_("could not allocate memory for GC events"));
+	}
+	free(gc_events);
+	gc_events = events;
+	gc_trace_size = size;
+    }
+    gc_events_next = gc_events_count = 0;
+    gc_promoted_bytes = 0;
+    return ScalarInteger(old);
+}
+
+/* the recorded GC events as a list of columns, oldest first; there is
+   a column for the time of each phase and for the nodes freed in each
+   node class */
+SEXP attribute_hidden do_gcevents(SEXP call, SEXP op, SEXP args, SEXP env)
+{
+    static const char *head[] = { "gc", "level", "start" };
+    static const char *tail[] = {
+	"vfreed", "promoted", "ncells", "vcells", "nsize", "vsize"
+    };
+    int nhead = sizeof(head) / sizeof(head[0]);
+    int ntail = sizeof(tail) / sizeof(tail[0]);
+    int ncols = nhead + NUM_GC_PHASES + NUM_NODE_CLASSES + ntail;
+    int n = gc_events_count;
+    int first = gc_trace_size > 0 ?
+	(gc_events_next - n + gc_trace_size) % gc_trace_size : 0;
+    SEXP ans, nms;
+    char buf[32];
+
+    checkArity(op, args);
+    PROTECT(ans = allocVector(VECSXP, ncols));
+    PROTECT(nms = allocVector(STRSXP, ncols));
+    for (int j = 0; j < ncols; j++) {
+	const char *name;
+	int k = j - nhead - NUM_GC_PHASES;
+	if (j < nhead)
+	    name = head[j];
+	else if (k < 0)
+	    name = gc_phase_names[j - nhead];
+	else if (k == CUSTOM_NODE_CLASS)
+	    name = "freed.custom";
+	else if (k == LARGE_NODE_CLASS)
+	    name = "freed.large";
+	else if (k < NUM_NODE_CLASSES) {
+	    snprintf(buf, sizeof(buf), "freed.%d", k);
+	    name = buf;
+	}
+	else
+	    name = tail[k - NUM_NODE_CLASSES];
+	SET_STRING_ELT(nms, j, mkChar(name));
+	SET_VECTOR_ELT(ans, j, allocVector(j < 2 ? INTSXP : REALSXP, n));
+    }
+    for (int i = 0; i < n; i++) {
+	gc_event_t *e = gc_events + (first + i) % gc_trace_size;
+	int j = 0;
+	INTEGER(VECTOR_ELT(ans, j++))[i] = e->gc;
+	INTEGER(VECTOR_ELT(ans, j++))[i] = e->level;
+	REAL(VECTOR_ELT(ans, j++))[i] = e->start;
+	for (int k = 0; k < NUM_GC_PHASES; k++)
+	    REAL(VECTOR_ELT(ans, j++))[i] = e->phases[k];
+	for (int k = 0; k < NUM_NODE_CLASSES; k++)
+	    REAL(VECTOR_ELT(ans, j++))[i] = e->freed[k];
+	REAL(VECTOR_ELT(ans, j++))[i] = e->vfreed;
+	REAL(VECTOR_ELT(ans, j++))[i] = e->promoted;
+	REAL(VECTOR_ELT(ans, j++))[i] = e->ncells;
+	REAL(VECTOR_ELT(ans, j++))[i] = e->vcells;
+	REAL(VECTOR_ELT(ans, j++))[i] = e->nsize;
+	REAL(VECTOR_ELT(ans, j++))[i] = e->vsize;
+    }
+    setAttrib(ans, R_NamesSymbol, nms);
+    UNPROTECT(2);
     return ans;
 }
 
@@ -2980,6 +4081,10 @@ static void R_gc_internal(R_size_t size_needed)
 	vcells = 0.1*ceil(10*vcells * vsfac/Mega);
 	REprintf("%.1f Mbytes of vectors used (%d%%)\n",
 		 vcells, (int) (vfrac + 0.5));
+	if (R_MmapBytes > 0)
+	    REprintf("%.1f Mbytes of vectors mapped\n",
+		     0.1*ceil(10. * R_MmapBytes/Mega));
+	REprintf("%.0f objects preserved\n", (double) R_PreciousCount);
     }
 
 #ifdef IMMEDIATE_FINALIZERS
@@ -3265,27 +4370,72 @@ void R_chk_free(void *ptr)
 /* This code keeps a list of objects which are not assigned to variables
    but which are required to persist across garbage collections.  The
    objects are registered with R_PreserveObject and deregistered with
-   R_ReleaseObject. */
+   R_ReleaseObject.
+
+   The objects are kept in a hash table, a generic vector of lists
+   hashed on the object address, so both operations take constant
+   time even when many objects are preserved.  The table is allocated
+   on first use and grown from n to 2n + 1 bins, keeping the size
+   odd, when it holds more than two objects per bin.  An object
+   preserved more than once has to be released as often. */
+
+#define PHASH_SIZE 1069
+#define PTRHASH(obj, n) ((((R_size_t) (obj)) >> 3) % (n))
+
+static void GrowPreciousTable(void)
+{
+    SEXP old = R_PreciousList;
+    R_xlen_t n = XLENGTH(old), newn = 2 * n + 1;
+    SEXP table = allocVector(VECSXP, newn);
+
+    for (R_xlen_t i = 0; i < n; i++) {
+	SEXP cell = VECTOR_ELT(old, i);
+	while (cell != R_NilValue) {
+	    SEXP next = CDR(cell);
+	    R_xlen_t bin = PTRHASH(CAR(cell), newn);
+	    SETCDR(cell, VECTOR_ELT(table, bin));
+	    SET_VECTOR_ELT(table, bin, cell);
+	    cell = next;
+	}
+    }
+    R_PreciousList = table;
+}
 
 void R_PreserveObject(SEXP object)
 {
-    R_PreciousList = CONS(object, R_PreciousList);
-}
+    R_xlen_t bin;
 
-static SEXP RecursiveRelease(SEXP object, SEXP list)
-{
-    if (!isNull(list)) {
-	if (object == CAR(list))
-	    return CDR(list);
-	else
-	    CDR(list) = RecursiveRelease(object, CDR(list));
+    if (R_PreciousList == R_NilValue) {
+	PROTECT(object);
+	R_PreciousList = allocVector(VECSXP, PHASH_SIZE);
+	UNPROTECT(1);
+    }
+    else if (R_PreciousCount > 2 * (R_size_t) XLENGTH(R_PreciousList)) {
+	PROTECT(object);
+	GrowPreciousTable();
+	UNPROTECT(1);
     }
-    return list;
+    bin = PTRHASH(object, XLENGTH(R_PreciousList));
+    SET_VECTOR_ELT(R_PreciousList, bin,
+		   CONS(object, VECTOR_ELT(R_PreciousList, bin)));
+    R_PreciousCount++;
 }
 
 void R_ReleaseObject(SEXP object)
 {
-    R_PreciousList =  RecursiveRelease(object, R_PreciousList);
+    if (R_PreciousList != R_NilValue) {
+	R_xlen_t bin = PTRHASH(object, XLENGTH(R_PreciousList));
+	SEXP cell = VECTOR_ELT(R_PreciousList, bin), last = R_NilValue;
+	for (; cell != R_NilValue; last = cell, cell = CDR(cell))
+	    if (CAR(cell) == object) {
+		if (last == R_NilValue)
+		    SET_VECTOR_ELT(R_PreciousList, bin, CDR(cell));
+		else
+		    SETCDR(last, CDR(cell));
+		R_PreciousCount--;
+		break;
+	    }
+    }
 }
 
 
@@ -3296,6 +4446,8 @@ SEXP R_MakeExternalPtr(void *p, SEXP tag, SEXP prot)
     EXTPTR_PTR(s) = p;
     EXTPTR_PROT(s) = CHK(prot);
     EXTPTR_TAG(s) = CHK(tag);
+    if (prot) INCREMENT_REFCNT(prot);
+    if (tag) INCREMENT_REFCNT(tag);
     return s;
 }
 
@@ -3352,6 +4504,8 @@ SEXP R_MakeExternalPtrFn(DL_FUNC p, SEXP tag, SEXP prot)
     EXTPTR_PTR(s) = tmp.p;
     EXTPTR_PROT(s) = CHK(prot);
     EXTPTR_TAG(s) = CHK(tag);
+    if (prot) INCREMENT_REFCNT(prot);
+    if (tag) INCREMENT_REFCNT(tag);
     return s;
 }
 
@@ -3503,6 +4657,59 @@ Rcomplex *(COMPLEX)(SEXP x) {
     return COMPLEX(x);
 }
 
+const int *(LOGICAL_RO)(SEXP x) {
+    if(TYPEOF(x) != LGLSXP)
+	error("%s() can only be applied to a '%s', not a '%s'",
+	      "LOGICAL_RO",  "logical", type2char(TYPEOF(x)));
+    return LOGICAL_RO(x);
+}
+
+const int *(INTEGER_RO)(SEXP x) {
+    if(TYPEOF(x) != INTSXP && TYPEOF(x) != LGLSXP)
+	error("%s() can only be applied to a '%s', not a '%s'",
+	      "INTEGER_RO", "integer", type2char(TYPEOF(x)));
+    return INTEGER_RO(x);
+}
+
+const Rbyte *(RAW_RO)(SEXP x) {
+    if(TYPEOF(x) != RAWSXP)
+	error("%s() can only be applied to a '%s', not a '%s'",
+	      "RAW_RO", "raw", type2char(TYPEOF(x)));
+    return RAW_RO(x);
+}
+
+const double *(REAL_RO)(SEXP x) {
+    if(TYPEOF(x) != REALSXP)
+	error("%s() can only be applied to a '%s', not a '%s'",
+	      "REAL_RO", "numeric", type2char(TYPEOF(x)));
+    return REAL_RO(x);
+}
+
+const Rcomplex *(COMPLEX_RO)(SEXP x) {
+    if(TYPEOF(x) != CPLXSXP)
+	error("%s() can only be applied to a '%s', not a '%s'",
+	      "COMPLEX_RO", "complex", type2char(TYPEOF(x)));
+    return COMPLEX_RO(x);
+}
+
+int (INTEGER_ELT)(SEXP x, R_xlen_t i) {
+    if(TYPEOF(x) != INTSXP && TYPEOF(x) != LGLSXP)
+	error("%s() can only be applied to a '%s', not a '%s'",
+	      "INTEGER_ELT", "integer", type2char(TYPEOF(x)));
+    return INTEGER_ELT(x, i);
+}
+
+double (REAL_ELT)(SEXP x, R_xlen_t i) {
+    if(TYPEOF(x) != REALSXP)
+	error("%s() can only be applied to a '%s', not a '%s'",
+	      "REAL_ELT", "numeric", type2char(TYPEOF(x)));
+    return REAL_ELT(x, i);
+}
+
+int (ALTREP)(SEXP x) { return isVector(x) && ALTREP(x); }
+const void *(DATAPTR_RO)(SEXP x) { return DATAPTR_RO(CHK2(x)); }
+const void *(DATAPTR_OR_NULL)(SEXP x) { return DATAPTR_OR_NULL(CHK2(x)); }
+
 SEXP *(STRING_PTR)(SEXP x) { return STRING_PTR(CHK(x)); }
 
 SEXP * NORET (VECTOR_PTR)(SEXP x)
@@ -3520,9 +4727,14 @@ void (SET_STRING_ELT)(SEXP x, R_xlen_t i, SEXP v) {
     if (i < 0 || i >= XLENGTH(x))
 	error(_("attempt to set index %lu/%lu in SET_STRING_ELT"),
 	      i, XLENGTH(x));
-    FIX_REFCNT(x, STRING_ELT(x, i), v);
-    CHECK_OLD_TO_NEW(x, v);
-    STRING_ELT(x, i) = v;
+    if (ALTREP(x))
+	ALTSTRING_SET_ELT(x, i, v);
+    else {
+	SEXP *ps = (SEXP *) STDVEC_DATAPTR(x);
+	FIX_REFCNT(x, ps[i], v);
+	CHECK_OLD_TO_NEW(x, v);
+	ps[i] = v;
+    }
 }
 
 SEXP (SET_VECTOR_ELT)(SEXP x, R_xlen_t i, SEXP v) {
@@ -3761,6 +4973,19 @@ void (UNSET_NO_SPECIAL_SYMBOLS)(SEXP b) { UNSET_NO_SPECIAL_SYMBOLS(b); }
 attribute_hidden
 Rboolean (NO_SPECIAL_SYMBOLS)(SEXP b) { return NO_SPECIAL_SYMBOLS(b); }
 
+attribute_hidden
+void (SET_S3_METHOD_SYMBOL)(SEXP b) { SET_S3_METHOD_SYMBOL(b); }
+attribute_hidden
+Rboolean (IS_S3_METHOD_SYMBOL)(SEXP b) { return IS_S3_METHOD_SYMBOL(b); }
+attribute_hidden
+void (SET_HAD_ACTIVE_BINDING)(SEXP b) { SET_HAD_ACTIVE_BINDING(b); }
+attribute_hidden
+Rboolean (HAD_ACTIVE_BINDING)(SEXP b) { return HAD_ACTIVE_BINDING(b); }
+attribute_hidden
+void (SET_FUN_CACHED_SYMBOL)(SEXP b) { SET_FUN_CACHED_SYMBOL(b); }
+attribute_hidden
+Rboolean (IS_FUN_CACHED_SYMBOL)(SEXP b) { return IS_FUN_CACHED_SYMBOL(b); }
+
 /* R_FunTab accessors, only needed when write barrier is on */
 /* Not hidden to allow experimentaiton without rebuilding R - LT */
 /* attribute_hidden */
@@ -207,8 +207,10 @@ SEXP R_LookupMethod(SEXP method, SEXP rho, SEXP callrho, SEXP defrho)
 	return val;
     else {
 	/* We assume here that no one registered a non-function */
-	if (!s_S3MethodsTable)
+	if (!s_S3MethodsTable) {
 	    s_S3MethodsTable = install(".__S3MethodsTable__.");
+	    SET_S3_METHOD_SYMBOL(s_S3MethodsTable);
+	}
 	SEXP table = findVarInFrame3(defrho,
 				     s_S3MethodsTable,
 				     TRUE);
@@ -339,13 +341,134 @@ SEXP dispatchMethod(SEXP op, SEXP sxp, SEXP dotClass, RCNTXT *cptr, SEXP method,
     return ans;
 }
 
+/* S3 dispatch cache.
+
+   usemethod() looks for "generic.class" for each class in turn along
+   the calling environment chain and then in the S3 methods table of
+   the environment the generic was defined in; most calls repeat a
+   search that was already done.  The outcome of the search is kept in
+   a direct-mapped table keyed by the generic, the class vector, the
+   defining environment and the 'scope', the first hashed environment
+   on the calling chain.  The unhashed function frames below the scope
+   are checked on every call, and the cache is bypassed if any of them
+   has a binding for a symbol that has been used as a method name.
+
+   An entry is valid as long as R_S3DispatchEpoch has not changed.
+   The epoch is bumped whenever a binding for a symbol marked by
+   installS3Signature is created, changed or removed, and when the
+   search path or the enclosure of an environment changes.  Searches
+   that pass through user databases or symbols that have had active
+   bindings are not cached. Entries keep their environments alive,
+   so comparing them by address is safe. */
+
+#define S3_CACHE_SIZE 1024
+
+enum { S3C_GENERIC, S3C_CLASS, S3C_SCOPE, S3C_DEFRHO, S3C_METHOD,
+       S3C_FUN, S3C_INFO, S3C_LENGTH };
+
+static SEXP R_S3DispatchCache = NULL;
+
+static SEXP S3CacheScope(SEXP rho)
+{
+    for (; rho != R_EmptyEnv; rho = ENCLOS(rho)) {
+	if (rho == R_BaseEnv || rho == R_BaseNamespace ||
+	    HASHTAB(rho) != R_NilValue)
+	    return rho;
+	for (SEXP frame = FRAME(rho); frame != R_NilValue; frame = CDR(frame))
+	    if (IS_S3_METHOD_SYMBOL(TAG(frame)))
+		return NULL;
+    }
+    return R_EmptyEnv;
+}
+
+static int S3CacheIndex(const char *generic, SEXP klass, SEXP scope,
+			SEXP defrho)
+{
+    uintptr_t h = 5381;
+    for (const char *p = generic; *p; p++)
+	h = h * 33 + (unsigned char) *p;
+    for (int i = 0; i < LENGTH(klass); i++)
+	h = h * 31 + ((uintptr_t) STRING_ELT(klass, i) >> 3);
+    h = h * 31 + ((uintptr_t) scope >> 3);
+    h = h * 31 + ((uintptr_t) defrho >> 3);
+    return (int) ((h ^ (h >> 16)) % S3_CACHE_SIZE);
+}
+
+static SEXP S3CacheGet(int idx, const char *generic, SEXP klass,
+		       SEXP scope, SEXP defrho)
+{
+    SEXP e = VECTOR_ELT(R_S3DispatchCache, idx);
+    if (e == R_NilValue ||
+	(unsigned int) INTEGER(VECTOR_ELT(e, S3C_INFO))[1] != R_S3DispatchEpoch ||
+	VECTOR_ELT(e, S3C_SCOPE) != scope ||
+	VECTOR_ELT(e, S3C_DEFRHO) != defrho)
+	return NULL;
+    SEXP eklass = VECTOR_ELT(e, S3C_CLASS);
+    int n = LENGTH(klass);
+    if (LENGTH(eklass) != n)
+	return NULL;
+    for (int i = 0; i < n; i++)
+	if (STRING_ELT(eklass, i) != STRING_ELT(klass, i))
+	    return NULL;
+    if (strcmp(CHAR(VECTOR_ELT(e, S3C_GENERIC)), generic))
+	return NULL;
+    return e;
+}
+
+static void S3CachePut(int idx, const char *generic, SEXP klass,
+		       SEXP callrho, SEXP scope, SEXP defrho, SEXP method,
+		       SEXP sxp, int which, unsigned int epoch)
+{
+    /* Bindings may have changed while the methods were looked up, and
+       frames below the scope may bind symbols that were marked by
+       the lookup. */
+    if (epoch != R_S3DispatchEpoch || S3CacheScope(callrho) != scope)
+	return;
+    /* the chain searched must not contain a user database */
+    for (SEXP rho = scope; rho != R_EmptyEnv; rho = ENCLOS(rho))
+	if (OBJECT(rho) && inherits(rho, "UserDefinedDatabase"))
+	    return;
+    SEXP e = PROTECT(allocVector(VECSXP, S3C_LENGTH));
+    SET_VECTOR_ELT(e, S3C_GENERIC, mkChar(generic));
+    SET_VECTOR_ELT(e, S3C_CLASS, duplicate(klass));
+    SET_VECTOR_ELT(e, S3C_SCOPE, scope);
+    SET_VECTOR_ELT(e, S3C_DEFRHO, defrho);
+    SET_VECTOR_ELT(e, S3C_METHOD, method);
+    SET_VECTOR_ELT(e, S3C_FUN, sxp);
+    SEXP info = allocVector(INTSXP, 2);
+    SET_VECTOR_ELT(e, S3C_INFO, info);
+    INTEGER(info)[0] = which;
+    INTEGER(info)[1] = (int) R_S3DispatchEpoch;
+    SET_VECTOR_ELT(R_S3DispatchCache, idx, e);
+    UNPROTECT(1); /* e */
+}
+
+static int dispatchFound(SEXP op, SEXP sxp, SEXP klass, int i,
+			 RCNTXT *cptr, SEXP method, const char *generic,
+			 SEXP rho, SEXP callrho, SEXP defrho, SEXP *ans)
+{
+    if (i > 0) {
+	SEXP dotClass = PROTECT(stringSuffix(klass, i));
+	setAttrib(dotClass, R_PreviousSymbol, klass);
+	*ans = dispatchMethod(op, sxp, dotClass, cptr, method, generic,
+			      rho, callrho, defrho);
+	UNPROTECT(1); /* dotClass */
+    }
+    else
+	*ans = dispatchMethod(op, sxp, i == 0 ? klass : R_NilValue, cptr,
+			      method, generic, rho, callrho, defrho);
+    return 1;
+}
+
 attribute_hidden
 int usemethod(const char *generic, SEXP obj, SEXP call, SEXP args,
 	      SEXP rho, SEXP callrho, SEXP defrho, SEXP *ans)
 {
-    SEXP klass, method, sxp;
+    SEXP klass, method, sxp, scope, e;
     SEXP op;
-    int i, nclass;
+    int i, nclass, idx = 0;
+    unsigned int epoch = R_S3DispatchEpoch;
+    Rboolean cacheable;
     RCNTXT *cptr;
 
     /* Get the context which UseMethod was called from. */
@@ -354,39 +477,69 @@ int usemethod(const char *generic, SEXP obj, SEXP call, SEXP args,
     op = cptr->callfun;
     PROTECT(klass = R_data_class2(obj));
 
+    if (R_S3DispatchCache == NULL) {
+	R_S3DispatchCache = allocVector(VECSXP, S3_CACHE_SIZE);
+	R_PreserveObject(R_S3DispatchCache);
+    }
+    scope = TYPEOF(callrho) == ENVSXP ? S3CacheScope(callrho) : NULL;
+    cacheable = (scope != NULL);
+    if (cacheable) {
+	idx = S3CacheIndex(generic, klass, scope, defrho);
+	e = S3CacheGet(idx, generic, klass, scope, defrho);
+	if (e != NULL) {
+	    method = VECTOR_ELT(e, S3C_METHOD);
+	    if (method == R_NilValue) {
+		UNPROTECT(1); /* klass */
+		cptr->callflag = CTXT_RETURN;
+		return 0;
+	    }
+	    PROTECT(e);
+	    dispatchFound(op, VECTOR_ELT(e, S3C_FUN), klass,
+			  INTEGER(VECTOR_ELT(e, S3C_INFO))[0], cptr, method,
+			  generic, rho, callrho, defrho, ans);
+	    UNPROTECT(2); /* klass, e */
+	    return 1;
+	}
+    }
+
     nclass = length(klass);
     for (i = 0; i < nclass; i++) {
 	const void *vmax = vmaxget();
 	const char *ss = translateChar(STRING_ELT(klass, i));
 	method = installS3Signature(generic, ss);
 	vmaxset(vmax);
+	if (HAD_ACTIVE_BINDING(method))
+	    cacheable = FALSE;
 	sxp = R_LookupMethod(method, rho, callrho, defrho);
 	if (isFunction(sxp)) {
 	    if(method == R_SortListSymbol && CLOENV(sxp) == R_BaseNamespace)
 		continue; /* kludge because sort.list is not a method */
 	    PROTECT(sxp);
-	    if (i > 0) {
-		SEXP dotClass = PROTECT(stringSuffix(klass, i));
-		setAttrib(dotClass, R_PreviousSymbol, klass);
-		*ans = dispatchMethod(op, sxp, dotClass, cptr, method, generic,
-				      rho, callrho, defrho);
-		UNPROTECT(1); /* dotClass */
-	    } else {
-		*ans = dispatchMethod(op, sxp, klass, cptr, method, generic,
-				      rho, callrho, defrho);
-	    }
+	    if (cacheable)
+		S3CachePut(idx, generic, klass, callrho, scope, defrho,
+			   method, sxp, i, epoch);
+	    dispatchFound(op, sxp, klass, i, cptr, method, generic,
+			  rho, callrho, defrho, ans);
 	    UNPROTECT(2); /* klass, sxp */
 	    return 1;
 	}
     }
     method = installS3Signature(generic, "default");
+    if (HAD_ACTIVE_BINDING(method))
+	cacheable = FALSE;
     PROTECT(sxp = R_LookupMethod(method, rho, callrho, defrho));
     if (isFunction(sxp)) {
-	*ans = dispatchMethod(op, sxp, R_NilValue, cptr, method, generic,
-			      rho, callrho, defrho);
+	if (cacheable)
+	    S3CachePut(idx, generic, klass, callrho, scope, defrho,
+		       method, sxp, -1, epoch);
+	dispatchFound(op, sxp, klass, -1, cptr, method, generic,
+		      rho, callrho, defrho, ans);
 	UNPROTECT(2); /* klass, sxp */
 	return 1;
     }
+    if (cacheable)
+	S3CachePut(idx, generic, klass, callrho, scope, defrho, R_NilValue,
+		   R_NilValue, -1, epoch);
     UNPROTECT(2); /* klass, sxp */
     cptr->callflag = CTXT_RETURN;
     return 0;
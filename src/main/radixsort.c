@@ -1911,5 +1911,9 @@ SEXP attribute_hidden do_radixsort(SEXP call, SEXP op, SEXP args, SEXP rho)
     // TO DO: use xtmp already got
 
     UNPROTECT(1);
+    // an order has no NAs, and is 1:n if x was sorted
+    if (!retGrp)
+	ans = R_wrap_meta(ans, isSorted ? SORTED_INCR : UNKNOWN_SORTEDNESS,
+			  TRUE);
     return ans;
 }
@@ -29,6 +29,8 @@
 #include <errno.h>
 #include <R_ext/Itermacros.h>
 
+#include "arithmetic.h"
+
 /* interval at which to check interrupts, a guess */
 #define NINTERRUPT 10000000
 
@@ -71,30 +73,30 @@ SEXP attribute_hidden do_relop(SEXP call, SEXP op, SEXP args, SEXP env)
     }
     else if (argc == 2) {
 	if (IS_SCALAR(arg1, INTSXP)) {
-	    int ix = INTEGER(arg1)[0];
+	    int ix = SCALAR_IVAL(arg1);
 	    if (IS_SCALAR(arg2, INTSXP)) {
-		int iy = INTEGER(arg2)[0];
+		int iy = SCALAR_IVAL(arg2);
 		if (ix == NA_INTEGER || iy == NA_INTEGER)
 		    return ScalarLogical(NA_LOGICAL);
 		DO_SCALAR_RELOP(oper, ix, iy);
 	    }
 	    else if (IS_SCALAR(arg2, REALSXP)) {
-		double dy = REAL(arg2)[0];
+		double dy = SCALAR_DVAL(arg2);
 		if (ix == NA_INTEGER || ISNAN(dy))
 		    return ScalarLogical(NA_LOGICAL);
 		DO_SCALAR_RELOP(oper, ix, dy);
 	    }
 	}
 	else if (IS_SCALAR(arg1, REALSXP)) {
-	    double dx = REAL(arg1)[0];
+	    double dx = SCALAR_DVAL(arg1);
 	    if (IS_SCALAR(arg2, INTSXP)) {
-		int iy = INTEGER(arg2)[0];
+		int iy = SCALAR_IVAL(arg2);
 		if (ISNAN(dx) || iy == NA_INTEGER)
 		    return ScalarLogical(NA_LOGICAL);
 		DO_SCALAR_RELOP(oper, dx, iy);
 	    }
 	    else if (IS_SCALAR(arg2, REALSXP)) {
-		double dy = REAL(arg2)[0];
+		double dy = SCALAR_DVAL(arg2);
 		if (ISNAN(dx) || ISNAN(dy))
 		    return ScalarLogical(NA_LOGICAL);
 		DO_SCALAR_RELOP(oper, dx, dy);
@@ -313,70 +315,58 @@ SEXP attribute_hidden do_relop_dflt(SEXP call, SEXP op, SEXP x, SEXP y)
 
 #define ISNA_INT(x) x == NA_INTEGER
 
+/* The comparison is made unconditionally and NA selected afterwards,
+   so that the loops are free of branches and can be vectorized. */
+#define RELOP_KERNEL(OP, ISNA1, ISNA2, X, Y) do {			\
+	int __na__ = (ISNA1(X)) | (ISNA2(Y));				\
+	int __r__ = (X) OP (Y);						\
+	pa[i] = __na__ ? NA_LOGICAL : __r__;				\
+    } while (0)
+
+#define NUMERIC_RELOP_LOOP(OP, ISNA1, ISNA2) do {			\
+    if (n1 == n2)							\
+	SIMD_ITERATE_CHECK(NINTERRUPT, n, i, SIMD_LOOP,			\
+			   RELOP_KERNEL(OP, ISNA1, ISNA2, px1[i], px2[i]);); \
+    else if (n2 == 1) {							\
+	x2 = px2[0];							\
+	SIMD_ITERATE_CHECK(NINTERRUPT, n, i, SIMD_LOOP,			\
+			   RELOP_KERNEL(OP, ISNA1, ISNA2, px1[i], x2););	\
+    }									\
+    else if (n1 == 1) {							\
+	x1 = px1[0];							\
+	SIMD_ITERATE_CHECK(NINTERRUPT, n, i, SIMD_LOOP,			\
+			   RELOP_KERNEL(OP, ISNA1, ISNA2, x1, px2[i]););	\
+    }									\
+    else								\
+	MOD_ITERATE2(n, n1, n2, i, i1, i2,				\
+		     RELOP_KERNEL(OP, ISNA1, ISNA2, px1[i1], px2[i2]););	\
+} while(0)
+
 #define NUMERIC_RELOP(type1, ACCESSOR1, ISNA1, type2, ACCESSOR2, ISNA2) do { \
     type1 x1;                                                           \
     type2 x2;                                                           \
+    const type1 *px1 = ACCESSOR1(s1);                                   \
+    const type2 *px2 = ACCESSOR2(s2);                                   \
+    int *pa = LOGICAL(ans);                                             \
                                                                         \
     switch (code) {                                                     \
     case EQOP:                                                          \
-	MOD_ITERATE2(n, n1, n2, i, i1, i2, {                            \
-            x1 = ACCESSOR1(s1)[i1];                                     \
-	    x2 = ACCESSOR2(s2)[i2];                                     \
-	    if (ISNA1(x1) || ISNA2(x2))                                 \
-		LOGICAL(ans)[i] = NA_LOGICAL;                           \
-	    else                                                        \
-		LOGICAL(ans)[i] = (x1 == x2);                           \
-	});                                                             \
+	NUMERIC_RELOP_LOOP(==, ISNA1, ISNA2);                           \
 	break;                                                          \
     case NEOP:                                                          \
-	MOD_ITERATE2(n, n1, n2, i, i1, i2, {                            \
-	    x1 = ACCESSOR1(s1)[i1];                                     \
-	    x2 = ACCESSOR2(s2)[i2];                                     \
-	    if (ISNA1(x1) || ISNA2(x2))                                 \
-		LOGICAL(ans)[i] = NA_LOGICAL;                           \
-	    else                                                        \
-		LOGICAL(ans)[i] = (x1 != x2);                           \
-	});                                                             \
+	NUMERIC_RELOP_LOOP(!=, ISNA1, ISNA2);                           \
 	break;                                                          \
     case LTOP:                                                          \
-	MOD_ITERATE2(n, n1, n2, i, i1, i2, {                            \
-	    x1 = ACCESSOR1(s1)[i1];                                     \
-	    x2 = ACCESSOR2(s2)[i2];                                     \
-	    if (ISNA1(x1) || ISNA2(x2))                                 \
-		LOGICAL(ans)[i] = NA_LOGICAL;                           \
-	    else                                                        \
-		LOGICAL(ans)[i] = (x1 < x2);                            \
-	});                                                             \
+	NUMERIC_RELOP_LOOP(<, ISNA1, ISNA2);                            \
 	break;                                                          \
     case GTOP:                                                          \
-	MOD_ITERATE2(n, n1, n2, i, i1, i2, {                            \
-	    x1 = ACCESSOR1(s1)[i1];                                     \
-	    x2 = ACCESSOR2(s2)[i2];                                     \
-	    if (ISNA1(x1) || ISNA2(x2))                                 \
-		LOGICAL(ans)[i] = NA_LOGICAL;                           \
-	    else                                                        \
-		LOGICAL(ans)[i] = (x1 > x2);                            \
-	});                                                             \
+	NUMERIC_RELOP_LOOP(>, ISNA1, ISNA2);                            \
 	break;                                                          \
     case LEOP:                                                          \
-	MOD_ITERATE2(n, n1, n2, i, i1, i2, {                            \
-	    x1 = ACCESSOR1(s1)[i1];                                     \
-	    x2 = ACCESSOR2(s2)[i2];                                     \
-	    if (ISNA1(x1) || ISNA2(x2))                                 \
-		LOGICAL(ans)[i] = NA_LOGICAL;                           \
-	    else                                                        \
-		LOGICAL(ans)[i] = (x1 <= x2);                           \
-	});                                                             \
+	NUMERIC_RELOP_LOOP(<=, ISNA1, ISNA2);                           \
 	break;                                                          \
     case GEOP:                                                          \
-	MOD_ITERATE2(n, n1, n2, i, i1, i2, {                            \
-            x1 = ACCESSOR1(s1)[i1];                                     \
-	    x2 = ACCESSOR2(s2)[i2];                                     \
-	    if (ISNA1(x1) || ISNA2(x2))                                 \
-		LOGICAL(ans)[i] = NA_LOGICAL;                           \
-	    else                                                        \
-		LOGICAL(ans)[i] = (x1 >= x2);                           \
-	});                                                             \
+	NUMERIC_RELOP_LOOP(>=, ISNA1, ISNA2);                           \
 	break;                                                          \
     }                                                                   \
 } while(0)
@@ -391,21 +381,21 @@ static SEXP numeric_relop(RELOP_TYPE code, SEXP s1, SEXP s2)
     n = (n1 > n2) ? n1 : n2;
     PROTECT(s1);
     PROTECT(s2);
-    ans = allocVector(LGLSXP, n);
+    PROTECT(ans = allocVector(LGLSXP, n));
 
     if (isInteger(s1) || isLogical(s1)) {
         if (isInteger(s2) || isLogical(s2)) {
-            NUMERIC_RELOP(int, INTEGER, ISNA_INT, int, INTEGER, ISNA_INT);
+            NUMERIC_RELOP(int, INTEGER_RO, ISNA_INT, int, INTEGER_RO, ISNA_INT);
         } else {
-            NUMERIC_RELOP(int, INTEGER, ISNA_INT, double, REAL, ISNAN);
+            NUMERIC_RELOP(int, INTEGER_RO, ISNA_INT, double, REAL_RO, ISNAN);
         }
     } else if (isInteger(s2) || isLogical(s2)) {
-        NUMERIC_RELOP(double, REAL, ISNAN, int, INTEGER, ISNA_INT);
+        NUMERIC_RELOP(double, REAL_RO, ISNAN, int, INTEGER_RO, ISNA_INT);
     } else {
-        NUMERIC_RELOP(double, REAL, ISNAN, double, REAL, ISNAN);
+        NUMERIC_RELOP(double, REAL_RO, ISNAN, double, REAL_RO, ISNAN);
     }
 
-    UNPROTECT(2);
+    UNPROTECT(3);
     return ans;
 }
 
@@ -963,8 +963,6 @@ in version 1 workspaces"));
 	} while (0)
 
 #define LOGICAL_ELT(x,__i__)	LOGICAL(x)[__i__]
-#define INTEGER_ELT(x,__i__)	INTEGER(x)[__i__]
-#define REAL_ELT(x,__i__)	REAL(x)[__i__]
 #define COMPLEX_ELT(x,__i__)	COMPLEX(x)[__i__]
 
 /* Simply outputs the string associated with a CHARSXP, one day this
@@ -1140,7 +1138,9 @@ static void NewDataSave (SEXP s, FILE *fp, OutputRoutines *m, SaveLoadData *d)
 	R_assert(TYPEOF(CAR(iterator)) == ENVSXP);
 	NewWriteItem(ENCLOS(CAR(iterator)), sym_table, env_table, fp, m, d);
 	NewWriteItem(FRAME(CAR(iterator)), sym_table, env_table, fp, m, d);
-	NewWriteItem(TAG(CAR(iterator)), sym_table, env_table, fp, m, d);
+	NewWriteItem(PROTECT(R_HashTableForSave(TAG(CAR(iterator)))),
+		     sym_table, env_table, fp, m, d);
+	UNPROTECT(1);
     }
     NewWriteItem(s, sym_table, env_table, fp, m, d);
 
@@ -1162,8 +1162,8 @@ static void NewDataSave (SEXP s, FILE *fp, OutputRoutines *m, SaveLoadData *d)
 
 
 #define SET_LOGICAL_ELT(x,__i__,v)	(LOGICAL_ELT(x,__i__)=(v))
-#define SET_INTEGER_ELT(x,__i__,v)	(INTEGER_ELT(x,__i__)=(v))
-#define SET_REAL_ELT(x,__i__,v)		(REAL_ELT(x,__i__)=(v))
+#define SET_INTEGER_ELT(x,__i__,v)	(INTEGER(x)[__i__]=(v))
+#define SET_REAL_ELT(x,__i__,v)		(REAL(x)[__i__]=(v))
 #define SET_COMPLEX_ELT(x,__i__,v)	(COMPLEX_ELT(x,__i__)=(v))
 
 static SEXP InCHARSXP (FILE *fp, InputRoutines *m, SaveLoadData *d)
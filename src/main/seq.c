@@ -114,32 +114,15 @@ static SEXP seq_colon(double n1, double n2, SEXP call)
 	    if(r <= INT_MIN || r > INT_MAX) useInt = FALSE;
 	}
     }
+    /* long enough results are compact sequences, see altclasses.c */
     if (useInt) {
 	int in1 = (int)(n1);
-	ans = allocVector(INTSXP, n);
 	if (n1 <= n2)
-	    for (int i = 0; i < n; i++) {
-//		if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-		INTEGER(ans)[i] = in1 + i;
-	    }
-	else
-	    for (int i = 0; i < n; i++) {
-//		if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-		INTEGER(ans)[i] = in1 - i;
-	    }
-    } else {
-	ans = allocVector(REALSXP, n);
-	if (n1 <= n2)
-	    for (R_xlen_t i = 0; i < n; i++) {
-//		if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-		REAL(ans)[i] = n1 + (double)i;
-	    }
+	    ans = R_compact_intrange(in1, in1 + (n - 1));
 	else
-	    for (R_xlen_t i = 0; i < n; i++) {
-//		if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-		REAL(ans)[i] = n1 - (double)i;
-	    }
-    }
+	    ans = R_compact_intrange(in1, in1 - (n - 1));
+    } else
+	ans = R_compact_realseq(n, n1, n1 <= n2 ? 1 : -1);
     return ans;
 }
 
@@ -912,6 +895,7 @@ SEXP attribute_hidden do_seq(SEXP call, SEXP op, SEXP args, SEXP rho)
 		    if((rby > 0 && ra[nn] > rto) || (rby < 0 && ra[nn] < rto))
 			ra[nn] = rto;
 	    }
+	    ans = R_wrap_meta(ans, rby > 0 ? SORTED_INCR : SORTED_DECR, TRUE);
 	}
     } else if (lout == 0) {
 	ans = allocVector(INTSXP, 0);
@@ -1026,30 +1010,17 @@ SEXP attribute_hidden do_seq_along(SEXP call, SEXP op, SEXP args, SEXP rho)
     else
 	len = xlength(CAR(args));
 
+    if (len == 0)
+	return allocVector(INTSXP, 0);
 #ifdef LONG_VECTOR_SUPPORT
-    if (len > INT_MAX) {
-	ans = allocVector(REALSXP, len);
-	double *p = REAL(ans);
-	for(R_xlen_t i = 0; i < len; i++) {
-//	    if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-	    p[i] = (double) (i+1);
-	}
-    } else
+    if (len > INT_MAX)
+	return R_compact_realseq(len, 1, 1);
 #endif
-    {
-	ans = allocVector(INTSXP, len);
-	int *p = INTEGER(ans);
-	for(int i = 0; i < len; i++) {
-//	    if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-	    p[i] = i+1;
-	}
-    }
-    return ans;
+    return R_compact_intrange(1, len);
 }
 
 SEXP attribute_hidden do_seq_len(SEXP call, SEXP op, SEXP args, SEXP rho)
 {
-    SEXP ans;
     R_xlen_t len;
 
     checkArity(op, args);
@@ -1069,23 +1040,11 @@ SEXP attribute_hidden do_seq_len(SEXP call, SEXP op, SEXP args, SEXP rho)
 	errorcall(call, _("argument must be coercible to non-negative integer"));
 #endif
 
+    if (len == 0)
+	return allocVector(INTSXP, 0);
  #ifdef LONG_VECTOR_SUPPORT
-    if (len > INT_MAX) {
-	ans = allocVector(REALSXP, len);
-	double *p = REAL(ans);
-	for(R_xlen_t i = 0; i < len; i++) {
-//	    if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-	    p[i] = (double) (i+1);
-	}
-    } else
+    if (len > INT_MAX)
+	return R_compact_realseq(len, 1, 1);
 #endif
-    {
-	ans = allocVector(INTSXP, len);
-	int *p = INTEGER(ans);
-	for(int i = 0; i < len; i++) {
-//	    if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-	    p[i] = i+1;
-	}
-    }
-    return ans;
+    return R_compact_intrange(1, len);
 }
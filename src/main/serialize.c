@@ -1018,7 +1018,9 @@ static void WriteItem (SEXP s, SEXP ref_table, R_outpstream_t stream)
 	    OutInteger(stream, R_EnvironmentIsLocked(s) ? 1 : 0);
 	    WriteItem(ENCLOS(s), ref_table, stream);
 	    WriteItem(FRAME(s), ref_table, stream);
-	    WriteItem(HASHTAB(s), ref_table, stream);
+	    WriteItem(PROTECT(R_HashTableForSave(HASHTAB(s))), ref_table,
+		      stream);
+	    UNPROTECT(1);
 	    WriteItem(ATTRIB(s), ref_table, stream);
 	}
     }
@@ -87,6 +87,32 @@ Rboolean isUnsorted(SEXP x, Rboolean strictly)
     if (!isVectorAtomic(x))
 	error(_("only atomic vectors can be tested to be sorted"));
     n = XLENGTH(x);
+    if(n >= 2 && (TYPEOF(x) == INTSXP || TYPEOF(x) == REALSXP)) {
+	/* An NA-free vector known to be sorted needs no scan, unless
+	   strictly increasing order is asked of a non-decreasing one. */
+	int sorted, nona;
+	if(TYPEOF(x) == INTSXP) {
+	    sorted = INTEGER_IS_SORTED(x);
+	    nona = INTEGER_NO_NA(x);
+	} else {
+	    sorted = REAL_IS_SORTED(x);
+	    nona = REAL_NO_NA(x);
+	}
+	if(nona && sorted == SORTED_INCR && !strictly)
+	    return FALSE;
+	if(nona && sorted == SORTED_DECR) {
+	    double first, last;
+	    if(TYPEOF(x) == INTSXP) {
+		first = INTEGER_ELT(x, 0);
+		last = INTEGER_ELT(x, n - 1);
+	    } else {
+		first = REAL_ELT(x, 0);
+		last = REAL_ELT(x, n - 1);
+	    }
+	    /* unless all elements are equal */
+	    return first > last || strictly;
+	}
+    }
     if(n >= 2)
 	switch (TYPEOF(x)) {
 
@@ -97,28 +123,34 @@ Rboolean isUnsorted(SEXP x, Rboolean strictly)
 	       but we want the if() outside the loop */
 	case LGLSXP:
 	case INTSXP:
+	{
+	    const int *px = INTEGER_RO(x);
 	    if(strictly) {
 		for(i = 0; i+1 < n ; i++)
-		    if(INTEGER(x)[i] >= INTEGER(x)[i+1])
+		    if(px[i] >= px[i+1])
 			return TRUE;
 
 	    } else {
 		for(i = 0; i+1 < n ; i++)
-		    if(INTEGER(x)[i] > INTEGER(x)[i+1])
+		    if(px[i] > px[i+1])
 			return TRUE;
 	    }
 	    break;
+	}
 	case REALSXP:
+	{
+	    const double *px = REAL_RO(x);
 	    if(strictly) {
 		for(i = 0; i+1 < n ; i++)
-		    if(REAL(x)[i] >= REAL(x)[i+1])
+		    if(px[i] >= px[i+1])
 			return TRUE;
 	    } else {
 		for(i = 0; i+1 < n ; i++)
-		    if(REAL(x)[i] > REAL(x)[i+1])
+		    if(px[i] > px[i+1])
 			return TRUE;
 	    }
 	    break;
+	}
 	case CPLXSXP:
 	    if(strictly) {
 		for(i = 0; i+1 < n ; i++)
@@ -1298,7 +1330,7 @@ SEXP attribute_hidden do_order(SEXP call, SEXP op, SEXP args, SEXP rho)
 	    }
 	}
 	UNPROTECT(1);
-	return ans;
+	return R_wrap_meta(ans, UNKNOWN_SORTEDNESS, TRUE);
     } else return allocVector(INTSXP, 0);
 }
 
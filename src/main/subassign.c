@@ -179,11 +179,8 @@ static SEXP EnlargeVector(SEXP x, R_xlen_t newlen)
 	/* sometimes this is called when no expansion is needed */
 	newtruelen = newlen;
 
-    /**** for now, don't cross the long vector boundary; drop when
-	  ALTREP is merged */
-#ifdef ALTREP
-#error drop the limitation to short vectors
-#endif
+    /**** for now, don't cross the long vector boundary: the true
+	  length of a short vector cannot exceed R_LEN_T_MAX */
     if (newtruelen > R_LEN_T_MAX) newtruelen = newlen;
 
     PROTECT(x);
@@ -570,18 +567,18 @@ static SEXP VectorAssign(SEXP call, SEXP rho, SEXP x, SEXP s, SEXP y)
     if (ATTRIB(s) == R_NilValue) {
 	if (TYPEOF(x) == REALSXP && IS_SCALAR(y, REALSXP)) {
 	    if (IS_SCALAR(s, INTSXP)) {
-		R_xlen_t ival = INTEGER(s)[0];
+		R_xlen_t ival = SCALAR_IVAL(s);
 		if (1 <= ival && ival <= XLENGTH(x)) {
-		    REAL(x)[ival - 1] = REAL(y)[0];
+		    REAL(x)[ival - 1] = SCALAR_DVAL(y);
 		    return x;
 		}
 	    }
 	    else if (IS_SCALAR(s, REALSXP)) {
-		double dval = REAL(s)[0];
+		double dval = SCALAR_DVAL(s);
 		if (R_FINITE(dval)) {
 		    R_xlen_t ival = (R_xlen_t) dval;
 		    if (1 <= ival && ival <= XLENGTH(x)) {
-			REAL(x)[ival - 1] = REAL(y)[0];
+			REAL(x)[ival - 1] = SCALAR_DVAL(y);
 			return x;
 		    }
 		}
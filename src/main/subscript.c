@@ -630,7 +630,8 @@ static SEXP positiveSubscript(SEXP s, R_xlen_t ns, R_xlen_t nx)
 {
     SEXP indx;
     R_xlen_t i, zct = 0;
-    for (i = 0; i < ns; i++) if (INTEGER(s)[i] == 0) zct++;
+    const int *ps = INTEGER_RO(s);
+    for (i = 0; i < ns; i++) if (ps[i] == 0) zct++;
     if (zct) {
 	indx = allocVector(INTSXP, (ns - zct));
 	for (i = 0, zct = 0; i < ns; i++)
@@ -651,8 +652,19 @@ integerSubscript(SEXP s, R_xlen_t ns, R_xlen_t nx, R_xlen_t *stretch, SEXP call)
     *stretch = 0;
     min = 0;
     max = 0;
+    int sorted = ns > 0 && INTEGER_NO_NA(s) ?
+	INTEGER_IS_SORTED(s) : UNKNOWN_SORTEDNESS;
+    if (sorted == SORTED_INCR || sorted == SORTED_DECR) {
+	/* the range of a sorted NA-free index is known */
+	int first = INTEGER_ELT(s, 0), last = INTEGER_ELT(s, ns - 1);
+	int lo = sorted == SORTED_INCR ? first : last;
+	int hi = sorted == SORTED_INCR ? last : first;
+	if (lo > 0 && hi <= nx)
+	    return s;
+    }
+    const int *ps = INTEGER_RO(s);
     for (i = 0; i < ns; i++) {
-	ii = INTEGER(s)[i];
+	ii = ps[i];
 	if (ii != NA_INTEGER) {
 	    if (ii < min)
 		min = ii;
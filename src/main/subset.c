@@ -56,6 +56,45 @@ static R_INLINE SEXP VECTOR_ELT_FIX_NAMED(SEXP y, R_xlen_t i) {
     return val;
 }
 
+/* The common integer, logical and real cases of ExtractSubset, with
+   the data pointers taken once.  ALTREP vectors without a data pointer
+   at hand are read by element, so that taking a few elements of a
+   compact sequence does not expand it. */
+
+#define EXTRACT_SUBSET_LOOP(type, PTR, ELT, NAVAL) do {			\
+	type *pr = PTR(result);						\
+	const type *px = (const type *) DATAPTR_OR_NULL(x);		\
+	for (i = 0; i < n; i++) {					\
+	    if (pi != NULL) {						\
+		ii = pi[i];						\
+		if (ii != NA_INTEGER) ii--;				\
+	    }								\
+	    else if (!R_FINITE(pd[i])) ii = NA_INTEGER;			\
+	    else ii = (R_xlen_t) (pd[i] - 1);				\
+	    if (0 <= ii && ii < nx && ii != NA_INTEGER)			\
+		pr[i] = px != NULL ? px[ii] : ELT(x, ii);		\
+	    else							\
+		pr[i] = NAVAL;						\
+	}								\
+    } while (0)
+
+static void ExtractNumericSubset(SEXP x, SEXP result, SEXP indx)
+{
+    R_xlen_t i, ii, n = XLENGTH(indx), nx = XLENGTH(x);
+    const int *pi = TYPEOF(indx) == REALSXP ? NULL : INTEGER_RO(indx);
+    const double *pd = TYPEOF(indx) == REALSXP ? REAL_RO(indx) : NULL;
+
+    switch (TYPEOF(x)) {
+    case LGLSXP:
+    case INTSXP:
+	EXTRACT_SUBSET_LOOP(int, INTEGER, INTEGER_ELT, NA_INTEGER);
+	break;
+    case REALSXP:
+	EXTRACT_SUBSET_LOOP(double, REAL, REAL_ELT, NA_REAL);
+	break;
+    }
+}
+
 /* ExtractSubset does the transfer of elements from "x" to "result"
    according to the integer/real subscripts given in "indx". */
 
@@ -73,6 +112,11 @@ static SEXP ExtractSubset(SEXP x, SEXP result, SEXP indx, SEXP call)
     if (x == R_NilValue)
 	return x;
 
+    if (mode == LGLSXP || mode == INTSXP || mode == REALSXP) {
+	ExtractNumericSubset(x, result, indx);
+	return result;
+    }
+
     for (i = 0; i < n; i++) {
 	switch(mi) {
 	case REALSXP:
@@ -668,13 +712,13 @@ static R_INLINE R_xlen_t scalarIndex(SEXP s)
 {
     if (ATTRIB(s) == R_NilValue) {
 	if (IS_SCALAR(s, INTSXP)) {
-	    int ival = INTEGER(s)[0];
+	    int ival = SCALAR_IVAL(s);
 	    if (ival != NA_INTEGER)
 		return ival;
 	    else return -1;
 	}
 	else if (IS_SCALAR(s, REALSXP)) {
-	    double rval = REAL(s)[0];
+	    double rval = SCALAR_DVAL(s);
 	    // treat infinite indices as NA, like asInteger
 	    if (R_FINITE(rval))
 		return (R_xlen_t) rval;
@@ -1076,10 +1120,10 @@ SEXP attribute_hidden do_subset2_dflt(SEXP call, SEXP op, SEXP args, SEXP rho)
 	switch (TYPEOF(x)) {
 	case LGLSXP:
 	case INTSXP:
-	    INTEGER(ans)[0] = INTEGER(x)[offset];
+	    INTEGER(ans)[0] = INTEGER_ELT(x, offset);
 	    break;
 	case REALSXP:
-	    REAL(ans)[0] = REAL(x)[offset];
+	    REAL(ans)[0] = REAL_ELT(x, offset);
 	    break;
 	case CPLXSXP:
 	    COMPLEX(ans)[0] = COMPLEX(x)[offset];
@@ -29,6 +29,7 @@
 #include <float.h> // for DBL_MAX
 
 #include "duplicate.h"
+#include "arithmetic.h"
 
 #define R_MSG_type	_("invalid 'type' (%s) of argument")
 #define imax2(x, y) ((x < y) ? y : x)
@@ -48,7 +49,7 @@
 #endif
 
 #ifdef LONG_INT
-static Rboolean isum(int *x, R_xlen_t n, int *value, Rboolean narm, SEXP call)
+static Rboolean isum(const int *x, R_xlen_t n, int *value, Rboolean narm, SEXP call)
 {
     LONG_INT s = 0;  // at least 64-bit
     Rboolean updated = FALSE;
@@ -87,7 +88,7 @@ static Rboolean isum(int *x, R_xlen_t n, int *value, Rboolean narm, SEXP call)
 }
 #else
 /* Version from R 3.0.0: should never be used with a C99/C11 compiler */
-static Rboolean isum(int *x, R_xlen_t n, int *value, Rboolean narm, SEXP call)
+static Rboolean isum(const int *x, R_xlen_t n, int *value, Rboolean narm, SEXP call)
 {
     double s = 0.0;
     Rboolean updated = FALSE;
@@ -112,7 +113,7 @@ static Rboolean isum(int *x, R_xlen_t n, int *value, Rboolean narm, SEXP call)
 }
 #endif
 
-static Rboolean rsum(double *x, R_xlen_t n, double *value, Rboolean narm)
+static Rboolean rsum(const double *x, R_xlen_t n, double *value, Rboolean narm)
 {
     LDOUBLE s = 0.0;
     Rboolean updated = FALSE;
@@ -148,7 +149,7 @@ static Rboolean csum(Rcomplex *x, R_xlen_t n, Rcomplex *value, Rboolean narm)
     return updated;
 }
 
-static Rboolean imin(int *x, R_xlen_t n, int *value, Rboolean narm)
+static Rboolean imin(const int *x, R_xlen_t n, int *value, Rboolean narm)
 {
     int s = 0 /* -Wall */;
     Rboolean updated = FALSE;
@@ -171,7 +172,7 @@ static Rboolean imin(int *x, R_xlen_t n, int *value, Rboolean narm)
     return updated;
 }
 
-static Rboolean rmin(double *x, R_xlen_t n, double *value, Rboolean narm)
+static Rboolean rmin(const double *x, R_xlen_t n, double *value, Rboolean narm)
 {
     double s = 0.0; /* -Wall */
     Rboolean updated = FALSE;
@@ -219,7 +220,7 @@ static Rboolean smin(SEXP x, SEXP *value, Rboolean narm)
     return updated;
 }
 
-static Rboolean imax(int *x, R_xlen_t n, int *value, Rboolean narm)
+static Rboolean imax(const int *x, R_xlen_t n, int *value, Rboolean narm)
 {
     int s = 0 /* -Wall */;
     Rboolean updated = FALSE;
@@ -240,7 +241,7 @@ static Rboolean imax(int *x, R_xlen_t n, int *value, Rboolean narm)
     return updated;
 }
 
-static Rboolean rmax(double *x, R_xlen_t n, double *value, Rboolean narm)
+static Rboolean rmax(const double *x, R_xlen_t n, double *value, Rboolean narm)
 {
     double s = 0.0 /* -Wall */;
     Rboolean updated = FALSE;
@@ -287,7 +288,7 @@ static Rboolean smax(SEXP x, SEXP *value, Rboolean narm)
     return updated;
 }
 
-static Rboolean iprod(int *x, R_xlen_t n, double *value, Rboolean narm)
+static Rboolean iprod(const int *x, R_xlen_t n, double *value, Rboolean narm)
 {
     LDOUBLE s = 1.0;
     Rboolean updated = FALSE;
@@ -316,7 +317,7 @@ static Rboolean iprod(int *x, R_xlen_t n, double *value, Rboolean narm)
     return updated;
 }
 
-static Rboolean rprod(double *x, R_xlen_t n, double *value, Rboolean narm)
+static Rboolean rprod(const double *x, R_xlen_t n, double *value, Rboolean narm)
 {
     LDOUBLE s = 1.0;
     Rboolean updated = FALSE;
@@ -415,27 +416,33 @@ SEXP attribute_hidden do_summary(SEXP call, SEXP op, SEXP args, SEXP env)
 	switch(TYPEOF(x)) {
 	case LGLSXP:
 	case INTSXP:
+	{
 	    PROTECT(ans = allocVector(REALSXP, 1));
+	    const int *px = INTEGER_RO(x);
 	    for (i = 0; i < n; i++) {
-		if(INTEGER(x)[i] == NA_INTEGER) {
+		if(px[i] == NA_INTEGER) {
 		    REAL(ans)[0] = R_NaReal;
 		    UNPROTECT(1); /* ans */
 		    return ans;
 		}
-		s += INTEGER(x)[i];
+		s += px[i];
 	    }
 	    REAL(ans)[0] = (double) (s/n);
 	    break;
+	}
 	case REALSXP:
+	{
 	    PROTECT(ans = allocVector(REALSXP, 1));
-	    for (i = 0; i < n; i++) s += REAL(x)[i];
+	    const double *px = REAL_RO(x);
+	    for (i = 0; i < n; i++) s += px[i];
 	    s /= n;
 	    if(R_FINITE((double)s)) {
-		for (i = 0; i < n; i++) t += (REAL(x)[i] - s);
+		for (i = 0; i < n; i++) t += (px[i] - s);
 		s += t/n;
 	    }
 	    REAL(ans)[0] = (double) s;
 	    break;
+	}
 	case CPLXSXP:
 	    PROTECT(ans = allocVector(CPLXSXP, 1));
 	    for (i = 0; i < n; i++) {
@@ -482,6 +489,26 @@ SEXP attribute_hidden do_summary(SEXP call, SEXP op, SEXP args, SEXP env)
     empty = 1;/*- =1: only zero-length arguments, or NA with na.rm=T */
 
     int iop = PRIMVAL(op);
+
+    /* min or max of a single NA-free vector known to be sorted */
+    if ((iop == 2 || iop == 3) && args != R_NilValue &&
+	CDR(args) == R_NilValue) {
+	SEXP x = CAR(args);
+	R_xlen_t n = 0;
+	int sorted = UNKNOWN_SORTEDNESS;
+	if (TYPEOF(x) == INTSXP && (n = XLENGTH(x)) > 0 && INTEGER_NO_NA(x))
+	    sorted = INTEGER_IS_SORTED(x);
+	else if (TYPEOF(x) == REALSXP && (n = XLENGTH(x)) > 0 &&
+		 REAL_NO_NA(x))
+	    sorted = REAL_IS_SORTED(x);
+	if (sorted == SORTED_INCR || sorted == SORTED_DECR) {
+	    R_xlen_t i = (iop == 2) == (sorted == SORTED_INCR) ? 0 : n - 1;
+	    ans = TYPEOF(x) == INTSXP ?
+		ScalarInteger(INTEGER_ELT(x, i)) : ScalarReal(REAL_ELT(x, i));
+	    UNPROTECT(1); /* args */
+	    return ans;
+	}
+    }
     switch(iop) {
     case 0:/* sum */
     /* we need to find out if _all_ the arguments are integer or logical
@@ -546,8 +573,8 @@ SEXP attribute_hidden do_summary(SEXP call, SEXP op, SEXP args, SEXP env)
 		case LGLSXP:
 		case INTSXP:
 		    int_a = 1;
-		    if (iop == 2) updated = imin(INTEGER(a), XLENGTH(a), &itmp, narm);
-		    else	  updated = imax(INTEGER(a), XLENGTH(a), &itmp, narm);
+		    if (iop == 2) updated = imin(INTEGER_RO(a), XLENGTH(a), &itmp, narm);
+		    else	  updated = imax(INTEGER_RO(a), XLENGTH(a), &itmp, narm);
 		    break;
 		case REALSXP:
 		    real_a = 1;
@@ -555,8 +582,8 @@ SEXP attribute_hidden do_summary(SEXP call, SEXP op, SEXP args, SEXP env)
 			ans_type = REALSXP;
 			if(!empty) zcum.r = Int2Real(icum);
 		    }
-		    if (iop == 2) updated = rmin(REAL(a), XLENGTH(a), &tmp, narm);
-		    else	  updated = rmax(REAL(a), XLENGTH(a), &tmp, narm);
+		    if (iop == 2) updated = rmin(REAL_RO(a), XLENGTH(a), &tmp, narm);
+		    else	  updated = rmax(REAL_RO(a), XLENGTH(a), &tmp, narm);
 		    break;
 		case STRSXP:
 		    if(!empty && ans_type == INTSXP) {
@@ -629,7 +656,7 @@ SEXP attribute_hidden do_summary(SEXP call, SEXP op, SEXP args, SEXP env)
 		case LGLSXP:
 		case INTSXP:
 		    updated = isum(TYPEOF(a) == LGLSXP ?
-				   LOGICAL(a) :INTEGER(a), XLENGTH(a),
+				   LOGICAL_RO(a) : INTEGER_RO(a), XLENGTH(a),
 				   &itmp, narm, call);
 		    if(updated) {
 			if(itmp == NA_INTEGER) goto na_answer;
@@ -649,7 +676,7 @@ SEXP attribute_hidden do_summary(SEXP call, SEXP op, SEXP args, SEXP env)
 			ans_type = REALSXP;
 			if(!empty) zcum.r = Int2Real(icum);
 		    }
-		    updated = rsum(REAL(a), XLENGTH(a), &tmp, narm);
+		    updated = rsum(REAL_RO(a), XLENGTH(a), &tmp, narm);
 		    if(updated) {
 			zcum.r += tmp;
 		    }
@@ -679,9 +706,9 @@ SEXP attribute_hidden do_summary(SEXP call, SEXP op, SEXP args, SEXP env)
 		case INTSXP:
 		case REALSXP:
 		    if(TYPEOF(a) == REALSXP)
-			updated = rprod(REAL(a), XLENGTH(a), &tmp, narm);
+			updated = rprod(REAL_RO(a), XLENGTH(a), &tmp, narm);
 		    else
-			updated = iprod(INTEGER(a), XLENGTH(a), &tmp, narm);
+			updated = iprod(INTEGER_RO(a), XLENGTH(a), &tmp, narm);
 		    if(updated) {
 			zcum.r *= tmp;
 			zcum.i *= tmp;
@@ -917,11 +944,26 @@ SEXP attribute_hidden do_which(SEXP call, SEXP op, SEXP args, SEXP rho)
     len = length(v);
     buf = (int *) R_alloc(len, sizeof(int));
 
-    for (i = 0; i < len; i++) {
-	if (LOGICAL(v)[i] == TRUE) {
-	    buf[j] = i + 1;
-	    j++;
+    /* Scan blocks of WHICH_BLOCK elements: count the TRUE values with
+       a loop which can be vectorized, skip blocks without any, and
+       store the indices of the others without branching. */
+#define WHICH_BLOCK 64
+    const int *pv = LOGICAL_RO(v);
+    for (i = 0; i < len; i += WHICH_BLOCK) {
+	int k, m = (len - i < WHICH_BLOCK) ? len - i : WHICH_BLOCK, cnt = 0;
+	SIMD_LOOP_SUM(cnt)
+	for (k = 0; k < m; k++)
+	    cnt += (pv[i + k] == TRUE) ? 1 : 0;
+	if (cnt == m) {
+	    for (k = 0; k < m; k++)
+		buf[j + k] = i + k + 1;
+	    j += m;
 	}
+	else if (cnt > 0)
+	    for (k = 0; k < m; k++) {
+		buf[j] = i + k + 1;
+		j += pv[i + k] == TRUE;
+	    }
     }
 
     len = j;
@@ -522,12 +522,59 @@ SEXP duplicated(SEXP x, Rboolean from_last)
     return ans;
 }
 
+/* In an NA-free integer or real vector known to be sorted, equal
+   elements are adjacent, so duplicates are found without hashing. */
+static Rboolean isSortedNoNA(SEXP x)
+{
+    int sorted;
+    switch (TYPEOF(x)) {
+    case INTSXP:
+	if (!INTEGER_NO_NA(x)) return FALSE;
+	sorted = INTEGER_IS_SORTED(x);
+	break;
+    case REALSXP:
+	if (!REAL_NO_NA(x)) return FALSE;
+	sorted = REAL_IS_SORTED(x);
+	break;
+    default:
+	return FALSE;
+    }
+    return sorted == SORTED_INCR || sorted == SORTED_DECR;
+}
+
+#define SORTED_DUPLICATED_LOOP(type, ACCESSOR) do {			\
+	const type *px = ACCESSOR(x);					\
+	if (from_last) {						\
+	    for (R_xlen_t i = 0; i < n - 1; i++)			\
+		v[i] = px[i] == px[i + 1];				\
+	    v[n - 1] = 0;						\
+	} else {							\
+	    v[0] = 0;							\
+	    for (R_xlen_t i = 1; i < n; i++)				\
+		v[i] = px[i] == px[i - 1];				\
+	}								\
+    } while (0)
+
+static SEXP sortedDuplicated(SEXP x, Rboolean from_last)
+{
+    R_xlen_t n = XLENGTH(x);
+    SEXP ans = PROTECT(allocVector(LGLSXP, n));
+    int *v = LOGICAL(ans);
+    if (TYPEOF(x) == INTSXP)
+	SORTED_DUPLICATED_LOOP(int, INTEGER_RO);
+    else
+	SORTED_DUPLICATED_LOOP(double, REAL_RO);
+    UNPROTECT(1);
+    return ans;
+}
+
 static SEXP Duplicated(SEXP x, Rboolean from_last, int nmax)
 {
     SEXP ans;
     int *v;
 
     if (!isVector(x)) error(_("'duplicated' applies only to vectors"));
+    if (isSortedNoNA(x)) return sortedDuplicated(x, from_last);
     R_xlen_t i, n = XLENGTH(x);
     DUPLICATED_INIT;
 
@@ -560,6 +607,27 @@ R_xlen_t any_duplicated(SEXP x, Rboolean from_last)
     if (!isVector(x)) error(_("'duplicated' applies only to vectors"));
     R_xlen_t i, n = XLENGTH(x);
 
+    if (isSortedNoNA(x)) {
+	if (TYPEOF(x) == INTSXP) {
+	    const int *px = INTEGER_RO(x);
+	    if (from_last) {
+		for (i = n - 2; i >= 0; i--)
+		    if (px[i] == px[i + 1]) return i + 1;
+	    } else
+		for (i = 1; i < n; i++)
+		    if (px[i] == px[i - 1]) return i + 1;
+	} else {
+	    const double *px = REAL_RO(x);
+	    if (from_last) {
+		for (i = n - 2; i >= 0; i--)
+		    if (px[i] == px[i + 1]) return i + 1;
+	    } else
+		for (i = 1; i < n; i++)
+		    if (px[i] == px[i - 1]) return i + 1;
+	}
+	return 0;
+    }
+
     DUPLICATED_INIT;
     PROTECT(data.HashTable);
 
@@ -735,15 +803,24 @@ SEXP attribute_hidden do_duplicated(SEXP call, SEXP op, SEXP args, SEXP env)
     switch (TYPEOF(x)) {
     case LGLSXP:
     case INTSXP:
+    {
+	const int *px = INTEGER_RO(x), *pd = LOGICAL_RO(dup);
+	int *pa = INTEGER(ans);
 	for (i = 0; i < n; i++)
-	    if (LOGICAL(dup)[i] == 0)
-		INTEGER(ans)[k++] = INTEGER(x)[i];
+	    if (pd[i] == 0)
+		pa[k++] = px[i];
 	break;
+    }
     case REALSXP:
+    {
+	const double *px = REAL_RO(x);
+	const int *pd = LOGICAL_RO(dup);
+	double *pa = REAL(ans);
 	for (i = 0; i < n; i++)
-	    if (LOGICAL(dup)[i] == 0)
-		REAL(ans)[k++] = REAL(x)[i];
+	    if (pd[i] == 0)
+		pa[k++] = px[i];
 	break;
+    }
     case CPLXSXP:
 	for (i = 0; i < n; i++)
 	    if (LOGICAL(dup)[i] == 0) {
@@ -835,6 +912,43 @@ static SEXP match_transform(SEXP s, SEXP env)
     return duplicate(s);
 }
 
+/* Matches the integer or real vector x in a table of the same type
+   known to be sorted, increasing if incr is true and decreasing
+   otherwise, and free of NAs: the first of equal elements is found
+   by bisection. */
+#define MATCH_SORTED_LOOP(type, ELT, isna) do {				\
+	for (R_xlen_t i = 0; i < n; i++) {				\
+	    type v = ELT(x, i);						\
+	    R_xlen_t lo = 0, hi = nt;					\
+	    if (isna(v)) {						\
+		pa[i] = nmatch;						\
+		continue;						\
+	    }								\
+	    while (lo < hi) {						\
+		R_xlen_t mid = lo + (hi - lo) / 2;			\
+		type t = ELT(table, mid);				\
+		if (incr ? t < v : t > v) lo = mid + 1;			\
+		else hi = mid;						\
+	    }								\
+	    pa[i] = lo < nt && ELT(table, lo) == v ? (int) (lo + 1) : nmatch; \
+	}								\
+    } while (0)
+
+#define INTEGER_ISNA(v) ((v) == NA_INTEGER)
+
+static SEXP match_sorted(SEXP x, SEXP table, Rboolean incr, int nmatch)
+{
+    R_xlen_t n = XLENGTH(x), nt = XLENGTH(table);
+    SEXP ans = allocVector(INTSXP, n);
+    int *pa = INTEGER(ans);
+
+    if (TYPEOF(x) == INTSXP)
+	MATCH_SORTED_LOOP(int, INTEGER_ELT, INTEGER_ISNA);
+    else
+	MATCH_SORTED_LOOP(double, REAL_ELT, ISNAN);
+    return ans;
+}
+
 // workhorse of R's match() and hence also  " ix %in% itable "
 SEXP match5(SEXP itable, SEXP ix, int nmatch, SEXP incomp, SEXP env)
 {
@@ -852,6 +966,27 @@ SEXP match5(SEXP itable, SEXP ix, int nmatch, SEXP incomp, SEXP env)
 	return ans;
     }
 
+    /* A sorted NA-free table is cheaper to search than to hash when x
+       is short; it is used as is, as match_transform() would copy it. */
+    type = TYPEOF(itable);
+    if(!incomp && !OBJECT(ix) && !OBJECT(itable) &&
+       (type == INTSXP || type == REALSXP) &&
+       (TYPEOF(ix) == LGLSXP || TYPEOF(ix) == INTSXP ||
+	TYPEOF(ix) == type)) {
+	R_xlen_t nt = XLENGTH(itable);
+	int sorted = UNKNOWN_SORTEDNESS;
+	if(type == INTSXP ? INTEGER_NO_NA(itable) : REAL_NO_NA(itable))
+	    sorted = type == INTSXP ?
+		INTEGER_IS_SORTED(itable) : REAL_IS_SORTED(itable);
+	if((sorted == SORTED_INCR || sorted == SORTED_DECR) &&
+	   (double) n * log2((double) nt) <= (double) nt) {
+	    PROTECT(x = coerceVector(ix, type));
+	    ans = match_sorted(x, itable, sorted == SORTED_INCR, nmatch);
+	    UNPROTECT(1);
+	    return ans;
+	}
+    }
+
     int nprot = 0;
     PROTECT(x	  = match_transform(ix,	    env)); nprot++;
     PROTECT(table = match_transform(itable, env)); nprot++;